@@ -0,0 +1,95 @@
+// Copyright 2020 Western Digital Corporation or its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <cinttypes>
+#include "BbvCollector.hpp"
+
+using namespace WdRiscv;
+
+
+void
+BbvCollector::endBlock()
+{
+  if (blockLen_ == 0)
+    return;
+
+  auto iter = blockIds_.find(blockStart_);
+  uint32_t id = 0;
+  if (iter != blockIds_.end())
+    id = iter->second;
+  else
+    {
+      id = blockIds_.size() + 1;
+      blockIds_[blockStart_] = id;
+      counts_.resize(id + 1);
+    }
+
+  if (counts_.at(id) == 0)
+    touched_.push_back(id);
+  counts_.at(id) += blockLen_;
+  blockLen_ = 0;
+}
+
+
+void
+BbvCollector::endInterval(uint64_t instCount)
+{
+  // Account for the part of the current block in the ending
+  // interval. The rest of the block is counted in the next interval
+  // under the same block.
+  if (blockLen_)
+    {
+      endBlock();
+      continued_ = true;
+    }
+
+  while (instCount > intervalEnd_)
+    {
+      writeInterval();
+      intervalEnd_ += interval_;
+    }
+}
+
+
+void
+BbvCollector::finish()
+{
+  endBlock();
+  continued_ = false;
+
+  // The counts of the partial interval are instruction counts and so
+  // already carry its (smaller) weight.
+  if (not touched_.empty())
+    writeInterval();
+  fflush(out_);
+}
+
+
+void
+BbvCollector::writeInterval()
+{
+  std::sort(touched_.begin(), touched_.end());
+
+  fputc('T', out_);
+  for (auto id : touched_)
+    {
+      fprintf(out_, ":%u:%" PRIu64 " ", id, counts_.at(id));
+      counts_.at(id) = 0;
+    }
+  fputc('\n', out_);
+  touched_.clear();
+  intervals_++;
+}
@@ -0,0 +1,99 @@
+// Copyright 2020 Western Digital Corporation or its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <unordered_map>
+
+namespace WdRiscv
+{
+
+  /// Collect basic block vectors (SimPoint input): For each interval
+  /// of a fixed number of instructions, count the instructions
+  /// executed in each basic block and write one line in the .bb
+  /// format of SimPoint:
+  ///     T:id:count :id:count ...
+  /// where id is a basic block number (starting at 1, in order of
+  /// first execution) and count is the number of instructions
+  /// retired in that block during the interval. A basic block is a
+  /// run of instructions ending at a control transfer and is
+  /// identified by the address of its first instruction.
+  class BbvCollector
+  {
+  public:
+
+    /// Define a collector writing to the given file with the given
+    /// interval (count of instructions).
+    BbvCollector(FILE* out, uint64_t interval)
+      : out_(out), interval_(interval ? interval : 1), intervalEnd_(interval_)
+    { }
+
+    /// Record the retirement of an instruction of the given size at
+    /// the given pc. NextPc is the address of the next instruction and
+    /// instCount the instruction count (instructions numbered from 1)
+    /// of the hart which is used to delimit intervals. Instructions
+    /// numbered (k*interval, (k+1)*interval] belong to interval k.
+    void retire(uint64_t pc, unsigned size, uint64_t nextPc, uint64_t instCount)
+    {
+      if (instCount > intervalEnd_)
+        endInterval(instCount);
+
+      if (blockLen_ == 0 and not continued_)
+        blockStart_ = pc;
+      blockLen_++;
+
+      if (nextPc != pc + size)
+        {
+          endBlock();
+          continued_ = false;
+        }
+    }
+
+    /// Write the vector of the final partial interval (if it has any
+    /// instructions). Called once at the end of collection.
+    void finish();
+
+    /// Return the number of intervals written so far.
+    uint64_t intervalCount() const
+    { return intervals_; }
+
+  private:
+
+    /// Add the pending run of instructions to the count of its block.
+    void endBlock();
+
+    /// Write the vectors of all the intervals ending before the given
+    /// instruction count.
+    void endInterval(uint64_t instCount);
+
+    /// Write the vector of the current interval and clear its counts.
+    void writeInterval();
+
+    FILE* out_ = nullptr;
+    uint64_t interval_ = 1;
+    uint64_t intervalEnd_ = 1;   // Instruction count ending current interval.
+    uint64_t intervals_ = 0;     // Intervals written.
+
+    uint64_t blockStart_ = 0;
+    uint64_t blockLen_ = 0;
+    bool continued_ = false;     // Block straddles an interval boundary.
+
+    std::unordered_map<uint64_t, uint32_t> blockIds_;  // Address to block id.
+    std::vector<uint64_t> counts_;     // Indexed by block id.
+    std::vector<uint32_t> touched_;    // Ids with non-zero count.
+  };
+}
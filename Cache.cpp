@@ -22,8 +22,10 @@
 using namespace WdRiscv;
 
 
-Cache::Cache(uint64_t totalSize, unsigned lineSize, unsigned setSize)
-  : size_(totalSize), lineSize_(lineSize), setSize_(setSize)
+Cache::Cache(uint64_t totalSize, unsigned lineSize, unsigned setSize,
+             Policy policy, bool writeBack, bool writeAllocate)
+  : policy_(policy), writeBack_(writeBack), writeAllocate_(writeAllocate),
+    size_(totalSize), lineSize_(lineSize), setSize_(setSize)
 {
   unsigned logSize = static_cast<unsigned>(std::log2(totalSize));
   uint64_t p2Size = uint64_t(1) << logSize;
@@ -32,6 +34,9 @@ Cache::Cache(uint64_t totalSize, unsigned lineSize, unsigned setSize)
   unsigned logSetCount = static_cast<unsigned>(std::log2(setSize));
   unsigned p2SetCount = unsigned(1) << logSetCount;
   assert(p2SetCount == setSize);
+  assert(setSize <= 64);
+  setSizeLog_ = logSetCount;
+  wayMask_ = setSize == 64 ? ~uint64_t(0) : (uint64_t(1) << setSize) - 1;
 
   unsigned logLineSize = static_cast<unsigned>(std::log2(lineSize));
   unsigned p2LineSize = unsigned(1) << logLineSize;
@@ -51,20 +56,131 @@ Cache::Cache(uint64_t totalSize, unsigned lineSize, unsigned setSize)
 
   setIndexMask_ = count - 1;
 
-  linesPerSet_.resize(count);
-
-  for (auto& lines : linesPerSet_)
-    lines.resize(setSize_);
+  tags_.resize(count*setSize_, invalidTag);
+  times_.resize(count*setSize_);
+  dirty_.resize(count);
+  if (policy_ == LRU)
+    {
+      lruRowsPerWord_ = 64 / setSize_;
+      lruWords_ = setSize_ / lruRowsPerWord_;
+      if (lruWords_ == 0)
+        lruWords_ = 1;
+      for (unsigned row = 0; row < lruRowsPerWord_ and row < setSize_; ++row)
+        lruColumn_ |= uint64_t(1) << (row*setSize_);
+      lruRows_.resize(count*lruWords_);
+    }
+  else if (policy_ == PLRU)
+    plruTrees_.resize(count);
 }
 
 
 Cache::~Cache()
 {
-  std::cerr << "Cache access: " << accesses_ << '\n';
-  std::cerr << "Cache hits: " << hits_ << '\n';
+}
+
+
+bool
+Cache::checkConfig(uint64_t size, unsigned lineSize, unsigned setSize,
+                   const std::string& tag)
+{
+  if (size == 0)
+    {
+      std::cerr << tag << ": Bad cache size: " << size << '\n';
+      return false;
+    }
+  unsigned logSize = static_cast<unsigned>(std::log2(size));
+  uint64_t p2Size = uint64_t(1) << logSize;
+  if (p2Size != size)
+    {
+      std::cerr << tag << ": Cache size not a power of 2: " << size << '\n';
+      return false;
+    }
+  if (size > 64L*1024L*1024L)
+    {
+      std::cerr << tag << ": Cache size too large: " << size << '\n';
+      return false;
+    }
+
+  if (setSize == 0)
+    {
+      std::cerr << tag << ": Bad cache associativity: " << setSize << '\n';
+      return false;
+    }
+  unsigned logSetSize = static_cast<unsigned>(std::log2(setSize));
+  unsigned p2SetSize = unsigned(1) << logSetSize;
+  if (p2SetSize != setSize)
+    {
+      std::cerr << tag << ": Cache associtivy is not a power of 2: " << setSize << '\n';
+      return false;
+    }
+  if (setSize > 64)
+    {
+      std::cerr << tag << ": Cache associativity too large: " << setSize << '\n';
+      return false;
+    }
+
+  if (lineSize == 0)
+    {
+      std::cerr << tag << ": Bad cache line size: " << lineSize << '\n';
+      return false;
+    }
+  unsigned logLineSize = static_cast<unsigned>(std::log2(lineSize));
+  unsigned p2LineSize = unsigned(1) << logLineSize;
+  if (p2LineSize != lineSize)
+    {
+      std::cerr << tag << ": Cache line size is not a power of 2: " << lineSize << '\n';
+      return false;
+    }
+  if (lineSize > 1024)
+    {
+      std::cerr << tag << ": Cache line size too large: " << lineSize << '\n';
+      return false;
+    }
+
+  if (size < uint64_t(lineSize) * setSize)
+    {
+      std::cerr << tag << ": Cache size (" << size << ") smaller than line size "
+                << "times associativity (" << lineSize << '*' << setSize << ")\n";
+      return false;
+    }
+
+  return true;
+}
+
+
+bool
+Cache::parsePolicy(const std::string& name, Policy& policy)
+{
+  if (name == "random")
+    policy = RANDOM;
+  else if (name == "lru")
+    policy = LRU;
+  else if (name == "plru")
+    policy = PLRU;
+  else
+    return false;
+  return true;
+}
 
-  double ratio = accesses_ == 0? 0. : double(hits_)/double(accesses_);
-  std::cerr << "Hit ratio: " << ratio << '\n';
+
+void
+Cache::printStats(std::ostream& out, const std::string& name) const
+{
+  auto ratio = [] (uint64_t part, uint64_t total) {
+    return total == 0? 0. : double(part)/double(total);
+  };
+
+  uint64_t accesses = reads_ + writes_;
+  uint64_t misses = readMisses_ + writeMisses_;
+
+  out << name << " reads: " << reads_ << " misses: " << readMisses_
+      << " miss ratio: " << ratio(readMisses_, reads_) << '\n';
+  out << name << " writes: " << writes_ << " misses: " << writeMisses_
+      << " miss ratio: " << ratio(writeMisses_, writes_) << '\n';
+  out << name << " accesses: " << accesses << " hits: " << (accesses - misses)
+      << " hit ratio: " << ratio(accesses - misses, accesses) << '\n';
+  out << name << " evictions: " << evictions_ << " writebacks: " << writebacks_
+      << '\n';
 }
 
 
@@ -73,21 +189,17 @@ Cache::getLineAddresses(std::vector<uint64_t>& result) const
 {
   result.clear();
 
-  std::vector<Entry> entries;
+  std::vector<std::pair<uint64_t, uint64_t>> entries;  // Pairs of time and tag.
 
-  for (const auto& lines : linesPerSet_)
-    for (const auto& entry : lines)
-      if (entry.valid())
-        entries.push_back(entry);
+  for (size_t ix = 0; ix < tags_.size(); ++ix)
+    if (tags_[ix] != invalidTag)
+      entries.push_back(std::make_pair(times_[ix], tags_[ix]));
 
-  std::sort(entries.begin(), entries.end(),
-            [](const Entry& a, const Entry& b) {
-              return a.time_ < b.time_;
-            } );
+  std::sort(entries.begin(), entries.end());
 
   result.reserve(entries.size());
   for (const auto& entry : entries)
-    result.push_back(entry.tag_ << lineNumberShift_);
+    result.push_back(entry.second << lineNumberShift_);
 }
 
 
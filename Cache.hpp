@@ -15,8 +15,8 @@
 #pragma once
 
 #include <cstdint>
-#include <map>
-#include <unordered_map>
+#include <iosfwd>
+#include <string>
 #include <vector>
 #include <cassert>
 
@@ -27,52 +27,130 @@ namespace WdRiscv
   /// Model a cache. This is for the support of the performance model.
   /// We keep track of the addresses of the lines in the cache.  We
   /// do not keep track of the data.
+  ///
+  /// The tags of a set are kept in contiguous memory. The replacement
+  /// state of a set is a bit-matrix (LRU) or a binary tree of bits
+  /// (PLRU): There is no time-stamp comparison when looking for a
+  /// victim. The rows of the LRU matrix are packed in 64-bit words so
+  /// that an access takes one word operation per matrix word: constant
+  /// time up to 8 ways, ways*ways/64 operations beyond.
   class Cache
   {
   public:
 
-    /// Replacement policy.
-    enum Policy { RANDOM, LRU };
+    /// Replacement policy: Random, true least-recently-used
+    /// (bit-matrix), or tree pseudo-least-recently-used.
+    enum Policy { RANDOM, LRU, PLRU };
 
     /// Define a cache with the given total data size and line size
     /// (all sizes in bytes and refer to the data part of the cache
     /// and not the tags) and set-associativity. The total-size must
     /// be a power of 2 and must be a multiple of the line-size. The
-    /// line-size and set-size must also be powers of 2. Peformance
-    /// will degrade significanlty (quadratic cost) if set size is
-    /// larger than 64.
+    /// line-size and set-size must also be powers of 2 and the
+    /// set-size must not exceed 64 (see checkConfig).
     ///
     /// Typical total-size: 2*1024*1024  (2 MB)
     /// Typical line-size: 64 bytes
     /// Typical set-size: 16 (16-way set associative)
-    Cache(uint64_t totalSize, unsigned lineSize, unsigned setCount);
+    ///
+    /// With writeBack false, the cache is write-through and its lines
+    /// are never dirty. With writeAllocate false, a write miss does
+    /// not bring the line into the cache.
+    Cache(uint64_t totalSize, unsigned lineSize, unsigned setSize,
+          Policy policy = LRU, bool writeBack = true,
+          bool writeAllocate = true);
 
     ~Cache();
 
-    /// Insert line overlapping given address into the cahce.
-    void insert(uint64_t addr)
+    /// Return true if the given parameters define a valid cache (see
+    /// constructor) printing an error message on standard error and
+    /// returning false otherwise. The tag is used in the error
+    /// messages.
+    static bool checkConfig(uint64_t size, unsigned lineSize,
+                            unsigned setSize, const std::string& tag = "Cache");
+
+    /// Convert the given string (random, lru, or plru) to a policy
+    /// returning true on success and false if string is not a valid
+    /// policy name.
+    static bool parsePolicy(const std::string& name, Policy& policy);
+
+    /// Line evicted by a reference: Valid is true if a line was
+    /// evicted. Dirty is true if the line was modified and needs to be
+    /// written back to the next level.
+    struct Victim
+    {
+      uint64_t addr_ = 0;
+      bool valid_ = false;
+      bool dirty_ = false;
+    };
+
+    /// Reference the line overlapping the given address for a read
+    /// (write is false) or a write (write is true). Return true on a
+    /// hit. On a miss, the line is brought into the cache (unless it
+    /// is a write and the cache is not write-allocate) and the evicted
+    /// line, if any, is reported in victim.
+    bool reference(uint64_t addr, bool write, Victim& victim)
     {
       uint64_t lineNumber = getLineNumber(addr);
       uint64_t setIndex = getSetIndex(lineNumber);
-      auto& lines = linesPerSet_.at(setIndex);
-      accesses_++;
+      uint64_t* tags = &tags_[setIndex*setSize_];
+      victim.valid_ = victim.dirty_ = false;
+
+      if (write)
+        writes_++;
+      else
+        reads_++;
 
-      // Find line number or oldest entry.
-      size_t bestIx = 0;
-      for (size_t ix = 0; ix < lines.size(); ++ix)
+      unsigned freeWay = setSize_;
+      for (unsigned way = 0; way < setSize_; ++way)
         {
-          auto& entry = lines[ix];
-          if (entry.tag_ == lineNumber)
+          if (tags[way] == lineNumber)
             {
-              hits_++;
-              bestIx = ix;
-              break;
+              touch(setIndex, way);
+              if (write and writeBack_)
+                dirty_[setIndex] |= uint64_t(1) << way;
+              return true;
             }
-          if (not entry.valid() or entry.time_ < lines[bestIx].time_)
-            bestIx = ix;
+          if (tags[way] == invalidTag and freeWay == setSize_)
+            freeWay = way;
+        }
+
+      if (write)
+        writeMisses_++;
+      else
+        readMisses_++;
+
+      if (write and not writeAllocate_)
+        return false;
+
+      unsigned way = freeWay;
+      if (way == setSize_)
+        {
+          way = victimWay(setIndex);
+          uint64_t bit = uint64_t(1) << way;
+          victim.valid_ = true;
+          victim.addr_ = tags[way] << lineNumberShift_;
+          victim.dirty_ = (dirty_[setIndex] & bit) != 0;
+          evictions_++;
+          if (victim.dirty_)
+            writebacks_++;
         }
-      lines[bestIx].tag_ = lineNumber;
-      lines[bestIx].time_ = time_++;
+
+      tags[way] = lineNumber;
+      uint64_t bit = uint64_t(1) << way;
+      if (write and writeBack_)
+        dirty_[setIndex] |= bit;
+      else
+        dirty_[setIndex] &= ~bit;
+      touch(setIndex, way);
+      return false;
+    }
+
+    /// Insert line overlapping given address into the cahce.
+    void insert(uint64_t addr)
+    {
+      Victim victim;
+      reference(addr, false, victim);
     }
 
     /// Invalidate line overlapping given address.
@@ -80,11 +158,14 @@ namespace WdRiscv
     {
       uint64_t lineNumber = getLineNumber(addr);
       uint64_t setIndex = getSetIndex(lineNumber);
+      uint64_t* tags = &tags_[setIndex*setSize_];
 
-      auto& lines = linesPerSet_.at(setIndex);
-      for (auto& entry : lines)
-        if (entry.tag_ == lineNumber)
-          entry.invalidate();
+      for (unsigned way = 0; way < setSize_; ++way)
+        if (tags[way] == lineNumber)
+          {
+            tags[way] = invalidTag;
+            dirty_[setIndex] &= ~(uint64_t(1) << way);
+          }
     }
 
     /// Return true if line overlapping given address is present in
@@ -95,19 +176,60 @@ namespace WdRiscv
     {
       uint64_t lineNumber = getLineNumber(addr);
       uint64_t setIndex = getSetIndex(lineNumber);
-      auto& lines = linesPerSet_.at(setIndex);
-      accesses_++;
+      const uint64_t* tags = &tags_[setIndex*setSize_];
+      reads_++;
 
-      for (auto& entry : lines)
-        if (entry.tag_ == lineNumber)
+      for (unsigned way = 0; way < setSize_; ++way)
+        if (tags[way] == lineNumber)
           {
-            hits_++;
-            entry.time_ = time_++;
+            touch(setIndex, way);
             return true;
           }
+      readMisses_++;
       return false;
     }
 
+    /// Return the line size of this cache.
+    unsigned lineSize() const
+    { return lineSize_; }
+
+    /// Return true if this is a write-back cache (false if
+    /// write-through).
+    bool writeBack() const
+    { return writeBack_; }
+
+    /// Return true if a write miss brings the line into this cache.
+    bool writeAllocate() const
+    { return writeAllocate_; }
+
+    /// Return the number of read references.
+    uint64_t reads() const
+    { return reads_; }
+
+    /// Return the number of read references that missed.
+    uint64_t readMisses() const
+    { return readMisses_; }
+
+    /// Return the number of write references.
+    uint64_t writes() const
+    { return writes_; }
+
+    /// Return the number of write references that missed.
+    uint64_t writeMisses() const
+    { return writeMisses_; }
+
+    /// Return the number of valid lines replaced by a fill.
+    uint64_t evictions() const
+    { return evictions_; }
+
+    /// Return the number of evicted lines that were dirty.
+    uint64_t writebacks() const
+    { return writebacks_; }
+
+    /// Print the reference, miss, and eviction counts of this cache
+    /// on the given stream. Each line starts with the given name.
+    void printStats(std::ostream& out, const std::string& name) const;
+
     /// Fill the given vector (cleared on entry) with the addresses of
     /// the lines curently in the cache in descending order (oldest
     /// one first) by age.
@@ -132,33 +254,112 @@ namespace WdRiscv
     uint64_t getSetIndex(uint64_t lineNumber) const
     { return lineNumber & setIndexMask_; }
 
-  private:
+    /// Mark given way of given set as the most recently used.
+    void touch(uint64_t setIndex, unsigned way)
+    {
+      times_[setIndex*setSize_ + way] = time_++;
 
-    struct Entry
+      if (policy_ == LRU)
+        {
+          // Row i of the matrix has bit j set if way i was used more
+          // recently than way j: Clear the column of the way in all
+          // the rows of each word at once, then set its row.
+          uint64_t* words = &lruRows_[setIndex*lruWords_];
+          uint64_t column = ~(lruColumn_ << way);
+          for (unsigned i = 0; i < lruWords_; ++i)
+            words[i] &= column;
+          unsigned shift = (way & (lruRowsPerWord_ - 1)) * setSize_;
+          words[way / lruRowsPerWord_] |= (wayMask_ & ~(uint64_t(1) << way)) << shift;
+        }
+      else if (policy_ == PLRU)
+        {
+          // Walk from the root to the leaf of the way making each node
+          // on the path point away from it.
+          uint64_t& tree = plruTrees_[setIndex];
+          unsigned node = 1;
+          for (unsigned level = setSizeLog_; level > 0; --level)
+            {
+              unsigned right = (way >> (level - 1)) & 1;
+              uint64_t bit = uint64_t(1) << node;
+              if (right)
+                tree &= ~bit;
+              else
+                tree |= bit;
+              node = 2*node + right;
+            }
+        }
+    }
+
+    /// Return the way to replace in the given set (all ways valid).
+    unsigned victimWay(uint64_t setIndex)
     {
-      uint64_t tag_ = ~uint64_t(0);
-      uint64_t time_ = 0;
+      if (policy_ == LRU)
+        {
+          // Least recently used way: The one with an empty row. Flag
+          // the empty rows of a word by their top bit: The lowest flag
+          // is exact.
+          if (setSize_ == 1)
+            return 0;
+          const uint64_t* words = &lruRows_[setIndex*lruWords_];
+          uint64_t top = lruColumn_ << (setSize_ - 1);
+          for (unsigned i = 0; i < lruWords_; ++i)
+            {
+              uint64_t word = words[i];
+              uint64_t empty = (word - lruColumn_) & ~word & top;
+              if (empty)
+                return i*lruRowsPerWord_ + __builtin_ctzll(empty) / setSize_;
+            }
+          return 0;
+        }
 
-      bool valid() const { return tag_ != ~uint64_t(0); }
-      void invalidate() { tag_ = ~uint64_t(0); }
-    };
+      if (policy_ == PLRU)
+        {
+          uint64_t tree = plruTrees_[setIndex];
+          unsigned node = 1;
+          for (unsigned level = 0; level < setSizeLog_; ++level)
+            node = 2*node + unsigned((tree >> node) & 1);
+          return node - setSize_;
+        }
+
+      // Random: xorshift.
+      random_ ^= random_ << 13;
+      random_ ^= random_ >> 7;
+      random_ ^= random_ << 17;
+      return unsigned(random_ & (setSize_ - 1));
+    }
+
+  private:
+
+    static constexpr uint64_t invalidTag = ~uint64_t(0);
 
-    /// Lines in set: Map a line address to an access time.
-    //typedef std::unordered_map<uint64_t, uint64_t> LineToTime;
-    typedef std::vector<Entry> LinesInSet;
+    std::vector<uint64_t> tags_;      // Line number of each way of each set.
+    std::vector<uint64_t> times_;     // Last reference time of each way.
+    std::vector<uint64_t> dirty_;     // Dirty bit of each way: one word per set.
+    std::vector<uint64_t> lruRows_;   // LRU bit matrix: lruWords_ words per set.
+    std::vector<uint64_t> plruTrees_; // PLRU tree bits (nodes 1 to setSize_-1) per set.
 
-    /// Map a set index (line-address modulo secCount) to a line-to-time
-    /// map.
-    std::vector<LinesInSet> linesPerSet_;
+    Policy policy_ = LRU;
+    bool writeBack_ = true;
+    bool writeAllocate_ = true;
 
     uint64_t size_ = 0;
     uint64_t time_ = 0;
+    uint64_t random_ = 0x2545f4914f6cdd1dULL;
+    uint64_t wayMask_ = 0;
+    uint64_t lruColumn_ = 0;       // Bit 0 of each row of an LRU word.
+    unsigned lruRowsPerWord_ = 0;  // LRU matrix rows packed in a word.
+    unsigned lruWords_ = 0;        // LRU matrix words per set.
     unsigned lineSize_ = 0;
     unsigned setSize_ = 0;
+    unsigned setSizeLog_ = 0;
     unsigned lineNumberShift_ = 0;
-    unsigned setIndexMask_ = 0;
+    uint64_t setIndexMask_ = 0;
 
-    uint64_t hits_ = 0;
-    uint64_t accesses_ = 0;
+    uint64_t reads_ = 0;
+    uint64_t readMisses_ = 0;
+    uint64_t writes_ = 0;
+    uint64_t writeMisses_ = 0;
+    uint64_t evictions_ = 0;
+    uint64_t writebacks_ = 0;
   };
 }
@@ -0,0 +1,152 @@
+// Copyright 2020 Western Digital Corporation or its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <iostream>
+#include <algorithm>
+#include "CacheHierarchy.hpp"
+
+using namespace WdRiscv;
+
+
+static std::unique_ptr<Cache>
+makeCache(const CacheParams& params)
+{
+  if (params.size_ == 0)
+    return nullptr;
+  return std::make_unique<Cache>(params.size_, params.lineSize_, params.ways_,
+                                 params.policy_, params.writeBack_,
+                                 params.writeAllocate_);
+}
+
+
+CacheHierarchy::CacheHierarchy(unsigned hartCount, const CacheParams& l1i,
+                               const CacheParams& l1d,
+                               const std::vector<CacheParams>& shared)
+  : multiHart_(hartCount > 1)
+{
+  for (unsigned i = 0; i < hartCount; ++i)
+    {
+      l1i_.push_back(makeCache(l1i));
+      l1d_.push_back(makeCache(l1d));
+    }
+
+  for (const auto& params : shared)
+    if (params.size_)
+      shared_.push_back(makeCache(params));
+
+  lineSize_ = ~0u;
+  if (l1i.size_)
+    lineSize_ = std::min(lineSize_, l1i.lineSize_);
+  if (l1d.size_)
+    lineSize_ = std::min(lineSize_, l1d.lineSize_);
+  for (const auto& cache : shared_)
+    lineSize_ = std::min(lineSize_, cache->lineSize());
+  if (lineSize_ == ~0u)
+    lineSize_ = 64;
+}
+
+
+void
+CacheHierarchy::reference(Cache* l1, uint64_t addr, unsigned size,
+                          bool write)
+{
+  uint64_t step = l1 ? l1->lineSize() : lineSize_;
+  uint64_t first = addr & ~(step - 1);
+  uint64_t last = (addr + (size ? size - 1 : 0)) & ~(step - 1);
+
+  // Shared levels are locked only when a reference reaches them.
+  std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+  auto outer = [this, &lock] (uint64_t line, bool isWrite) {
+    if (multiHart_ and not lock.owns_lock())
+      lock.lock();
+    outerReference(0, line, isWrite);
+  };
+
+  for (uint64_t line = first; ; line += step)
+    {
+      if (not l1)
+        outer(line, write);
+      else
+        {
+          Cache::Victim victim;
+          bool hit = l1->reference(line, write, victim);
+
+          if (not hit and (not write or l1->writeAllocate()))
+            outer(line, false);   // Fill from next level.
+
+          if (write and (not l1->writeBack() or (not hit and not l1->writeAllocate())))
+            outer(line, true);    // Write-through or write-around.
+
+          if (victim.dirty_)
+            outer(victim.addr_, true);
+        }
+
+      if (line == last)
+        break;
+    }
+}
+
+
+void
+CacheHierarchy::outerReference(size_t level, uint64_t addr, bool write)
+{
+  if (level >= shared_.size())
+    {
+      if (write)
+        memWrites_++;
+      else
+        memReads_++;
+      return;
+    }
+
+  Cache& cache = *shared_.at(level);
+  Cache::Victim victim;
+  bool hit = cache.reference(addr, write, victim);
+
+  // A write from the level above is a whole line: A write miss
+  // allocates without reading the line from the next level.
+  if (write)
+    {
+      if (not cache.writeBack() or (not hit and not cache.writeAllocate()))
+        outerReference(level + 1, addr, true);
+    }
+  else if (not hit)
+    outerReference(level + 1, addr, false);
+
+  if (victim.dirty_)
+    outerReference(level + 1, victim.addr_, true);
+}
+
+
+void
+CacheHierarchy::printStats(std::ostream& out) const
+{
+  bool multi = l1i_.size() > 1;
+
+  for (size_t hart = 0; hart < l1i_.size(); ++hart)
+    {
+      std::string prefix = multi? "Hart" + std::to_string(hart) + " " : "";
+      if (l1i_.at(hart))
+        l1i_.at(hart)->printStats(out, prefix + "L1I");
+      if (l1d_.at(hart))
+        l1d_.at(hart)->printStats(out, prefix + "L1D");
+    }
+
+  for (size_t i = 0; i < shared_.size(); ++i)
+    shared_.at(i)->printStats(out, "L" + std::to_string(i + 2));
+
+  out << "Memory line reads: " << memReads_ << " line writes: " << memWrites_
+      << '\n';
+}
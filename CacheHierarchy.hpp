@@ -0,0 +1,105 @@
+// Copyright 2020 Western Digital Corporation or its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Cache.hpp"
+
+
+namespace WdRiscv
+{
+
+  /// Parameters of one level of a cache hierarchy. A level with a
+  /// zero size is absent.
+  struct CacheParams
+  {
+    uint64_t size_ = 0;
+    unsigned lineSize_ = 64;
+    unsigned ways_ = 8;
+    Cache::Policy policy_ = Cache::PLRU;
+    bool writeBack_ = true;
+    bool writeAllocate_ = true;
+  };
+
+
+  /// Model a cache hierarchy for the performance model: A private
+  /// level-1 instruction cache and a private level-1 data cache per
+  /// hart followed by zero or more levels shared by all the harts
+  /// (L2, L3, ...). Only tags are modeled: The data always comes from
+  /// the simulated memory. Coherence between the private caches of
+  /// different harts is not modeled.
+  class CacheHierarchy
+  {
+  public:
+
+    /// Define a hierarchy for the given number of harts. An absent
+    /// level-1 cache (zero size) passes its references to the first
+    /// shared level.
+    CacheHierarchy(unsigned hartCount, const CacheParams& l1i,
+                   const CacheParams& l1d,
+                   const std::vector<CacheParams>& shared);
+
+    /// Model the fetch of size bytes at the given physical address by
+    /// the given hart.
+    void fetch(unsigned hart, uint64_t addr, unsigned size)
+    { reference(l1i_.at(hart).get(), addr, size, false); }
+
+    /// Model the load of size bytes at the given physical address by
+    /// the given hart.
+    void load(unsigned hart, uint64_t addr, unsigned size)
+    { reference(l1d_.at(hart).get(), addr, size, false); }
+
+    /// Model the store of size bytes at the given physical address by
+    /// the given hart.
+    void store(unsigned hart, uint64_t addr, unsigned size)
+    { reference(l1d_.at(hart).get(), addr, size, true); }
+
+    /// Print the statistics of every cache of the hierarchy followed
+    /// by the count of line reads and writes reaching memory.
+    void printStats(std::ostream& out) const;
+
+  protected:
+
+    /// Reference the lines overlapping the size bytes at the given
+    /// address in the given level-1 cache (may be null) sending
+    /// misses and write-backs to the shared levels.
+    void reference(Cache* l1, uint64_t addr, unsigned size, bool write);
+
+    /// Read (write is false) or write (write is true) the line at the
+    /// given address in the shared level of the given index.
+    /// Misses and write-backs propagate to the next level and then to
+    /// memory. Caller must hold the lock when there are multiple
+    /// harts.
+    void outerReference(size_t level, uint64_t addr, bool write);
+
+  private:
+
+    std::vector<std::unique_ptr<Cache>> l1i_;    // Indexed by hart.
+    std::vector<std::unique_ptr<Cache>> l1d_;    // Indexed by hart.
+    std::vector<std::unique_ptr<Cache>> shared_; // L2, L3, ...
+
+    unsigned lineSize_ = 64;  // Smallest line size of all the levels.
+    bool multiHart_ = false;
+    std::mutex mutex_;        // Protects shared_ and memory counts.
+
+    uint64_t memReads_ = 0;   // Lines read from memory.
+    uint64_t memWrites_ = 0;  // Lines written to memory.
+  };
+}
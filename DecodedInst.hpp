@@ -20,6 +20,7 @@
 #include "InstEntry.hpp"
 #include "FpRegs.hpp"
 #include "InstId.hpp"
+#include "Jit.hpp"
 
 
 namespace WdRiscv
@@ -43,16 +44,18 @@ namespace WdRiscv
     
     /// Default contructor: Define an invalid object.
     DecodedInst()
-      : addr_(0), inst_(0), size_(0), entry_(nullptr),
-	op0_(0), op1_(0), op2_(0), op3_(0), valid_(false), masked_(false)
+      : addr_(0), inst_(0), size_(0), entry_(nullptr), handler_(nullptr),
+	op0_(0), op1_(0), op2_(0), op3_(0), valid_(false), masked_(false),
+        disasmIx_(0)
     { values_[0] = values_[1] = values_[2] = values_[3] = 0; }
 
     /// Constructor.
     DecodedInst(uint64_t addr, uint32_t inst, const InstEntry* entry,
 		uint32_t op0, uint32_t op1, uint32_t op2, uint32_t op3)
       : addr_(addr), inst_(inst), size_(instructionSize(inst)), entry_(entry),
+        handler_(nullptr),
 	op0_(op0), op1_(op1), op2_(op2), op3_(op3), valid_(entry != nullptr),
-        masked_(false)
+        masked_(false), disasmIx_(0)
     { values_[0] = values_[1] = values_[2] = values_[3] = 0; }
 
     /// Return instruction size in bytes.
@@ -186,7 +189,7 @@ namespace WdRiscv
     { inst_ = inst; size_ = instructionSize(inst); }
 
     void setEntry(const InstEntry* e)
-    { entry_ = e; if (not e) valid_ = false; }
+    { entry_ = e; handler_ = nullptr; if (not e) valid_ = false; }
 
     void setOp0(uint32_t op0)
     { op0_ = op0; }
@@ -203,15 +206,39 @@ namespace WdRiscv
     void setMasked(bool flag)
     { masked_ = flag; }
 
+    /// Return the address of the code executing this instruction: The
+    /// entry for its instruction id in the label table of
+    /// Hart::execute, looked up once at decode time. The code is the
+    /// same for all hart configurations (it is not specialized). Return
+    /// null if not yet resolved.
+    void* handler() const
+    { return handler_; }
+
+    void setHandler(void* handler)
+    { handler_ = handler; }
+
+    /// Return the index (plus one) of the cached disassembly of this
+    /// instruction in the disassembly pool of the hart (see
+    /// Hart::disassembleCached) or zero if not cached.
+    uint32_t disasmIndex() const
+    { return disasmIx_; }
+
+    /// Cache the disassembly index of this instruction. This does not
+    /// change the decoded instruction, hence the const.
+    void setDisasmIndex(uint32_t ix) const
+    { disasmIx_ = ix; }
+
     void reset(uint64_t addr, uint32_t inst, const InstEntry* entry,
 	       uint32_t op0, uint32_t op1, uint32_t op2, uint32_t op3)
     {
       addr_ = addr;
       inst_ = inst;
       entry_ = entry;
+      handler_ = nullptr;
       op0_ = op0; op1_ = op1; op2_ = op2; op3_ = op3;
       size_ = instructionSize(inst);
       valid_ = entry != nullptr;
+      disasmIx_ = 0;
     }
 
   private:
@@ -220,6 +247,7 @@ namespace WdRiscv
     uint32_t inst_;
     uint32_t size_;
     const InstEntry* entry_;
+    void* handler_;   // Label table entry of instruction id (see Hart::execute).
     uint32_t op0_;    // 1st operand (typically a register number)
     uint32_t op1_;    // 2nd operand (register number or immediate value)
     uint32_t op2_;    // 3rd operand (register number or immediate value)
@@ -228,6 +256,111 @@ namespace WdRiscv
     uint64_t values_[4];  // Values of operands.
     bool valid_;
     bool masked_;     // For vector instructions.
+    mutable uint32_t disasmIx_;  // Cached disassembly index plus 1, or 0.
+  };
+
+
+  /// Model a decoded basic block: a straight-line sequence of
+  /// decoded instructions starting at a given address and ending
+  /// with a control transfer (branch, jump, trap-return, csr, ...)
+  /// or when a maximum length is reached. A block is built
+  /// incrementally as its instructions are executed for the first
+  /// time and is complete once its last instruction is appended.
+  /// A block keeps links to the blocks that follow it on the
+  /// fall-through and on the taken paths so that a run loop can go
+  /// from one block to the next without a cache lookup.
+  class DecodedBlock
+  {
+  public:
+
+    /// Maximum number of instructions in a block.
+    static constexpr unsigned maxSize = 64;
+
+    /// Constructor: Define an empty incomplete block at the given
+    /// address.
+    DecodedBlock(uint64_t addr = 0)
+      : addr_(addr), endAddr_(addr)
+    { }
+
+    /// Return address of first instruction in block.
+    uint64_t address() const
+    { return addr_; }
+
+    /// Return the address immediately following the last instruction
+    /// of this block.
+    uint64_t endAddress() const
+    { return endAddr_; }
+
+    /// Return the number of instructions in this block.
+    size_t size() const
+    { return insts_.size(); }
+
+    /// Return true if this block contains no instructions.
+    bool empty() const
+    { return insts_.empty(); }
+
+    /// Return true if no more instructions will be added to this block.
+    bool isComplete() const
+    { return complete_; }
+
+    /// A run of consecutive instructions of this block translated to
+    /// host code.
+    struct NativeRun
+    {
+      uint32_t start = 0;         // Index of first instruction in run.
+      uint32_t count = 0;         // Number of instructions in run.
+      Jit::Code code = nullptr;
+    };
+
+  protected:
+
+    friend class Hart<uint32_t>;
+    friend class Hart<uint64_t>;
+
+    /// Append an (invalid) instruction to this block and return a
+    /// reference to it.
+    DecodedInst& append()
+    {
+      if (insts_.empty())
+        insts_.reserve(maxSize);
+      insts_.emplace_back();
+      return insts_.back();
+    }
+
+    /// Update the end address of this block after a decode of its
+    /// last instruction.
+    void setEndAddress(uint64_t addr)
+    { endAddr_ = addr; }
+
+    /// Mark this block as complete.
+    void setComplete()
+    { complete_ = true; }
+
+    /// Discard the contents of this block.
+    void clear()
+    {
+      insts_.clear();
+      endAddr_ = addr_;
+      complete_ = false;
+      fallThrough_ = taken_ = nullptr;
+      native_.clear();
+      execCount_ = 0;
+      translated_ = false;
+    }
+
+  private:
+
+    uint64_t addr_;
+    uint64_t endAddr_;
+    std::vector<DecodedInst> insts_;
+    bool complete_ = false;
+
+    DecodedBlock* fallThrough_ = nullptr;  // Successor at endAddr_.
+    DecodedBlock* taken_ = nullptr;        // Most recent other successor.
+
+    std::vector<NativeRun> native_;  // Translated runs in increasing order.
+    uint32_t execCount_ = 0;         // Executions before translation.
+    bool translated_ = false;        // True if translation was attempted.
   };
 
 
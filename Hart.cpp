@@ -88,12 +88,19 @@ parseNumber(const std::string& numberStr, TYPE& number)
 }
 
 
+/// Default geometry of each of the instruction and data TLBs: Number
+/// of base page entries and set associativity.
+static constexpr unsigned defaultTlbSize = 64;
+static constexpr unsigned defaultTlbWays = 4;
+
+
 template <typename URV>
 Hart<URV>::Hart(unsigned hartIx, Memory& memory)
   : hartIx_(hartIx), memory_(memory), intRegs_(32),
     fpRegs_(32), vecRegs_(), syscall_(*this),
     pmpManager_(memory.size(), memory.pageSize()),
-    virtMem_(hartIx, memory, memory.pageSize(), pmpManager_, 16 /* FIX: TLB size*/)
+    virtMem_(hartIx, memory, memory.pageSize(), pmpManager_, defaultTlbSize,
+             defaultTlbWays)
 {
   regionHasLocalMem_.resize(16);
   regionHasLocalDataMem_.resize(16);
@@ -105,6 +112,36 @@ Hart<URV>::Hart(unsigned hartIx, Memory& memory)
   decodeCacheMask_ = decodeCacheSize_ - 1;
   decodeCache_.resize(decodeCacheSize_);
 
+  // Get the execute code addresses used to resolve decoded instructions.
+  execute(nullptr);
+
+  // In very large memories, bound the size of the code page map by
+  // folding page numbers onto it: Pages sharing an entry with a code
+  // page are (conservatively) treated as code pages.
+  size_t pageCount = (memory.size() + memory.pageSize() - 1) / memory.pageSize();
+  constexpr size_t maxCodePages = size_t(1) << 24;
+  if (pageCount > maxCodePages)
+    {
+      pageCount = maxCodePages;
+      codeMask_ = maxCodePages - 1;
+    }
+  codePages_.resize(pageCount);
+
+  // Host TLB pages must not span more than one virtual memory page.
+  hostTlb_ = HostTlb(256, std::min(memory.pageSize(), size_t(4096)));
+
+  // Keep the interrupt summary current as the interrupt pending and
+  // enable CSRs (or their supervisor/user views) change.
+  for (auto csrn : { CsrNumber::MIP, CsrNumber::MIE, CsrNumber::SIP,
+                     CsrNumber::SIE, CsrNumber::UIP, CsrNumber::UIE })
+    {
+      auto& csr = csRegs_.regs_.at(size_t(csrn));
+      auto post = [this] (Csr<URV>&, URV) { updateInterruptCheck(); };
+      csr.registerPostWrite(post);
+      csr.registerPostPoke(post);
+      csr.registerPostReset([this] (Csr<URV>&) { updateInterruptCheck(); });
+    }
+
   interruptStat_.resize(size_t(InterruptCause::MAX_CAUSE) + 1);
   exceptionStat_.resize(size_t(ExceptionCause::MAX_CAUSE) + 1);
   for (auto& vec : exceptionStat_)
@@ -340,6 +377,10 @@ Hart<URV>::processExtensions()
 		      << "-- ignored\n";
 	}
     }
+
+  // Decoded instructions depend on the enabled extensions.
+  invalidateDecodeCache();
+  clearDisassemblyCache();
 }
 
 
@@ -439,6 +480,11 @@ Hart<URV>::updateCachedMstatusFields()
   mstatusFs_ = FpFs(msf.bits_.FS);
   mstatusVs_ = FpFs(msf.bits_.VS);
 
+  // MXR and SUM change the outcome of the translation checks.
+  if (msf.bits_.MXR != virtMem_.execReadable_ or
+      msf.bits_.SUM != virtMem_.supervisorOk_)
+    hostTlb_.flush();
+
   virtMem_.setExecReadable(msf.bits_.MXR);
   virtMem_.setSupervisorAccessUser(msf.bits_.SUM);
 }
@@ -535,6 +581,7 @@ Hart<URV>::pokeMemory(size_t addr, uint8_t val, bool usePma)
   if (memory_.poke(addr, val, usePma))
     {
       invalidateDecodeCache(addr, sizeof(val));
+      virtMem_.noteStore(addr);
       return true;
     }
 
@@ -553,6 +600,7 @@ Hart<URV>::pokeMemory(size_t addr, uint16_t val, bool usePma)
   if (memory_.poke(addr, val, usePma))
     {
       invalidateDecodeCache(addr, sizeof(val));
+      virtMem_.noteStore(addr);
       return true;
     }
 
@@ -575,6 +623,7 @@ Hart<URV>::pokeMemory(size_t addr, uint32_t val, bool usePma)
   if (memory_.poke(addr, val, usePma))
     {
       invalidateDecodeCache(addr, sizeof(val));
+      virtMem_.noteStore(addr);
       return true;
     }
 
@@ -593,6 +642,7 @@ Hart<URV>::pokeMemory(size_t addr, uint64_t val, bool usePma)
   if (memory_.poke(addr, val, usePma))
     {
       invalidateDecodeCache(addr, sizeof(val));
+      virtMem_.noteStore(addr);
       return true;
     }
 
@@ -609,6 +659,7 @@ Hart<URV>::setPendingNmi(NmiCause cause)
     nmiCause_ = cause;
 
   nmiPending_ = true;
+  interruptCheck_ = true;
 
   // Set the nmi pending bit in the DCSR register.
   URV val = 0;  // DCSR value
@@ -627,6 +678,7 @@ Hart<URV>::clearPendingNmi()
 {
   nmiPending_ = false;
   nmiCause_ = NmiCause::UNKNOWN;
+  updateInterruptCheck();
 
   URV val = 0;  // DCSR value
   if (peekCsr(CsrNumber::DCSR, val))
@@ -1750,6 +1802,23 @@ Hart<URV>::load(uint32_t rd, uint32_t rs1, int32_t imm)
   ldStAddr_ = virtAddr;   // For reporting ld/st addr in trace-mode.
   ldStAddrValid_ = true;  // For reporting ld/st addr in trace-mode.
 
+  // Unsigned version of LOAD_TYPE
+  typedef typename std::make_unsigned<LOAD_TYPE>::type ULT;
+
+  // Aligned load from a page in the host TLB: All checks passed.
+  if (useHostTlb() and (virtAddr & (ldSize - 1)) == 0)
+    if (const uint8_t* host = hostTlb_.findRead(virtAddr, privMode_))
+      {
+        ULT uval = *(reinterpret_cast<const ULT*>(host));
+        URV value;
+        if constexpr (std::is_same<ULT, LOAD_TYPE>::value)
+          value = uval;
+        else
+          value = SRV(LOAD_TYPE(uval));
+        intRegs_.write(rd, value);
+        return true;
+      }
+
   if (loadQueueEnabled_)
     removeFromLoadQueue(rs1, false);
 
@@ -1760,9 +1829,6 @@ Hart<URV>::load(uint32_t rd, uint32_t rs1, int32_t imm)
 	triggerTripped_ = true;
     }
 
-  // Unsigned version of LOAD_TYPE
-  typedef typename std::make_unsigned<LOAD_TYPE>::type ULT;
-
   auto secCause = SecondaryCause::NONE;
   uint64_t addr = virtAddr;
   auto cause = determineLoadException(rs1, base, addr, ldSize, secCause);
@@ -1821,6 +1887,10 @@ Hart<URV>::load(uint32_t rd, uint32_t rs1, int32_t imm)
               putInLoadQueue(ldSize, addr, rd, prevRdVal);
             }
           intRegs_.write(rd, value);
+          if (caches_)
+            caches_->load(hartIx_, addr, ldSize);
+          if (useHostTlb() and not misalignedLdSt_)
+            fillHostTlb(virtAddr, addr, false);
           return true;  // Success.
         }
     }
@@ -1889,11 +1959,25 @@ Hart<URV>::store(uint32_t rs1, URV base, URV virtAddr, STORE_TYPE storeVal)
   return fastStore(rs1, base, virtAddr, storeVal);
 #else
 
-  std::lock_guard<std::mutex> lock(memory_.lrMutex_);
-
   ldStAddr_ = virtAddr;   // For reporting ld/st addr in trace-mode.
   ldStAddrValid_ = true;  // For reporting ld/st addr in trace-mode.
 
+  unsigned stSize = sizeof(STORE_TYPE);
+
+  // Aligned store to a page in the host TLB: All checks passed.
+  if (useHostTlb() and (virtAddr & (stSize - 1)) == 0)
+    {
+      uint64_t addr = 0;
+      if (uint8_t* host = hostTlb_.findWrite(virtAddr, privMode_, addr))
+        {
+          memory_.writeDirect(hartIx_, addr, host, storeVal);
+          memory_.invalidateOtherHartLr(hartIx_, addr, stSize);
+          invalidateDecodeCache(virtAddr, stSize);
+          virtMem_.noteStore(addr);
+          return true;
+        }
+    }
+
   // ld/st-address or instruction-address triggers have priority over
   // ld/st access or misaligned exceptions.
   bool hasTrig = hasActiveTrigger();
@@ -1930,7 +2014,6 @@ Hart<URV>::store(uint32_t rs1, URV base, URV virtAddr, STORE_TYPE storeVal)
       return false;
     }
 
-  unsigned stSize = sizeof(STORE_TYPE);
   if (wideLdSt_)
     return wideStore(addr, storeVal);
 
@@ -1939,6 +2022,13 @@ Hart<URV>::store(uint32_t rs1, URV base, URV virtAddr, STORE_TYPE storeVal)
       memory_.invalidateOtherHartLr(hartIx_, addr, stSize);
 
       invalidateDecodeCache(virtAddr, stSize);
+      virtMem_.noteStore(addr);
+
+      if (caches_)
+        caches_->store(hartIx_, addr, stSize);
+
+      if (useHostTlb() and not misalignedLdSt_)
+        fillHostTlb(virtAddr, addr, true);
 
       // If we write to special location, end the simulation.
       if (toHostValid_ and addr == toHost_ and storeVal != 0)
@@ -2327,6 +2417,8 @@ Hart<URV>::fetchInst(URV virtAddr, uint32_t& inst)
             }
         }
 
+      if (caches_)
+        caches_->fetch(hartIx_, addr, 4);
       return true;
     }
 
@@ -2357,6 +2449,9 @@ Hart<URV>::fetchInst(URV virtAddr, uint32_t& inst)
         }
     }
 
+  if (caches_)
+    caches_->fetch(hartIx_, addr, 2);
+
   inst = half;
   if (isCompressedInst(inst))
     return true;
@@ -2408,6 +2503,9 @@ Hart<URV>::fetchInst(URV virtAddr, uint32_t& inst)
         }
     }
 
+  if (caches_)
+    caches_->fetch(hartIx_, addr, 2);
+
   inst = inst | (uint32_t(upperHalf) << 16);
   return true;
 }
@@ -3047,8 +3145,10 @@ bool
 Hart<URV>::configCsr(const std::string& name, bool implemented, URV resetValue,
                      URV mask, URV pokeMask, bool debug, bool shared)
 {
-  return csRegs_.configCsr(name, implemented, resetValue, mask, pokeMask,
-			   debug, shared);
+  bool ok = csRegs_.configCsr(name, implemented, resetValue, mask, pokeMask,
+                              debug, shared);
+  updateInterruptCheck();
+  return ok;
 }
 
 
@@ -3124,116 +3224,39 @@ Hart<URV>::configMemoryProtectionGrain(uint64_t size)
 }
 
 
-template <typename URV>
-void
-formatInstTrace(FILE* out, uint64_t tag, unsigned hartId, URV currPc,
-		const char* opcode, char resource, URV addr,
-		URV value, const char* assembly);
-
-template <>
-void
-formatInstTrace<uint32_t>(FILE* out, uint64_t tag, unsigned hartId, uint32_t currPc,
-		const char* opcode, char resource, uint32_t addr,
-		uint32_t value, const char* assembly)
-{
-  if (resource == 'r' or resource == 'v')
-    {
-      fprintf(out, "#%" PRId64 " %d %08x %8s r %02x         %08x  %s",
-              tag, hartId, currPc, opcode, addr, value, assembly);
-    }
-  else if (resource == 'c')
-    {
-      if ((addr >> 16) == 0)
-        fprintf(out, "#%" PRId64 " %d %08x %8s c %04x       %08x  %s",
-                tag, hartId, currPc, opcode, addr, value, assembly);
-      else
-        fprintf(out, "#%" PRId64 " %d %08x %8s c %08x   %08x  %s",
-                tag, hartId, currPc, opcode, addr, value, assembly);
-    }
-  else
-    {
-      fprintf(out, "#%" PRId64 " %d %08x %8s %c %08x   %08x  %s", tag, hartId,
-              currPc, opcode, resource, addr, value, assembly);
-    }
-}
-
-template <>
-void
-formatInstTrace<uint64_t>(FILE* out, uint64_t tag, unsigned hartId, uint64_t currPc,
-		const char* opcode, char resource, uint64_t addr,
-		uint64_t value, const char* assembly)
-{
-  fprintf(out, "#%" PRId64 " %d %016" PRIx64 " %8s %c %016" PRIx64 " %016" PRIx64 "  %s",
-          tag, hartId, currPc, opcode, resource, addr, value, assembly);
-}
-
-template <typename URV>
-void
-formatFpInstTrace(FILE* out, uint64_t tag, unsigned hartId, URV currPc,
-		  const char* opcode, unsigned fpReg,
-		  uint64_t fpVal, const char* assembly);
-
-template <>
-void
-formatFpInstTrace<uint32_t>(FILE* out, uint64_t tag, unsigned hartId, uint32_t currPc,
-		  const char* opcode, unsigned fpReg,
-		  uint64_t fpVal, const char* assembly)
-{
-  fprintf(out, "#%" PRId64 " %d %08x %8s f %02x %016" PRIx64 "  %s",
-          tag, hartId, currPc, opcode, fpReg, fpVal, assembly);
-}
-
-template <>
-void
-formatFpInstTrace<uint64_t>(FILE* out, uint64_t tag, unsigned hartId, uint64_t currPc,
-		  const char* opcode, unsigned fpReg,
-		  uint64_t fpVal, const char* assembly)
-{
-  fprintf(out, "#%" PRId64 " %d %016" PRIx64 " %8s f %016" PRIx64 " %016" PRIx64 "  %s",
-          tag, hartId, currPc, opcode, uint64_t(fpReg), fpVal, assembly);
-}
-
-
 static std::mutex printInstTraceMutex;
 
 template <typename URV>
 void
-Hart<URV>::printInstTrace(uint32_t inst, uint64_t tag, std::string& tmp,
-			  FILE* out, bool interrupt)
+Hart<URV>::printInstTrace(uint32_t inst, uint64_t tag, FILE* out,
+			  bool interrupt)
 {
   DecodedInst di;
   decode(pc_, inst, di);
 
-  printInstTrace(di, tag, tmp, out, interrupt);
+  printInstTrace(di, tag, out, interrupt);
 }
 
 
 template <typename URV>
 void
-Hart<URV>::printInstTrace(const DecodedInst& di, uint64_t tag, std::string& tmp,
-			  FILE* out, bool interrupt)
+Hart<URV>::printInstTrace(const DecodedInst& di, uint64_t tag,
+			  FILE* traceFile, bool interrupt)
 {
-  // Serialize to avoid jumbled output.
-  std::lock_guard<std::mutex> guard(printInstTraceMutex);
-
-  disassembleInst(di, tmp);
-  if (interrupt)
-    tmp += " (interrupted)";
-
-  if (traceLdSt_ and ldStAddrValid_)
-    {
-      std::ostringstream oss;
-      oss << "0x" << std::hex << ldStAddr_;
-      tmp += " [" + oss.str() + "]";
-    }
-
-  char instBuff[128];
-  if (di.instSize() == 4)
-    sprintf(instBuff, "%08x", di.inst());
-  else
-    sprintf(instBuff, "%04x", di.inst() & 0xffff);
+  const std::string& disasm = disassembleCached(di);
 
-  bool pending = false;  // True if a printed line need to be terminated.
+  // Collect the record then render it as text or binary.
+  InstTraceRecord& rec = traceRecord_;
+  rec.tag_ = tag;
+  rec.hart_ = hartIx_;
+  rec.pc_ = currPc_;
+  rec.inst_ = di.inst();
+  rec.instSize_ = di.instSize();
+  rec.interrupted_ = interrupt;
+  rec.hasLdSt_ = traceLdSt_ and ldStAddrValid_;
+  rec.ldSt_ = ldStAddr_;
+  rec.disasm_ = disasm;
+  rec.changes_.clear();
 
   // Order: rfvmc (int regs, fp regs, vec regs, memory, csr)
 
@@ -3243,9 +3266,7 @@ Hart<URV>::printInstTrace(const DecodedInst& di, uint64_t tag, std::string& tmp,
   if (reg > 0)
     {
       value = intRegs_.read(reg);
-      formatInstTrace<URV>(out, tag, hartIx_, currPc_, instBuff, 'r', reg,
-			   value, tmp.c_str());
-      pending = true;
+      rec.changes_.push_back({'r', uint64_t(reg), value});
     }
 
   // Process floating point register diff.
@@ -3253,10 +3274,7 @@ Hart<URV>::printInstTrace(const DecodedInst& di, uint64_t tag, std::string& tmp,
   if (fpReg >= 0)
     {
       uint64_t val = fpRegs_.readBitsRaw(fpReg);
-      if (pending) fprintf(out, "  +\n");
-      formatFpInstTrace<URV>(out, tag, hartIx_, currPc_, instBuff, fpReg,
-			     val, tmp.c_str());
-      pending = true;
+      rec.changes_.push_back({'f', uint64_t(fpReg), val});
     }
 
   // Process vector register diff.
@@ -3264,12 +3282,8 @@ Hart<URV>::printInstTrace(const DecodedInst& di, uint64_t tag, std::string& tmp,
   int vecReg = vecRegs_.getLastWrittenReg(elemIx, elemWidth);
   if (vecReg >= 0)
     {
-      if (pending)
-        fprintf(out, " +\n");
       uint32_t checksum = vecRegs_.checksum(vecReg, 0, elemIx, elemWidth);
-      formatInstTrace<URV>(out, tag, hartIx_, currPc_, instBuff, 'v',
-			   vecReg, checksum, tmp.c_str());
-      pending = true;
+      rec.changes_.push_back({'v', uint64_t(vecReg), checksum});
     }
 
   // Process memory diff.
@@ -3278,19 +3292,10 @@ Hart<URV>::printInstTrace(const DecodedInst& di, uint64_t tag, std::string& tmp,
   unsigned writeSize = memory_.getLastWriteNewValue(hartIx_, address, memValue);
   if (writeSize > 0)
     {
-      if (pending)
-	fprintf(out, "  +\n");
-
       if (sizeof(URV) == 4 and writeSize == 8)  // wide store
-        {
-          fprintf(out, "#%ld %d %08x %8s m %08x %016lx  %s",
-                  tag, hartIx_, uint32_t(currPc_), instBuff, uint32_t(address),
-                  memValue, tmp.c_str());
-        }
+        rec.changes_.push_back({'M', address, memValue});
       else
-        formatInstTrace<URV>(out, tag, hartIx_, currPc_, instBuff, 'm',
-                             URV(address), URV(memValue), tmp.c_str());
-      pending = true;
+        rec.changes_.push_back({'m', URV(address), URV(memValue)});
     }
 
   // Process CSR diffs.
@@ -3347,22 +3352,28 @@ Hart<URV>::printInstTrace(const DecodedInst& di, uint64_t tag, std::string& tmp,
     }
 
   for (const auto& [key, val] : csrMap)
+    rec.changes_.push_back({'c', key, val});
+
+  if (binaryTrace_)
     {
-      if (pending) fprintf(out, "  +\n");
-      formatInstTrace<URV>(out, tag, hartIx_, currPc_, instBuff, 'c',
-			   key, val, tmp.c_str());
-      pending = true;
+      binaryTrace_->write(rec);
+      return;
     }
 
-  if (pending) 
-    fprintf(out, "\n");
-  else
+  // Format the whole record then write it at once.
+  std::string& out = traceLine_;
+  out.clear();
+  formatInstTraceRecord(rec, sizeof(URV)*8, out);
+
+  if (traceBuffer_)
     {
-      // No diffs: Generate an x0 record.
-      formatInstTrace<URV>(out, tag, hartIx_, currPc_, instBuff, 'r', 0, 0,
-			  tmp.c_str());
-      fprintf(out, "\n");
+      traceBuffer_->append(tag, out);
+      return;
     }
+
+  // Serialize to avoid jumbled output.
+  std::lock_guard<std::mutex> guard(printInstTraceMutex);
+  fputs(out.c_str(), traceFile);
 }
 
 
@@ -3672,6 +3683,12 @@ Hart<URV>::accumulateInstructionStats(const DecodedInst& di)
   misalignedLdSt_ = false;
   lastBranchTaken_ = false;
 
+  if (profiler_)
+    profiler_->retire(currPc_, di, pc_);
+
+  if (bbv_)
+    bbv_->retire(currPc_, di.instSize(), pc_, instCounter_);
+
   if (not instFreq_)
     return;
 
@@ -4010,8 +4027,7 @@ Hart<URV>::takeTriggerAction(FILE* traceFile, URV pc, URV info,
       uint32_t inst = 0;
       readInst(currPc_, inst);
 
-      std::string instStr;
-      printInstTrace(inst, counter, instStr, traceFile);
+      printInstTrace(inst, counter, traceFile);
     }
 
   return enteredDebug;
@@ -4144,8 +4160,7 @@ Hart<URV>::logStop(const CoreException& ce, uint64_t counter, FILE* traceFile)
 	{
 	  uint32_t inst = 0;
 	  readInst(currPc_, inst);
-	  std::string instStr;
-	  printInstTrace(inst, counter, instStr, traceFile);
+	  printInstTrace(inst, counter, traceFile);
 	}
     }
 
@@ -4204,9 +4219,11 @@ Hart<URV>::fetchInstWithTrigger(URV addr, uint32_t& inst, FILE* file)
     }
   else
     {
+      // The cache model must see every fetch: Do not skip fetch on a
+      // decode cache hit.
       uint32_t ix = (addr >> 1) & decodeCacheMask_;
       DecodedInst* di = &decodeCache_[ix];
-      if (not di->isValid() or di->address() != pc_)
+      if (caches_ or not di->isValid() or di->address() != pc_)
         fetchOk = fetchInst(addr, inst);
       else
         inst = di->inst();
@@ -4215,10 +4232,7 @@ Hart<URV>::fetchInstWithTrigger(URV addr, uint32_t& inst, FILE* file)
     {
       ++cycleCount_;
       if (file)
-        {
-          std::string instStr;
-          printInstTrace(inst, instCounter_, instStr, file);
-        }
+        printInstTrace(inst, instCounter_, file);
 
       if (dcsrStep_)
         enterDebugMode_(DebugModeCause::STEP, pc_);
@@ -4240,20 +4254,63 @@ template <typename URV>
 bool
 Hart<URV>::untilAddress(size_t address, FILE* traceFile)
 {
-  std::string instStr;
-  instStr.reserve(128);
+  typedef bool (Hart<URV>::*UntilFunc)(size_t, FILE*);
+  static const UntilFunc variants[UntilFeatureCount] = {
+    &Hart<URV>::untilAddressWith<0>,  &Hart<URV>::untilAddressWith<1>,
+    &Hart<URV>::untilAddressWith<2>,  &Hart<URV>::untilAddressWith<3>,
+    &Hart<URV>::untilAddressWith<4>,  &Hart<URV>::untilAddressWith<5>,
+    &Hart<URV>::untilAddressWith<6>,  &Hart<URV>::untilAddressWith<7>,
+    &Hart<URV>::untilAddressWith<8>,  &Hart<URV>::untilAddressWith<9>,
+    &Hart<URV>::untilAddressWith<10>, &Hart<URV>::untilAddressWith<11>,
+    &Hart<URV>::untilAddressWith<12>, &Hart<URV>::untilAddressWith<13>,
+    &Hart<URV>::untilAddressWith<14>, &Hart<URV>::untilAddressWith<15>
+  };
+
+  // Select the loop variant once: The enabled features do not change
+  // while the loop runs.
+  unsigned features = 0;
+  if (traceFile)
+    features |= UntilTrace;
+  if (enableTriggers_)
+    features |= UntilTriggers;
+  if (instFreq_ or enableCounters_ or profiler_ or bbv_)
+    features |= UntilStats;
+  if (enableGdb_)
+    features |= UntilGdb;
+
+  updateHostTlb();
+  bool ok = (this->*variants[features])(address, traceFile);
+  hostTlbOk_ = false;
+
+  if (traceBuffer_)
+    traceBuffer_->publish();
+  return ok;
+}
+
+
+template <typename URV>
+template <unsigned FEATURES>
+bool
+Hart<URV>::untilAddressWith(size_t address, FILE* traceFile)
+{
+  constexpr bool hasTrace = (FEATURES & UntilTrace) != 0;
+  constexpr bool hasTriggers = (FEATURES & UntilTriggers) != 0;
+  constexpr bool doStats = (FEATURES & UntilStats) != 0;
+  constexpr bool hasGdb = (FEATURES & UntilGdb) != 0;
 
   // Need csr history when tracing or for triggers
-  bool trace = traceFile != nullptr or enableTriggers_;
+  constexpr bool trace = hasTrace or hasTriggers;
   clearTraceData();
 
   uint64_t limit = instCountLim_;
-  bool doStats = instFreq_ or enableCounters_;
 
   // Check for gdb break every 1000000 instructions.
   unsigned gdbCount = 0, gdbLimit = 1000000;
 
-  if (enableGdb_)
+  // Start from an exact interrupt summary.
+  updateInterruptCheck();
+
+  if constexpr (hasGdb)
     handleExceptionForGdb(*this, gdbInputFd_);
 
   while (pc_ != address and instCounter_ < limit)
@@ -4261,7 +4318,7 @@ Hart<URV>::untilAddress(size_t address, FILE* traceFile)
       if (userStop)
         break;
 
-      if (enableGdb_ and ++gdbCount >= gdbLimit)
+      if (hasGdb and ++gdbCount >= gdbLimit)
         {
           gdbCount = 0;
           if (isInputPending(gdbInputFd_))
@@ -4299,7 +4356,8 @@ Hart<URV>::untilAddress(size_t address, FILE* traceFile)
 
 	  ++instCounter_;
 
-          if (processExternalInterrupt(traceFile, instStr))
+          if ((interruptCheck_ or instCounter_ >= alarmLimit_) and
+              processExternalInterrupt(traceFile))
             continue;
 
           if (not fetchInstWithTrigger(pc_, inst, traceFile))
@@ -4322,11 +4380,11 @@ Hart<URV>::untilAddress(size_t address, FILE* traceFile)
 
 	  if (hasException_ or hasInterrupt_)
 	    {
-              if (doStats)
+              if constexpr (doStats)
                 accumulateInstructionStats(*di);
-	      if (traceFile)
+	      if constexpr (hasTrace)
 		{
-		  printInstTrace(*di, instCounter_, instStr, traceFile);
+		  printInstTrace(*di, instCounter_, traceFile);
 		  clearTraceData();
 		}
 	      continue;
@@ -4343,17 +4401,17 @@ Hart<URV>::untilAddress(size_t address, FILE* traceFile)
           if (minstretEnabled())
             ++retiredInsts_;
 
-	  if (doStats)
+	  if constexpr (doStats)
 	    accumulateInstructionStats(*di);
 
-	  if (trace)
+	  if constexpr (trace)
 	    {
-	      if (traceFile)
-		printInstTrace(*di, instCounter_, instStr, traceFile);
+	      if (hasTrace)
+		printInstTrace(*di, instCounter_, traceFile);
 	      clearTraceData();
 	    }
 
-	  bool icountHit = (enableTriggers_ and
+	  bool icountHit = (hasTriggers and
 			    icountTriggerHit(privMode_, isInterruptEnabled()));
 	  if (icountHit)
 	    if (takeTriggerAction(traceFile, pc_, pc_, instCounter_, false))
@@ -4384,6 +4442,8 @@ Hart<URV>::runUntilAddress(size_t address, FILE* traceFile)
   SignalHandlers handlers;
 
   bool success = untilAddress(address, traceFile);
+  if (traceBuffer_)
+    traceBuffer_->finish();
       
   if (instCounter_ == limit)
     std::cerr << "Stopped -- Reached instruction limit\n";
@@ -4403,6 +4463,31 @@ Hart<URV>::runUntilAddress(size_t address, FILE* traceFile)
 }
 
 
+template <typename URV>
+bool
+Hart<URV>::runQuantum(uint64_t count, FILE* traceFile, bool& finished)
+{
+  uint64_t limit = instCountLim_;
+  uint64_t quantumEnd = instCounter_ + count;
+  if (quantumEnd < instCounter_ or quantumEnd > limit)
+    quantumEnd = limit;  // Overflow or past global limit.
+
+  URV stopAddr = stopAddrValid_? stopAddr_ : ~URV(0); // ~URV(0): No-stop PC.
+
+  instCountLim_ = quantumEnd;
+  bool success = untilAddress(stopAddr, traceFile);
+  instCountLim_ = limit;
+
+  // Anything short of the end of the quantum is a stop.
+  finished = (hasTargetProgramFinished() or userStop or
+              (stopAddrValid_ and pc_ == stopAddr) or
+              instCounter_ >= limit or instCounter_ < quantumEnd);
+  if (finished and traceBuffer_)
+    traceBuffer_->finish();
+  return success;
+}
+
+
 template <typename URV>
 bool
 Hart<URV>::simpleRun()
@@ -4410,6 +4495,10 @@ Hart<URV>::simpleRun()
   // For speed: do not record/clear CSR changes.
   enableCsrTrace_ = false;
 
+  // Blocks from a previous run may be stale.
+  flushBlockCache();
+  updateHostTlb();
+
   bool success = true;
 
   try
@@ -4439,6 +4528,7 @@ Hart<URV>::simpleRun()
     }
 
   enableCsrTrace_ = true;
+  hostTlbOk_ = false;
 
   return success;
 }
@@ -4449,54 +4539,268 @@ bool
 Hart<URV>::simpleRunWithLimit()
 {
   uint64_t limit = instCountLim_;
+  DecodedBlock* block = nullptr;
+
   while (noUserStop and instCounter_ < limit) 
+    {
+      block = findBlock(block);
+      if (block->isComplete() and instCounter_ + block->size() <= limit)
+        runBlock(*block);
+      else
+        buildBlock(*block, limit);
+    }
+  return true;
+}
+
+
+template <typename URV>
+bool
+Hart<URV>::simpleRunNoLimit()
+{
+  uint64_t limit = ~uint64_t(0);
+  DecodedBlock* block = nullptr;
+
+  while (noUserStop) 
+    {
+      block = findBlock(block);
+      if (block->isComplete())
+        runBlock(*block);
+      else
+        buildBlock(*block, limit);
+    }
+
+  return true;
+}
+
+
+template <typename URV>
+DecodedBlock*
+Hart<URV>::findBlock(DecodedBlock* prev)
+{
+  if (blockFlush_ or blockCache_.size() >= blockCacheLimit_)
+    {
+      flushBlockCache();
+      prev = nullptr;
+    }
+
+  if (prev)
+    {
+      // Chained successors: no cache lookup.
+      DecodedBlock* next = prev->fallThrough_;
+      if (next and next->address() == pc_)
+        return next;
+      next = prev->taken_;
+      if (next and next->address() == pc_)
+        return next;
+    }
+
+  DecodedBlock* block = &blockCache_.try_emplace(pc_, pc_).first->second;
+
+  if (prev)
+    {
+      if (pc_ == prev->endAddress())
+        prev->fallThrough_ = block;
+      else
+        prev->taken_ = block;
+    }
+
+  return block;
+}
+
+
+template <typename URV>
+void
+Hart<URV>::runBlock(DecodedBlock& block)
+{
+  if (jit_)
+    {
+      if (not block.translated_ and ++block.execCount_ >= jitThreshold_)
+        translateBlock(block);
+      if (not block.native_.empty())
+        {
+          runNativeBlock(block);
+          return;
+        }
+    }
+
+  for (auto& di : block.insts_)
     {
       currPc_ = pc_;
       ++instCounter_;
 
-      // Fetch/decode unless match in decode cache.
-      uint32_t ix = (pc_ >> 1) & decodeCacheMask_;
-      DecodedInst* di = &decodeCache_[ix];
-      if (not di->isValid() or di->address() != pc_)
+      URV nextPc = pc_ + di.instSize();
+      pc_ = nextPc;
+      execute(&di);
+
+      // Stop on a change of flow (exception/interrupt) or if the
+      // instructions of the block may have been overwritten.
+      if (pc_ != nextPc or blockFlush_)
+        break;
+    }
+}
+
+
+template <typename URV>
+void
+Hart<URV>::runNativeBlock(DecodedBlock& block)
+{
+  auto& insts = block.insts_;
+  size_t runIx = 0;
+
+  for (size_t i = 0; i < insts.size(); )
+    {
+      if (runIx < block.native_.size() and block.native_[runIx].start == i)
         {
-          uint32_t inst = 0;
-          if (not fetchInst(pc_, inst))
-            continue;
-          decode(pc_, inst, *di);
+          // Translated instructions cannot change the control flow.
+          const auto& run = block.native_[runIx++];
+          run.code(intRegs_.regs_.data());
+          instCounter_ += run.count;
+          i += run.count;
+          const auto& last = insts[i-1];
+          pc_ = last.address() + last.instSize();
+          continue;
         }
 
-      pc_ += di->instSize();
-      execute(di);
+      auto& di = insts[i++];
+      currPc_ = pc_;
+      ++instCounter_;
+
+      URV nextPc = pc_ + di.instSize();
+      pc_ = nextPc;
+      execute(&di);
+
+      if (pc_ != nextPc or blockFlush_)
+        break;
+    }
+}
+
+
+template <typename URV>
+void
+Hart<URV>::translateBlock(DecodedBlock& block)
+{
+  block.translated_ = true;
+
+  auto& insts = block.insts_;
+  unsigned regCount = intRegs_.size();
+
+  for (size_t i = 0; i < insts.size(); )
+    {
+      size_t start = i;
+      while (i < insts.size() and Jit::isTranslatable(insts[i], isRv64(), regCount))
+        ++i;
+
+      // Single instructions are not worth a call into host code.
+      size_t count = i - start;
+      if (count >= 2)
+        {
+          Jit::Code code = jit_->translate(&insts[start], count, isRv64());
+          if (not code)
+            return;   // Code buffer full. Will be reset on next flush.
+          block.native_.push_back({ uint32_t(start), uint32_t(count), code });
+        }
+
+      if (i == start)
+        ++i;
     }
-  return true;
 }
 
 
 template <typename URV>
 bool
-Hart<URV>::simpleRunNoLimit()
+Hart<URV>::enableJit(bool flag)
 {
-  while (noUserStop) 
+  jit_.reset();
+  if (not flag)
+    return true;
+
+  jit_ = std::make_unique<Jit>();
+  if (jit_->isAvailable())
+    return true;
+
+  jit_.reset();
+  return false;
+}
+
+
+template <typename URV>
+void
+Hart<URV>::buildBlock(DecodedBlock& block, uint64_t limit)
+{
+  // Block may have been left incomplete by an exception or by a
+  // previous run: start over.
+  if (not block.empty())
+    block.clear();
+
+  while (noUserStop and instCounter_ < limit)
     {
       currPc_ = pc_;
       ++instCounter_;
 
-      // Fetch/decode unless match in decode cache.
-      uint32_t ix = (pc_ >> 1) & decodeCacheMask_;
-      DecodedInst* di = &decodeCache_[ix];
-      if (not di->isValid() or di->address() != pc_)
+      uint32_t inst = 0;
+      if (not fetchInst(pc_, inst))
         {
-          uint32_t inst = 0;
-          if (not fetchInst(pc_, inst))
-            continue;
-          decode(pc_, inst, *di);
+          // Fetch exception. Keep what was fetched so far.
+          if (not block.empty())
+            block.setComplete();
+          return;
         }
 
-      pc_ += di->instSize();
-      execute(di);
+      DecodedInst& di = block.append();
+      decode(pc_, inst, di);
+
+      URV nextPc = pc_ + di.instSize();
+      block.setEndAddress(nextPc);
+      pc_ = nextPc;
+      execute(&di);
+
+      if (blockFlush_)
+        return;
+
+      if (pc_ != nextPc or isBlockEnd(di) or block.size() >= DecodedBlock::maxSize)
+        {
+          block.setComplete();
+          return;
+        }
     }
+}
 
-  return true;
+
+template <typename URV>
+bool
+Hart<URV>::isBlockEnd(const DecodedInst& di) const
+{
+  const InstEntry* entry = di.instEntry();
+  if (entry->isBranch() or entry->isCsr())
+    return true;
+
+  switch (entry->instId())
+    {
+    case InstId::illegal:
+    case InstId::ecall:
+    case InstId::ebreak:
+    case InstId::c_ebreak:
+    case InstId::fencei:
+    case InstId::mret:
+    case InstId::uret:
+    case InstId::sret:
+    case InstId::wfi:
+    case InstId::sfence_vma:
+      return true;
+    default:
+      return false;
+    }
+}
+
+
+template <typename URV>
+void
+Hart<URV>::flushBlockCache()
+{
+  blockCache_.clear();
+  blockFlush_ = false;
+  if (jit_)
+    jit_->reset();
 }
 
 
@@ -4571,8 +4875,9 @@ Hart<URV>::run(FILE* file)
   URV stopAddr = stopAddrValid_? stopAddr_ : ~URV(0); // ~URV(0): No-stop PC.
   bool hasClint = clintStart_ < clintLimit_;
   bool complex = (stopAddrValid_ or instFreq_ or enableTriggers_ or enableGdb_
-                  or enableCounters_ or alarmInterval_ or file or enableWideLdSt_
-                  or hasClint or isRvs());
+                  or enableCounters_ or profiler_ or bbv_ or caches_
+                  or alarmInterval_ or file or enableWideLdSt_ or hasClint
+                  or isRvs());
   if (complex)
     return runUntilAddress(stopAddr, file); 
 
@@ -4681,7 +4986,7 @@ Hart<URV>::isInterruptPossible(InterruptCause& cause)
 
 template <typename URV>
 bool
-Hart<URV>::processExternalInterrupt(FILE* traceFile, std::string& instStr)
+Hart<URV>::processExternalInterrupt(FILE* traceFile)
 {
   if (instCounter_ >= alarmLimit_)
     {
@@ -4691,6 +4996,11 @@ Hart<URV>::processExternalInterrupt(FILE* traceFile, std::string& instStr)
       alarmLimit_ += alarmInterval_;
     }
 
+  // Nothing to take unless an interrupt is both pending and enabled
+  // in MIP/MIE or an nmi is pending.
+  if (not interruptCheck_)
+    return false;
+
   if (debugStepMode_ and not dcsrStepIe_)
     return false;
 
@@ -4700,10 +5010,11 @@ Hart<URV>::processExternalInterrupt(FILE* traceFile, std::string& instStr)
       initiateNmi(URV(nmiCause_), pc_);
       nmiPending_ = false;
       nmiCause_ = NmiCause::UNKNOWN;
+      updateInterruptCheck();
       uint32_t inst = 0; // Load interrupted inst.
       readInst(currPc_, inst);
       if (traceFile)  // Trace interrupted instruction.
-	printInstTrace(inst, instCounter_, instStr, traceFile, true);
+	printInstTrace(inst, instCounter_, traceFile, true);
       return true;
     }
 
@@ -4716,7 +5027,7 @@ Hart<URV>::processExternalInterrupt(FILE* traceFile, std::string& instStr)
       uint32_t inst = 0; // Load interrupted inst.
       readInst(currPc_, inst);
       if (traceFile)  // Trace interrupted instruction.
-	printInstTrace(inst, instCounter_, instStr, traceFile, true);
+	printInstTrace(inst, instCounter_, traceFile, true);
       ++cycleCount_;
       return true;
     }
@@ -4725,35 +5036,115 @@ Hart<URV>::processExternalInterrupt(FILE* traceFile, std::string& instStr)
 
 
 template <typename URV>
-void
-Hart<URV>::invalidateDecodeCache(URV addr, unsigned storeSize)
+void
+Hart<URV>::invalidateDecodeCache(URV addr, unsigned storeSize)
+{
+  // We want to check the location before the address just in case it
+  // contains a 4-byte instruction that overlaps what was written.
+  storeSize += 3;
+  addr -= 3;
+
+  // Data stores (pages never decoded from) need no invalidation.
+  if (not isCodePage(addr) and not isCodePage(addr + storeSize - 1))
+    return;
+
+  // Flush the decoded blocks: the store touches a code page.
+  if (not blockCache_.empty())
+    blockFlush_ = true;
+
+  for (unsigned i = 0; i < storeSize; i += 2)
+    {
+      URV instAddr = (addr + i) >> 1;
+      uint32_t cacheIx = instAddr & decodeCacheMask_;
+      auto& entry = decodeCache_[cacheIx];
+      if ((entry.address() >> 1) == instAddr)
+	entry.invalidate();
+    }
+}
+
+
+template <typename URV>
+void
+Hart<URV>::invalidateDecodeCache()
+{
+  for (auto& entry : decodeCache_)
+    entry.invalidate();
+
+  // No decoded instructions remain once the blocks are flushed.
+  codePages_.assign(codePages_.size(), false);
+  codeOutside_ = false;
+
+  if (not blockCache_.empty())
+    blockFlush_ = true;
+}
+
+
+template <typename URV>
+HugePageKind
+Hart<URV>::useHugePagesForDecodeCache(bool flag)
+{
+  HugePageAllocator<DecodedInst> alloc(flag);
+  decodeCache_ = decltype(decodeCache_)(decodeCacheSize_, alloc);
+  invalidateDecodeCache();
+
+  return decodeCache_.get_allocator().kind();
+}
+
+
+template <typename URV>
+void
+Hart<URV>::updateHostTlb()
+{
+  hostTlb_.flush();
+
+  // Load queue, stack checks, region prediction, and triggers look
+  // at every access. PMP access statistics are reported with the
+  // instruction frequencies and must count every access.
+  hostTlbOk_ = not (loadQueueEnabled_ or checkStackAccess_ or
+                    eaCompatWithBase_ or enableTriggers_ or instFreq_ or
+                    caches_);
+}
+
+
+template <typename URV>
+uint8_t*
+Hart<URV>::directHostAddr(uint64_t physAddr, bool write)
 {
-  // Consider putting this in a callback associated with memory
-  // write/poke. This way it can be applied only to pages marked
-  // execute.
+  uint64_t pageSize = hostTlb_.pageSize();
+  uint64_t first = physAddr & ~(pageSize - 1);
+  uint64_t last = first + pageSize - 1;
 
-  // We want to check the location before the address just in case it
-  // contains a 4-byte instruction that overlaps what was written.
-  storeSize += 3;
-  addr -= 3;
+  // Pages with special locations must go through the complete path.
+  if (toHostValid_ and toHost_ >= first and toHost_ <= last)
+    return nullptr;
+  if (conIoValid_ and conIo_ >= first and conIo_ <= last)
+    return nullptr;
+  if (clintStart_ < clintLimit_ and clintStart_ <= last and clintLimit_ >= first)
+    return nullptr;
 
-  for (unsigned i = 0; i < storeSize; i += 2)
-    {
-      URV instAddr = (addr + i) >> 1;
-      uint32_t cacheIx = instAddr & decodeCacheMask_;
-      auto& entry = decodeCache_[cacheIx];
-      if ((entry.address() >> 1) == instAddr)
-	entry.invalidate();
-    }
+  if (pmpEnabled_ and not pmpManager_.isPageUniform(physAddr))
+    return nullptr;
+
+  uint8_t* host = memory_.directPage(physAddr, write);
+  if (not host)
+    return nullptr;
+  return host + (physAddr - memory_.getPageStartAddr(physAddr));
 }
 
 
 template <typename URV>
 void
-Hart<URV>::invalidateDecodeCache()
+Hart<URV>::fillHostTlb(uint64_t virtAddr, uint64_t physAddr, bool write)
 {
-  for (auto& entry : decodeCache_)
-    entry.invalidate();
+  uint8_t* host = directHostAddr(physAddr, write);
+  if (not host)
+    return;
+  host -= physAddr & (hostTlb_.pageSize() - 1);
+
+  if (write)
+    hostTlb_.insertWrite(virtAddr, privMode_, physAddr, host);
+  else
+    hostTlb_.insertRead(virtAddr, privMode_, physAddr, host);
 }
 
 
@@ -4804,11 +5195,9 @@ template <typename URV>
 void
 Hart<URV>::singleStep(FILE* traceFile)
 {
-  std::string instStr;
-
   // Single step is mostly used for follow-me mode where we want to
   // know the changes after the execution of each instruction.
-  bool doStats = instFreq_ or enableCounters_;
+  bool doStats = instFreq_ or enableCounters_ or profiler_ or bbv_;
 
   try
     {
@@ -4823,7 +5212,7 @@ Hart<URV>::singleStep(FILE* traceFile)
 
       ++instCounter_;
 
-      if (processExternalInterrupt(traceFile, instStr))
+      if (processExternalInterrupt(traceFile))
 	return;  // Next instruction in interrupt handler.
 
       if (not fetchInstWithTrigger(pc_, inst, traceFile))
@@ -4850,7 +5239,7 @@ Hart<URV>::singleStep(FILE* traceFile)
 	  if (doStats)
 	    accumulateInstructionStats(di);
 	  if (traceFile)
-	    printInstTrace(di, instCounter_, instStr, traceFile);
+	    printInstTrace(di, instCounter_, traceFile);
 	  if (dcsrStep_ and not ebreakInstDebug_)
 	    enterDebugMode_(DebugModeCause::STEP, pc_);
 	  return;
@@ -4870,7 +5259,7 @@ Hart<URV>::singleStep(FILE* traceFile)
 	accumulateInstructionStats(di);
 
       if (traceFile)
-	printInstTrace(inst, instCounter_, instStr, traceFile);
+	printInstTrace(inst, instCounter_, traceFile);
 
       // If a register is used as a source by an instruction then any
       // pending load with same register as target is removed from the
@@ -5729,9 +6118,21 @@ Hart<URV>::execute(const DecodedInst* di)
      &&vsxei64_v,
     };
 
-  const InstEntry* entry = di->instEntry();
-  size_t id = size_t(entry->instId());
-  assert(id < sizeof(labels));
+  if (not di)
+    {
+      execLabels_ = labels;
+      return;
+    }
+
+  // The label of the instruction id was looked up at decode time:
+  // This saves the entry and table loads here, nothing else (the
+  // execute code is not specialized). Decoded instructions not built
+  // by decode (e.g. with setEntry) have no label: Use the table.
+  if (di->handler())
+    goto *di->handler();
+
+  size_t id = size_t(di->instEntry()->instId());
+  assert(id < sizeof(labels)/sizeof(labels[0]));
   goto *labels[id];
 
  illegal:
@@ -7862,6 +8263,53 @@ Hart<URV>::enableInstructionFrequency(bool b)
 }
 
 
+template <typename URV>
+void
+Hart<URV>::enablePcProfile(bool flag, bool perBlock)
+{
+  if (flag)
+    profiler_ = std::make_unique<PcProfiler>(perBlock);
+  else
+    profiler_.reset();
+}
+
+
+template <typename URV>
+void
+Hart<URV>::reportPcProfile(FILE* report, FILE* folded, const std::string& prefix)
+{
+  if (not profiler_)
+    return;
+
+  auto symbolizer = [this] (uint64_t addr, std::string& name, uint64_t& start) {
+    ElfSymbol symbol;
+    if (not memory_.findElfFunction(addr, name, symbol))
+      return false;
+    start = symbol.addr_;
+    return true;
+  };
+
+  if (report)
+    profiler_->report(report, symbolizer);
+  if (folded)
+    profiler_->reportFolded(folded, symbolizer, prefix);
+}
+
+
+template <typename URV>
+void
+Hart<URV>::enableBasicBlockVectors(FILE* out, uint64_t interval)
+{
+  if (bbv_)
+    bbv_->finish();
+
+  if (out)
+    bbv_ = std::make_unique<BbvCollector>(out, interval);
+  else
+    bbv_.reset();
+}
+
+
 template <typename URV>
 void
 Hart<URV>::enterDebugMode_(DebugModeCause cause, URV pc)
@@ -8328,7 +8776,7 @@ Hart<URV>::validateAmoAddr(uint32_t rs1, uint64_t& addr, unsigned accessSize,
 
 template <typename URV>
 bool
-Hart<URV>::amoLoad32(uint32_t rs1, URV& value)
+Hart<URV>::amoLoad32(uint32_t rs1, URV& value, uint64_t& physAddr)
 {
   URV virtAddr = intRegs_.read(rs1);
 
@@ -8363,6 +8811,7 @@ Hart<URV>::amoLoad32(uint32_t rs1, URV& value)
   if (memory_.read(addr, uval))
     {
       value = SRV(int32_t(uval)); // Sign extend.
+      physAddr = addr;
       return true;  // Success.
     }
 
@@ -8374,7 +8823,7 @@ Hart<URV>::amoLoad32(uint32_t rs1, URV& value)
 
 template <typename URV>
 bool
-Hart<URV>::amoLoad64(uint32_t rs1, URV& value)
+Hart<URV>::amoLoad64(uint32_t rs1, URV& value, uint64_t& physAddr)
 {
   URV virtAddr = intRegs_.read(rs1);
 
@@ -8408,6 +8857,7 @@ Hart<URV>::amoLoad64(uint32_t rs1, URV& value)
   if (memory_.read(addr, uval))
     {
       value = SRV(int64_t(uval)); // Sign extend.
+      physAddr = addr;
       return true;  // Success.
     }
 
@@ -8515,15 +8965,19 @@ Hart<URV>::execSfence_vma(const DecodedInst* di)
       return;
     }
 
-  // Invalidate whole TLB. This is overkill. TBD FIX: Improve.
-  virtMem_.tlb_.invalidate();
+  // Invalidate the TLB entries of the given virtual address (rs1 not
+  // x0) and/or the given address space (rs2 not x0).
+  bool useVa = di->op1() != 0, useAsid = di->op2() != 0;
+  uint64_t va = useVa? intRegs_.read(di->op1()) : 0;
+  uint32_t asid = useAsid? intRegs_.read(di->op2()) : 0;
+  virtMem_.flushTlb(va, useVa, asid, useAsid);
+  hostTlb_.flush();
 
   // std::cerr << "sfence.vma " << di->op1() << ' ' << di->op2() << '\n';
   if (di->op1() == 0)
     invalidateDecodeCache();
   else
     {
-      uint64_t va = intRegs_.read(di->op1());
       uint64_t pageStart = virtMem_.pageStartAddress(va);
       uint64_t last = pageStart + virtMem_.pageSize();
       for (uint64_t addr = pageStart; addr < last; addr += 4)
@@ -8746,6 +9200,10 @@ Hart<URV>::updateStackChecker()
 
   URV val = 0;
   checkStackAccess_ = peekCsr(CsrNumber::MSPCC, val) and val != 0;
+
+  // Stack checks depend on the base register: No direct access.
+  if (checkStackAccess_)
+    hostTlbOk_ = false;
 }
 
 
@@ -9095,6 +9553,7 @@ Hart<URV>::wideStore(URV addr, URV storeVal)
       return false;
     }
 
+  virtMem_.noteStore(addr);
   return true;
 }
 
@@ -9918,6 +10377,11 @@ Hart<URV>::loadReserve(uint32_t rd, uint32_t rs1, uint64_t& physAddr)
 
   intRegs_.write(rd, value);
 
+  memory_.makeLr(hartIx_, addr, ldSize, uval);
+
+  if (caches_)
+    caches_->load(hartIx_, addr, ldSize);
+
   physAddr = addr;
   return true;
 }
@@ -9927,13 +10391,10 @@ template <typename URV>
 void
 Hart<URV>::execLr_w(const DecodedInst* di)
 {
-  std::lock_guard<std::mutex> lock(memory_.lrMutex_);
-
   lrCount_++;
   uint64_t physAddr = 0;
   if (not loadReserve<int32_t>(di->op0(), di->op1(), physAddr))
     return;
-  memory_.makeLr(hartIx_, physAddr, 4 /*size*/);
   lrSuccess_++;
 }
 
@@ -10014,9 +10475,19 @@ Hart<URV>::storeConditional(uint32_t rs1, URV virtAddr, STORE_TYPE storeVal)
   if (not memory_.hasLr(hartIx_, addr))
     return false;
 
-  if (memory_.write(hartIx_, addr, storeVal))
+  bool changed = false;  // True if location modified by another hart.
+  bool written = memory_.writeConditional(hartIx_, addr, storeVal, changed);
+  if (changed)
+    return false;
+
+  if (written)
     {
+      memory_.invalidateOtherHartLr(hartIx_, addr, sizeof(STORE_TYPE));
       invalidateDecodeCache(virtAddr, sizeof(STORE_TYPE));
+      virtMem_.noteStore(addr);
+
+      if (caches_)
+        caches_->store(hartIx_, addr, sizeof(STORE_TYPE));
 
       // If we write to special location, end the simulation.
       if (toHostValid_ and addr == toHost_ and storeVal != 0)
@@ -10036,8 +10507,6 @@ template <typename URV>
 void
 Hart<URV>::execSc_w(const DecodedInst* di)
 {
-  std::lock_guard<std::mutex> lock(memory_.lrMutex_);
-
   uint32_t rs1 = di->op1();
   URV value = intRegs_.read(di->op2());
   URV addr = intRegs_.read(rs1);
@@ -10050,7 +10519,6 @@ Hart<URV>::execSc_w(const DecodedInst* di)
 
   if (ok)
     {
-      memory_.invalidateOtherHartLr(hartIx_, addr, 4);
       intRegs_.write(di->op0(), 0); // success
       scSuccess_++;
       return;
@@ -10065,89 +10533,126 @@ Hart<URV>::execSc_w(const DecodedInst* di)
 
 
 template <typename URV>
-void
-Hart<URV>::execAmoadd_w(const DecodedInst* di)
+template <typename STORE_TYPE, typename OP>
+bool
+Hart<URV>::amoAtomic(URV virtAddr, uint64_t physAddr, URV rs2Val, OP op,
+                     URV& loaded)
 {
-  // Lock mutex to serialize AMO instructions. Unlock automatically on
-  // exit from this scope.
-  std::lock_guard<std::mutex> lock(memory_.amoMutex_);
-
-  URV loadedValue = 0;
-  uint32_t rs1 = di->op1();
-  bool loadOk = amoLoad32(rs1, loadedValue);
-  if (loadOk)
-    {
-      URV addr = intRegs_.read(rs1);
-
-      // Sign extend least significant word of register value.
-      SRV rdVal = SRV(int32_t(loadedValue));
-
-      URV rs2Val = intRegs_.read(di->op2());
-      URV result = rs2Val + rdVal;
+  // Triggers and special locations need the complete store path.
+  if (hasActiveTrigger())
+    return false;
+  if ((toHostValid_ and physAddr == toHost_) or
+      (conIoValid_ and physAddr == conIo_))
+    return false;
+  if (clintStart_ < clintLimit_ and physAddr >= clintStart_ and
+      physAddr <= clintLimit_)
+    return false;
 
-      bool storeOk = store<uint32_t>(rs1, addr, addr, uint32_t(result));
+  auto host = reinterpret_cast<STORE_TYPE*>(memory_.atomicHostAddr(physAddr,
+                                                                   sizeof(STORE_TYPE)));
+  if (not host)
+    return false;
 
-      if (storeOk and not triggerTripped_)
-	intRegs_.write(di->op0(), rdVal);
+  STORE_TYPE prev = __atomic_load_n(host, __ATOMIC_RELAXED);
+  STORE_TYPE result = 0;
+  do
+    {
+      if constexpr (sizeof(STORE_TYPE) == 4)
+        loaded = SRV(int32_t(prev));  // Sign extend.
+      else
+        loaded = prev;
+      result = STORE_TYPE(op(loaded, rs2Val));
     }
+  while (not __atomic_compare_exchange_n(host, &prev, result, true,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+
+  memory_.recordWrite(hartIx_, physAddr, prev, result);
+  memory_.invalidateOtherHartLr(hartIx_, physAddr, sizeof(STORE_TYPE));
+  invalidateDecodeCache(virtAddr, sizeof(STORE_TYPE));
+  virtMem_.noteStore(physAddr);
+  return true;
 }
 
 
 template <typename URV>
+template <typename STORE_TYPE, typename OP>
 void
-Hart<URV>::execAmoswap_w(const DecodedInst* di)
+Hart<URV>::execAmo(const DecodedInst* di, OP op)
 {
-  // Lock mutex to serialize AMO instructions. Unlock automatically on
-  // exit from this scope.
-  std::lock_guard<std::mutex> lock(memory_.amoMutex_);
+  uint32_t rs1 = di->op1();
+  URV addr = intRegs_.read(rs1);
+  URV rs2Val = intRegs_.read(di->op2());
 
   URV loadedValue = 0;
-  uint32_t rs1 = di->op1();
-  bool loadOk = amoLoad32(rs1, loadedValue);
-  if (loadOk)
-    {
-      URV addr = intRegs_.read(rs1);
+  uint64_t physAddr = 0;
+  bool loadOk = false;
+  if constexpr (sizeof(STORE_TYPE) == 4)
+    loadOk = amoLoad32(rs1, loadedValue, physAddr);
+  else
+    loadOk = amoLoad64(rs1, loadedValue, physAddr);
+  if (not loadOk)
+    return;
+
+  // In a multi-hart system, do the read-modify-write as one host
+  // atomic operation if possible. Otherwise, lock mutex to serialize
+  // AMO instructions and re-read the location under the lock. Unlock
+  // automatically on exit from this scope. The locked path is not
+  // atomic with respect to the host atomic operations of other harts:
+  // A hart with an active trigger takes it for any location, so
+  // triggers are not supported with AMOs of several harts to the same
+  // location.
+  std::unique_lock<std::mutex> lock;
+  if (not memory_.isSingleHart())
+    {
+      if (amoAtomic<STORE_TYPE>(addr, physAddr, rs2Val, op, loadedValue))
+        {
+          if (caches_)
+            caches_->store(hartIx_, physAddr, sizeof(STORE_TYPE));
+          intRegs_.write(di->op0(), loadedValue);
+          return;
+        }
 
-      // Sign extend least significant word of register value.
-      SRV rdVal = SRV(int32_t(loadedValue));
+      lock = std::unique_lock<std::mutex>(memory_.amoMutex_);
+      STORE_TYPE current = 0;
+      if (memory_.read(physAddr, current))
+        {
+          if constexpr (sizeof(STORE_TYPE) == 4)
+            loadedValue = SRV(int32_t(current));  // Sign extend.
+          else
+            loadedValue = current;
+        }
+    }
 
-      URV rs2Val = intRegs_.read(di->op2());
-      URV result = rs2Val;
+  URV result = op(loadedValue, rs2Val);
 
-      bool storeOk = store<uint32_t>(rs1, addr, addr, uint32_t(result));
+  bool storeOk = store<STORE_TYPE>(rs1, addr, addr, STORE_TYPE(result));
 
-      if (storeOk and not triggerTripped_)
-	intRegs_.write(di->op0(), rdVal);
-    }
+  if (storeOk and not triggerTripped_)
+    intRegs_.write(di->op0(), loadedValue);
 }
 
 
 template <typename URV>
 void
-Hart<URV>::execAmoxor_w(const DecodedInst* di)
+Hart<URV>::execAmoadd_w(const DecodedInst* di)
 {
-  // Lock mutex to serialize AMO instructions. Unlock automatically on
-  // exit from this scope.
-  std::lock_guard<std::mutex> lock(memory_.amoMutex_);
-
-  URV loadedValue = 0;
-  uint32_t rs1 = di->op1();
-  bool loadOk = amoLoad32(rs1, loadedValue);
-  if (loadOk)
-    {
-      URV addr = intRegs_.read(rs1);
+  execAmo<uint32_t>(di, [] (URV mem, URV reg) -> URV { return reg + mem; });
+}
 
-      // Sign extend least significant word of register value.
-      SRV rdVal = SRV(int32_t(loadedValue));
 
-      URV rs2Val = intRegs_.read(di->op2());
-      URV result = rs2Val ^ rdVal;
+template <typename URV>
+void
+Hart<URV>::execAmoswap_w(const DecodedInst* di)
+{
+  execAmo<uint32_t>(di, [] (URV, URV reg) -> URV { return reg; });
+}
 
-      bool storeOk = store<uint32_t>(rs1, addr, addr, uint32_t(result));
 
-      if (storeOk and not triggerTripped_)
-	intRegs_.write(di->op0(), rdVal);
-    }
+template <typename URV>
+void
+Hart<URV>::execAmoxor_w(const DecodedInst* di)
+{
+  execAmo<uint32_t>(di, [] (URV mem, URV reg) -> URV { return reg ^ mem; });
 }
 
 
@@ -10155,28 +10660,7 @@ template <typename URV>
 void
 Hart<URV>::execAmoor_w(const DecodedInst* di)
 {
-  // Lock mutex to serialize AMO instructions. Unlock automatically on
-  // exit from this scope.
-  std::lock_guard<std::mutex> lock(memory_.amoMutex_);
-
-  URV loadedValue = 0;
-  uint32_t rs1 = di->op1();
-  bool loadOk = amoLoad32(rs1, loadedValue);
-  if (loadOk)
-    {
-      URV addr = intRegs_.read(rs1);
-
-      // Sign extend least significant word of register value.
-      SRV rdVal = SRV(int32_t(loadedValue));
-
-      URV rs2Val = intRegs_.read(di->op2());
-      URV result = rs2Val | rdVal;
-
-      bool storeOk = store<uint32_t>(rs1, addr, addr, uint32_t(result));
-
-      if (storeOk and not triggerTripped_)
-	intRegs_.write(di->op0(), rdVal);
-    }
+  execAmo<uint32_t>(di, [] (URV mem, URV reg) -> URV { return reg | mem; });
 }
 
 
@@ -10184,28 +10668,7 @@ template <typename URV>
 void
 Hart<URV>::execAmoand_w(const DecodedInst* di)
 {
-  // Lock mutex to serialize AMO instructions. Unlock automatically on
-  // exit from this scope.
-  std::lock_guard<std::mutex> lock(memory_.amoMutex_);
-
-  URV loadedValue = 0;
-  uint32_t rs1 = di->op1();
-  bool loadOk = amoLoad32(rs1, loadedValue);
-  if (loadOk)
-    {
-      URV addr = intRegs_.read(rs1);
-
-      // Sign extend least significant word of register value.
-      SRV rdVal = SRV(int32_t(loadedValue));
-
-      URV rs2Val = intRegs_.read(di->op2());
-      URV result = rs2Val & rdVal;
-
-      bool storeOk = store<uint32_t>(rs1, addr, addr, uint32_t(result));
-
-      if (storeOk and not triggerTripped_)
-	intRegs_.write(di->op0(), rdVal);
-    }
+  execAmo<uint32_t>(di, [] (URV mem, URV reg) -> URV { return reg & mem; });
 }
 
 
@@ -10213,29 +10676,7 @@ template <typename URV>
 void
 Hart<URV>::execAmomin_w(const DecodedInst* di)
 {
-  // Lock mutex to serialize AMO instructions. Unlock automatically on
-  // exit from this scope.
-  std::lock_guard<std::mutex> lock(memory_.amoMutex_);
-
-  URV loadedValue = 0;
-  uint32_t rs1 = di->op1();
-  bool loadOk = amoLoad32(rs1, loadedValue);
-
-  if (loadOk)
-    {
-      URV addr = intRegs_.read(rs1);
-      URV rs2Val = intRegs_.read(di->op2());
-
-      int32_t w1 = int32_t(rs2Val);
-      int32_t w2 = int32_t(loadedValue);
-
-      int32_t result = (w1 < w2)? w1 : w2;
-
-      bool storeOk = store<uint32_t>(rs1, addr, addr, uint32_t(result));
-
-      if (storeOk and not triggerTripped_)
-	intRegs_.write(di->op0(), loadedValue);
-    }
+  execAmo<uint32_t>(di, [] (URV mem, URV reg) -> URV { return int32_t(reg) < int32_t(mem) ? reg : mem; });
 }
 
 
@@ -10243,30 +10684,7 @@ template <typename URV>
 void
 Hart<URV>::execAmominu_w(const DecodedInst* di)
 {
-  // Lock mutex to serialize AMO instructions. Unlock automatically on
-  // exit from this scope.
-  std::lock_guard<std::mutex> lock(memory_.amoMutex_);
-
-  URV loadedValue = 0;
-  uint32_t rs1 = di->op1();
-  bool loadOk = amoLoad32(rs1, loadedValue);
-
-  if (loadOk)
-    {
-      URV addr = intRegs_.read(rs1);
-
-      URV rs2Val = intRegs_.read(di->op2());
-
-      uint32_t w1 = uint32_t(rs2Val);
-      uint32_t w2 = uint32_t(loadedValue);
-
-      uint32_t result = (w1 < w2)? w1 : w2;
-
-      bool storeOk = store<uint32_t>(rs1, addr, addr, result);
-
-      if (storeOk and not triggerTripped_)
-	intRegs_.write(di->op0(), loadedValue);
-    }
+  execAmo<uint32_t>(di, [] (URV mem, URV reg) -> URV { return uint32_t(reg) < uint32_t(mem) ? reg : mem; });
 }
 
 
@@ -10274,29 +10692,7 @@ template <typename URV>
 void
 Hart<URV>::execAmomax_w(const DecodedInst* di)
 {
-  // Lock mutex to serialize AMO instructions. Unlock automatically on
-  // exit from this scope.
-  std::lock_guard<std::mutex> lock(memory_.amoMutex_);
-
-  URV loadedValue = 0;
-  uint32_t rs1 = di->op1();
-  bool loadOk = amoLoad32(rs1, loadedValue);
-  if (loadOk)
-    {
-      URV addr = intRegs_.read(rs1);
-
-      URV rs2Val = intRegs_.read(di->op2());
-
-      int32_t w1 = int32_t(rs2Val);
-      int32_t w2 = int32_t(loadedValue);
-
-      int32_t result = w1 > w2 ? w1 : w2;
-
-      bool storeOk = store<uint32_t>(rs1, addr, addr, uint32_t(result));
-
-      if (storeOk and not triggerTripped_)
-	intRegs_.write(di->op0(), loadedValue);
-    }
+  execAmo<uint32_t>(di, [] (URV mem, URV reg) -> URV { return int32_t(reg) > int32_t(mem) ? reg : mem; });
 }
 
 
@@ -10304,32 +10700,7 @@ template <typename URV>
 void
 Hart<URV>::execAmomaxu_w(const DecodedInst* di)
 {
-  // Lock mutex to serialize AMO instructions. Unlock automatically on
-  // exit from this scope.
-  std::lock_guard<std::mutex> lock(memory_.amoMutex_);
-
-  URV loadedValue = 0;
-  uint32_t rs1 = di->op1();
-  bool loadOk = amoLoad32(rs1, loadedValue);
-  if (loadOk)
-    {
-      URV addr = intRegs_.read(rs1);
-
-      // Sign extend least significant word of register value.
-      SRV rdVal = SRV(int32_t(loadedValue));
-
-      URV rs2Val = intRegs_.read(di->op2());
-
-      uint32_t w1 = uint32_t(rs2Val);
-      uint32_t w2 = uint32_t(rdVal);
-
-      URV result = (w1 > w2)? w1 : w2;
-
-      bool storeOk = store<uint32_t>(rs1, addr, addr, result);
-
-      if (storeOk and not triggerTripped_)
-	intRegs_.write(di->op0(), rdVal);
-    }
+  execAmo<uint32_t>(di, [] (URV mem, URV reg) -> URV { return uint32_t(reg) > uint32_t(mem) ? reg : mem; });
 }
 
 
@@ -10337,13 +10708,10 @@ template <typename URV>
 void
 Hart<URV>::execLr_d(const DecodedInst* di)
 {
-  std::lock_guard<std::mutex> lock(memory_.lrMutex_);
-
   lrCount_++;
   uint64_t physAddr = 0;
   if (not loadReserve<int64_t>(di->op0(), di->op1(), physAddr))
     return;
-  memory_.makeLr(hartIx_, physAddr, 8 /*size*/);
   lrSuccess_++;
 }
 
@@ -10352,8 +10720,6 @@ template <typename URV>
 void
 Hart<URV>::execSc_d(const DecodedInst* di)
 {
-  std::lock_guard<std::mutex> lock(memory_.lrMutex_);
-
   uint32_t rs1 = di->op1();
   URV value = intRegs_.read(di->op2());
   URV addr = intRegs_.read(rs1);
@@ -10366,7 +10732,6 @@ Hart<URV>::execSc_d(const DecodedInst* di)
 
   if (ok)
     {
-      memory_.invalidateOtherHartLr(hartIx_, addr, 8);
       intRegs_.write(di->op0(), 0); // success
       scSuccess_++;
       return;
@@ -10384,26 +10749,7 @@ template <typename URV>
 void
 Hart<URV>::execAmoadd_d(const DecodedInst* di)
 {
-  // Lock mutex to serialize AMO instructions. Unlock automatically on
-  // exit from this scope.
-  std::lock_guard<std::mutex> lock(memory_.amoMutex_);
-
-  URV loadedValue = 0;
-  uint32_t rs1 = di->op1();
-  bool loadOk = amoLoad64(rs1, loadedValue);
-  if (loadOk)
-    {
-      URV addr = intRegs_.read(rs1);
-
-      URV rdVal = loadedValue;
-      URV rs2Val = intRegs_.read(di->op2());
-      URV result = rs2Val + rdVal;
-
-      bool storeOk = store<uint64_t>(rs1, addr, addr, result);
-
-      if (storeOk and not triggerTripped_)
-	intRegs_.write(di->op0(), rdVal);
-    }
+  execAmo<uint64_t>(di, [] (URV mem, URV reg) -> URV { return reg + mem; });
 }
 
 
@@ -10411,26 +10757,7 @@ template <typename URV>
 void
 Hart<URV>::execAmoswap_d(const DecodedInst* di)
 {
-  // Lock mutex to serialize AMO instructions. Unlock automatically on
-  // exit from this scope.
-  std::lock_guard<std::mutex> lock(memory_.amoMutex_);
-
-  URV loadedValue = 0;
-  uint32_t rs1 = di->op1();
-  bool loadOk = amoLoad64(rs1, loadedValue);
-  if (loadOk)
-    {
-      URV addr = intRegs_.read(rs1);
-
-      URV rdVal = loadedValue;
-      URV rs2Val = intRegs_.read(di->op2());
-      URV result = rs2Val;
-
-      bool storeOk = store<uint64_t>(rs1, addr, addr, result);
-
-      if (storeOk and not triggerTripped_)
-	intRegs_.write(di->op0(), rdVal);
-    }
+  execAmo<uint64_t>(di, [] (URV, URV reg) -> URV { return reg; });
 }
 
 
@@ -10438,26 +10765,7 @@ template <typename URV>
 void
 Hart<URV>::execAmoxor_d(const DecodedInst* di)
 {
-  // Lock mutex to serialize AMO instructions. Unlock automatically on
-  // exit from this scope.
-  std::lock_guard<std::mutex> lock(memory_.amoMutex_);
-
-  URV loadedValue = 0;
-  uint32_t rs1 = di->op1();
-  bool loadOk = amoLoad64(rs1, loadedValue);
-  if (loadOk)
-    {
-      URV addr = intRegs_.read(rs1);
-
-      URV rdVal = loadedValue;
-      URV rs2Val = intRegs_.read(di->op2());
-      URV result = rs2Val ^ rdVal;
-
-      bool storeOk = store<uint64_t>(rs1, addr, addr, result);
-
-      if (storeOk and not triggerTripped_)
-	intRegs_.write(di->op0(), rdVal);
-    }
+  execAmo<uint64_t>(di, [] (URV mem, URV reg) -> URV { return reg ^ mem; });
 }
 
 
@@ -10465,26 +10773,7 @@ template <typename URV>
 void
 Hart<URV>::execAmoor_d(const DecodedInst* di)
 {
-  // Lock mutex to serialize AMO instructions. Unlock automatically on
-  // exit from this scope.
-  std::lock_guard<std::mutex> lock(memory_.amoMutex_);
-
-  URV loadedValue = 0;
-  uint32_t rs1 = di->op1();
-  bool loadOk = amoLoad64(rs1, loadedValue);
-  if (loadOk)
-    {
-      URV addr = intRegs_.read(rs1);
-
-      URV rdVal = loadedValue;
-      URV rs2Val = intRegs_.read(di->op2());
-      URV result = rs2Val | rdVal;
-
-      bool storeOk = store<uint64_t>(rs1, addr, addr, result);
-
-      if (storeOk and not triggerTripped_)
-	intRegs_.write(di->op0(), rdVal);
-    }
+  execAmo<uint64_t>(di, [] (URV mem, URV reg) -> URV { return reg | mem; });
 }
 
 
@@ -10492,26 +10781,7 @@ template <typename URV>
 void
 Hart<URV>::execAmoand_d(const DecodedInst* di)
 {
-  // Lock mutex to serialize AMO instructions. Unlock automatically on
-  // exit from this scope.
-  std::lock_guard<std::mutex> lock(memory_.amoMutex_);
-
-  URV loadedValue = 0;
-  uint32_t rs1 = di->op1();
-  bool loadOk = amoLoad64(rs1, loadedValue);
-  if (loadOk)
-    {
-      URV addr = intRegs_.read(rs1);
-
-      URV rdVal = loadedValue;
-      URV rs2Val = intRegs_.read(di->op2());
-      URV result = rs2Val & rdVal;
-
-      bool storeOk = store<uint64_t>(rs1, addr, addr, result);
-
-      if (storeOk and not triggerTripped_)
-	intRegs_.write(di->op0(), rdVal);
-    }
+  execAmo<uint64_t>(di, [] (URV mem, URV reg) -> URV { return reg & mem; });
 }
 
 
@@ -10519,26 +10789,7 @@ template <typename URV>
 void
 Hart<URV>::execAmomin_d(const DecodedInst* di)
 {
-  // Lock mutex to serialize AMO instructions. Unlock automatically on
-  // exit from this scope.
-  std::lock_guard<std::mutex> lock(memory_.amoMutex_);
-
-  URV loadedValue = 0;
-  uint32_t rs1 = di->op1();
-  bool loadOk = amoLoad64(rs1, loadedValue);
-  if (loadOk)
-    {
-      URV addr = intRegs_.read(rs1);
-
-      URV rdVal = loadedValue;
-      URV rs2Val = intRegs_.read(di->op2());
-      URV result = (SRV(rs2Val) < SRV(rdVal))? rs2Val : rdVal;
-
-      bool storeOk = store<uint64_t>(rs1, addr, addr, result);
-
-      if (storeOk and not triggerTripped_)
-	intRegs_.write(di->op0(), rdVal);
-    }
+  execAmo<uint64_t>(di, [] (URV mem, URV reg) -> URV { return SRV(reg) < SRV(mem) ? reg : mem; });
 }
 
 
@@ -10546,26 +10797,7 @@ template <typename URV>
 void
 Hart<URV>::execAmominu_d(const DecodedInst* di)
 {
-  // Lock mutex to serialize AMO instructions. Unlock automatically on
-  // exit from this scope.
-  std::lock_guard<std::mutex> lock(memory_.amoMutex_);
-
-  URV loadedValue = 0;
-  uint32_t rs1 = di->op1();
-  bool loadOk = amoLoad64(rs1, loadedValue);
-  if (loadOk)
-    {
-      URV addr = intRegs_.read(rs1);
-
-      URV rdVal = loadedValue;
-      URV rs2Val = intRegs_.read(di->op2());
-      URV result = (rs2Val < rdVal)? rs2Val : rdVal;
-
-      bool storeOk = store<uint64_t>(rs1, addr, addr, result);
-
-      if (storeOk and not triggerTripped_)
-	intRegs_.write(di->op0(), rdVal);
-    }
+  execAmo<uint64_t>(di, [] (URV mem, URV reg) -> URV { return reg < mem ? reg : mem; });
 }
 
 
@@ -10573,26 +10805,7 @@ template <typename URV>
 void
 Hart<URV>::execAmomax_d(const DecodedInst* di)
 {
-  // Lock mutex to serialize AMO instructions. Unlock automatically on
-  // exit from this scope.
-  std::lock_guard<std::mutex> lock(memory_.amoMutex_);
-
-  URV loadedValue = 0;
-  uint32_t rs1 = di->op1();
-  bool loadOk = amoLoad64(rs1, loadedValue);
-  if (loadOk)
-    {
-      URV addr = intRegs_.read(rs1);
-
-      URV rdVal = loadedValue;
-      URV rs2Val = intRegs_.read(di->op2());
-      URV result = (SRV(rs2Val) > SRV(rdVal))? rs2Val : rdVal;
-
-      bool storeOk = store<uint64_t>(rs1, addr, addr, result);
-
-      if (storeOk and not triggerTripped_)
-	intRegs_.write(di->op0(), rdVal);
-    }
+  execAmo<uint64_t>(di, [] (URV mem, URV reg) -> URV { return SRV(reg) > SRV(mem) ? reg : mem; });
 }
 
 
@@ -10600,26 +10813,7 @@ template <typename URV>
 void
 Hart<URV>::execAmomaxu_d(const DecodedInst* di)
 {
-  // Lock mutex to serialize AMO instructions. Unlock automatically on
-  // exit from this scope.
-  std::lock_guard<std::mutex> lock(memory_.amoMutex_);
-
-  URV loadedValue = 0;
-  uint32_t rs1 = di->op1();
-  bool loadOk = amoLoad64(rs1, loadedValue);
-  if (loadOk)
-    {
-      URV addr = intRegs_.read(rs1);
-
-      URV rdVal = loadedValue;
-      URV rs2Val = intRegs_.read(di->op2());
-      URV result = (rs2Val > rdVal)? rs2Val : rdVal;
-
-      bool storeOk = store<uint64_t>(rs1, addr, addr, result);
-
-      if (storeOk and not triggerTripped_)
-	intRegs_.write(di->op0(), rdVal);
-    }
+  execAmo<uint64_t>(di, [] (URV mem, URV reg) -> URV { return reg > mem ? reg : mem; });
 }
 
 
@@ -22,6 +22,7 @@
 #include <type_traits>
 #include <functional>
 #include <atomic>
+#include <memory>
 #include "InstId.hpp"
 #include "InstEntry.hpp"
 #include "IntRegs.hpp"
@@ -34,6 +35,13 @@
 #include "Syscall.hpp"
 #include "PmpManager.hpp"
 #include "VirtMem.hpp"
+#include "HostTlb.hpp"
+#include "HugePage.hpp"
+#include "TraceBuffer.hpp"
+#include "PcProfiler.hpp"
+#include "BbvCollector.hpp"
+#include "CacheHierarchy.hpp"
+#include "InstTrace.hpp"
 
 namespace WdRiscv
 {
@@ -379,6 +387,17 @@ namespace WdRiscv
     /// print run-time and instructions per second.
     bool untilAddress(size_t address, FILE* file = nullptr);
 
+    /// Run at most count instructions then return. This is used by
+    /// the deterministic multi-hart scheduler which interleaves harts
+    /// in fixed instruction quanta. Set finished to true if this hart
+    /// will not execute further instructions (target program
+    /// finished, stop address or instruction count limit reached,
+    /// user stop, or stop requested by a trigger/pre-instruction
+    /// callback). Return false if the target program finished with a
+    /// failure. Does not install signal handlers or print run-time:
+    /// the caller is expected to do so once for the whole run.
+    bool runQuantum(uint64_t count, FILE* file, bool& finished);
+
     /// Define the program counter value at which the run method will
     /// stop.
     void setStopAddress(URV address)
@@ -440,6 +459,19 @@ namespace WdRiscv
     /// string.
     void disassembleInst(const DecodedInst& di, std::string& str);
 
+    /// Return the disassembly of the given decoded instruction. The
+    /// text is computed once per distinct instruction code and kept in
+    /// a pool; the decoded instruction remembers its pool index so
+    /// that tracing a loop does no formatting or allocation for the
+    /// disassembly.
+    const std::string& disassembleCached(const DecodedInst& di);
+
+    /// Discard the cached disassembly strings (see disassembleCached).
+    /// Needed when the disassembly of an instruction code changes
+    /// (e.g. enabled extensions or register naming changed).
+    void clearDisassemblyCache()
+    { disasmPool_.clear(); disasmMap_.clear(); }
+
     /// Decode given instruction returning a pointer to the
     /// instruction information and filling op0, op1 and op2 with the
     /// corresponding operand specifier values. For example, if inst
@@ -726,6 +758,56 @@ namespace WdRiscv
     /// Enable collection of instruction frequencies.
     void enableInstructionFrequency(bool b);
 
+    /// Enable/disable translation of hot integer code into host code
+    /// when running in fast mode (see run). Return false if
+    /// translation is not supported on this host (enabling has no
+    /// effect in that case).
+    bool enableJit(bool flag);
+
+    /// Append instruction trace records to the given buffer (drained
+    /// by a background TraceWriter) instead of writing them directly
+    /// to the trace file. Pass null to write directly.
+    void setTraceBuffer(TraceBuffer* buffer)
+    { traceBuffer_ = buffer; }
+
+    /// Return the trace buffer of this hart or null if none.
+    TraceBuffer* traceBuffer() const
+    { return traceBuffer_; }
+
+    /// Encode instruction trace records in binary form to the given
+    /// writer instead of writing text to the trace file. Pass null to
+    /// write text. Takes precedence over setTraceBuffer.
+    void setBinaryTrace(BinaryTraceWriter* writer)
+    { binaryTrace_ = writer; }
+
+    /// Enable/disable profiling of retired instructions per program
+    /// counter and per call stack. If perBlock is true, counts are
+    /// kept per run of sequential instructions (lower overhead).
+    void enablePcProfile(bool flag, bool perBlock = false);
+
+    /// Write the PC profile report (functions and hottest addresses)
+    /// to the given report file and the call stack profile in folded
+    /// format to the given folded file. Either file may be null.
+    /// Prefix, if not empty, is used as the outermost frame of the
+    /// folded stacks. Functions are identified using the symbols of
+    /// the loaded ELF files.
+    void reportPcProfile(FILE* report, FILE* folded, const std::string& prefix);
+
+    /// Collect basic block vectors (SimPoint .bb format) writing one
+    /// line to the given file for each interval of the given number of
+    /// instructions. Intervals are delimited using the instruction
+    /// count of this hart. Pass a null file to stop collecting. The
+    /// final partial interval of a previous collection is written to
+    /// its file before that collection stops.
+    void enableBasicBlockVectors(FILE* out, uint64_t interval);
+
+    /// Send the instruction fetches, loads, and stores of this hart
+    /// to the given cache hierarchy (shared by the harts of the
+    /// system and not owned by this hart). Pass null to stop. Enabling
+    /// the hierarchy disables the host TLB and the run fast path.
+    void setCacheHierarchy(CacheHierarchy* caches)
+    { caches_ = caches; }
+
     /// Enable expedited dispatch of external interrupt handler: Instead of
     /// setting pc to the external interrupt handler, we set it to the
     /// specific entry associated with the external interrupt id.
@@ -861,7 +943,7 @@ namespace WdRiscv
     /// Enable use of ABI register names (e.g. sp instead of x2) in
     /// instruction disassembly.
     void enableAbiNames(bool flag)
-    { abiNames_ = flag; }
+    { abiNames_ = flag; clearDisassemblyCache(); }
 
     /// Return true if ABI register names are enabled.
     bool abiNames() const
@@ -1086,6 +1168,44 @@ namespace WdRiscv
     /// Load snapshot (registers, memory etc)
     bool loadSnapshot(const std::string& dirPath);
 
+    /// Save the part of a snapshot specific to this hart (registers,
+    /// used memory blocks, file descriptors, mmap blocks) into the
+    /// given directory. Set usedBlocks to the memory blocks in use by
+    /// the target program of this hart. Return true on success.
+    bool saveSnapshotState(const std::string& dirPath,
+                           std::vector<std::pair<uint64_t,uint64_t>>& usedBlocks);
+
+    /// Save the given blocks of the memory (shared by all the harts)
+    /// and the cache into the given snapshot directory. Return true on
+    /// success.
+    bool saveSnapshotMemory(const std::string& dirPath,
+                            const std::vector<std::pair<uint64_t,uint64_t>>& usedBlocks);
+
+    /// Load the part of a snapshot specific to this hart (see
+    /// saveSnapshotState). Return true on success.
+    bool loadSnapshotState(const std::string& dirPath);
+
+    /// Load the memory and cache of the snapshot in the given
+    /// directory (see saveSnapshotMemory). Return true on success.
+    bool loadSnapshotMemory(const std::string& dirPath);
+
+    /// Enable/disable incremental snapshots: When enabled, a snapshot
+    /// following a previous snapshot (saved or loaded by this hart)
+    /// stores only the memory pages modified since that snapshot
+    /// along with a manifest referring to it. Loading such a snapshot
+    /// requires the chain of previous snapshots.
+    void enableIncrementalSnapshots(bool flag)
+    {
+      memory_.enableDirtyPageTracking(flag);
+      lastSnapshotDir_.clear();
+    }
+
+    /// Save the memory of full snapshots as an uncompressed image
+    /// (file memoryimage) if flag is true, or compressed (file memory)
+    /// otherwise. An image is mapped rather than read on restore.
+    void enableSnapshotImage(bool flag)
+    { snapshotImage_ = flag; }
+
     /// Redirect the given output file descriptor (typically stdout or
     /// stderr) to the given file. Return true on success and false on
     /// failure.
@@ -1107,6 +1227,13 @@ namespace WdRiscv
     bool getSimMemAddr(size_t riscvAddr, size_t& simAddr)
     { return memory_.getSimMemAddr(riscvAddr, simAddr); }
 
+    /// Record that the host wrote size bytes of simulated memory at
+    /// the given RISCV address through an address obtained from
+    /// getSimMemAddr (e.g. the buffer of an emulated read system
+    /// call) so that those pages are part of incremental snapshots.
+    void markSimMemDirty(size_t riscvAddr, size_t size)
+    { memory_.markDirty(riscvAddr, size); }
+
     /// Report the files opened by the target RISCV program during
     /// current run.
     void reportOpenedFiles(std::ostream& out)
@@ -1179,6 +1306,19 @@ namespace WdRiscv
     void printPageTable(std::ostream& out) const
     { virtMem_.printPageTable(out); }
 
+    /// Change the geometry of the instruction TLB (instr is true) or
+    /// of the data TLB: Number of base page entries, set associativity
+    /// (zero for fully associative), and number of superpage entries.
+    /// Return true on success and false if geometry is not valid.
+    bool configureTlb(bool instr, unsigned size, unsigned ways,
+                      unsigned superSize)
+    { return virtMem_.configureTlb(instr, size, ways, superSize); }
+
+    /// Print the hit/miss counts of the instruction and data TLBs of
+    /// this hart. Each line starts with the given prefix.
+    void printTlbStats(std::ostream& out, const std::string& prefix) const
+    { virtMem_.printTlbStats(out, prefix); }
+
     /// Enable per-privilege-mode performance-counter control.
     void enablePerModeCounterControl(bool flag)
     { csRegs_.enablePerModeCounterControl(flag); }
@@ -1186,6 +1326,11 @@ namespace WdRiscv
     /// Invalidate whole cache.
     void invalidateDecodeCache();
 
+    /// Reallocate the decoded instruction cache backing it with huge
+    /// host pages if flag is true and with regular pages otherwise.
+    /// Return the kind of host pages obtained.
+    HugePageKind useHugePagesForDecodeCache(bool flag);
+
     /// Register a callback to be invoked before a CSR instruction
     /// acceses its target CSR. Callback is invoked with the
     /// hart-index (hart index in sytstem) and csr number. This is for
@@ -1307,6 +1452,17 @@ namespace WdRiscv
     /// (SATP) is updated.
     void updateAddressTranslation();
 
+    /// Features checked after each instruction by untilAddress. Each
+    /// combination selects a separate instantiation of the run loop
+    /// so that disabled features cost nothing per instruction.
+    enum UntilFeature { UntilTrace = 1, UntilTriggers = 2, UntilStats = 4,
+                        UntilGdb = 8, UntilFeatureCount = 16 };
+
+    /// Helper to untilAddress: Run loop specialized for the given
+    /// combination of UntilFeature bits.
+    template <unsigned FEATURES>
+    bool untilAddressWith(size_t address, FILE* file);
+
     /// Helper to run method: Run until toHost is written or until
     /// exit is called.
     bool simpleRun();
@@ -1319,6 +1475,39 @@ namespace WdRiscv
     /// present.
     bool simpleRunNoLimit();
 
+    /// Helper to simpleRun: Return the decoded block starting at the
+    /// current pc. Follow the successor links of the given previously
+    /// executed block (which may be null) and fall back on the block
+    /// cache, creating an empty block if none is found.
+    DecodedBlock* findBlock(DecodedBlock* prev);
+
+    /// Helper to simpleRun: Execute the instructions of the given
+    /// complete block stopping early if an instruction changes the
+    /// control flow (e.g. takes an exception) or if the block cache
+    /// is invalidated.
+    void runBlock(DecodedBlock& block);
+
+    /// Helper to simpleRun: Fetch, decode, and execute instructions
+    /// starting at the current pc appending them to the given block
+    /// until the block is complete, an exception occurs, or the
+    /// instruction counter reaches the given limit.
+    void buildBlock(DecodedBlock& block, uint64_t limit);
+
+    /// Helper to runBlock: Execute the given complete block some of
+    /// whose instructions were translated to host code.
+    void runNativeBlock(DecodedBlock& block);
+
+    /// Translate the runs of consecutive translatable instructions
+    /// of the given complete block to host code.
+    void translateBlock(DecodedBlock& block);
+
+    /// Return true if the given decoded instruction must be the last
+    /// one in a decoded block.
+    bool isBlockEnd(const DecodedInst& di) const;
+
+    /// Discard all the decoded blocks.
+    void flushBlockCache();
+
     /// Helper to decode. Used for compressed instructions.
     const InstEntry& decode16(uint16_t inst, uint32_t& op0, uint32_t& op1,
 			      uint32_t& op2);
@@ -1460,9 +1649,10 @@ namespace WdRiscv
 
     /// Helper to execLr. Load type must be int32_t, or int64_t.
     /// Return true if instruction is successful. Return false if an
-    /// exception occurs or a trigger is tripped. If successful,
-    /// physAddr is set to the result of the virtual to physical
-    /// translation of the referenced memory address.
+    /// exception occurs or a trigger is tripped. If successful, a
+    /// reservation is made and physAddr is set to the result of the
+    /// virtual to physical translation of the referenced memory
+    /// address.
     template<typename LOAD_TYPE>
     bool loadReserve(uint32_t rd, uint32_t rs1, uint64_t& physAddr);
 
@@ -1589,16 +1779,16 @@ namespace WdRiscv
     /// Write trace information about the given instruction to the
     /// given file. This is assumed to be called after instruction
     /// execution. Tag is the record tag (the retired instruction
-    /// count after instruction is executed). Tmp is a temporary
-    /// string (for performance).
-    void printInstTrace(const DecodedInst& di, uint64_t tag, std::string& tmp,
-			FILE* out, bool interrupt = false);
+    /// count after instruction is executed). The disassembly comes
+    /// from the disassembly cache (see disassembleCached).
+    void printInstTrace(const DecodedInst& di, uint64_t tag, FILE* out,
+			bool interrupt = false);
 
     /// Variant of the preceding method for cases where the trace is
     /// printed before decode. If the instruction is not available
     /// then a zero (illegal) value is required.
-    void printInstTrace(uint32_t instruction, uint64_t tag, std::string& tmp,
-			FILE* out, bool interrupt = false);
+    void printInstTrace(uint32_t instruction, uint64_t tag, FILE* out,
+			bool interrupt = false);
 
     /// Start a synchronous exceptions.
     void initiateException(ExceptionCause cause, URV pc, URV info,
@@ -1624,14 +1814,22 @@ namespace WdRiscv
     /// interrupt is pending and interrupts are enabled, then take
     /// it. Return true if an nmi or an interrupt is taken and false
     /// otherwise.
-    bool processExternalInterrupt(FILE* traceFile, std::string& insStr);
+    bool processExternalInterrupt(FILE* traceFile);
+
+    /// Recompute interruptCheck_ from the MIP/MIE CSRs and the
+    /// pending non-maskable interrupt. Called whenever one of those
+    /// changes.
+    void updateInterruptCheck()
+    { interruptCheck_ = nmiPending_ or (csRegs_.peekMip() & csRegs_.peekMie()) != 0; }
 
     /// Helper to FP execution: Set the given flag value (ored values
     /// ok) in FCSR. No-op if a trigger has already tripped.
     void setFcsrFlags(FpFlags value);
 
     /// Execute decoded instruction. Branch/jump instructions will
-    /// modify pc_.
+    /// modify pc_. If di is null, no instruction is executed and
+    /// execLabels_ is set to the table of execute code addresses
+    /// indexed by instruction id.
     void execute(const DecodedInst* di);
 
     /// Helper to decode: Decode instructions associated with opcode
@@ -1699,19 +1897,87 @@ namespace WdRiscv
     /// true on success putting the loaded value in val. Return false
     /// if a trigger tripped or an exception took place in which case
     /// val is not modified. The loaded word is sign extended to fill
-    /// the URV value (this is relevant for rv64).
-    bool amoLoad32(uint32_t rs1, URV& val);
+    /// the URV value (this is relevant for rv64). On success, physAddr
+    /// is set to the physical address of the loaded word.
+    bool amoLoad32(uint32_t rs1, URV& val, uint64_t& physAddr);
 
     /// Do the load value part of a double-word-sized AMO
     /// instruction. Return true on success putting the loaded value
     /// in val. Return false if a trigger tripped or an exception took
-    /// place in which case val is not modified.
-    bool amoLoad64(uint32_t rs1, URV& val);
+    /// place in which case val is not modified. On success, physAddr
+    /// is set to the physical address of the loaded double-word.
+    bool amoLoad64(uint32_t rs1, URV& val, uint64_t& physAddr);
+
+    /// Execute an AMO instruction: STORE_TYPE is uint32_t or uint64_t
+    /// and op computes the value to store from the loaded value
+    /// (sign extended) and the value of rs2.
+    template <typename STORE_TYPE, typename OP>
+    void execAmo(const DecodedInst* di, OP op);
+
+    /// Helper to execAmo in multi-hart systems: Apply op to the
+    /// location at the given physical address (already validated by
+    /// amoLoad32/amoLoad64) as one host atomic read-modify-write and
+    /// set loaded to the value found there (sign extended). Return
+    /// false without doing anything if the location is not plain
+    /// memory or needs the complete store path (triggers, to-host,
+    /// console-io, clint).
+    template <typename STORE_TYPE, typename OP>
+    bool amoAtomic(URV virtAddr, uint64_t physAddr, URV rs2Val, OP op,
+                   URV& loaded);
+
+    /// Recompute hostTlbOk_ from the features that need every load
+    /// and store to go through the complete checks and flush the
+    /// host TLB. Called at the start of a run.
+    void updateHostTlb();
+
+    /// Return true if the current load/store may use the host TLB.
+    bool useHostTlb() const
+    { return hostTlbOk_ and not mstatusMprv_ and not wideLdSt_ and not forceAccessFail_; }
+
+    /// Helper to load/store: Insert the page of the given virtual
+    /// address, which was accessed (written if write is true) without
+    /// exception at the given physical address, in the host TLB
+    /// unless accesses to that page need the complete checks.
+    void fillHostTlb(uint64_t virtAddr, uint64_t physAddr, bool write);
+
+    /// Return the host address of the byte at the given physical
+    /// address if every aligned access (write access if write is
+    /// true) to the host-TLB page containing that address can be done
+    /// directly on host memory. Return null otherwise.
+    uint8_t* directHostAddr(uint64_t physAddr, bool write);
 
     /// Invalidate cache entries overlapping the bytes written by a
-    /// store.
+    /// store. This is a no-op unless the bytes are in a page marked
+    /// as containing decoded instructions (see markCodePages).
     void invalidateDecodeCache(URV addr, unsigned storeSize);
 
+    /// Mark the pages of the given address range as containing
+    /// decoded instructions.
+    void markCodePages(URV addr, unsigned size)
+    {
+      size_t first = memory_.getPageIx(addr);
+      size_t last = memory_.getPageIx(addr + size - 1);
+      for (size_t page = first; ; ++page)
+        {
+          if ((page & codeMask_) < codePages_.size())
+            codePages_[page & codeMask_] = true;
+          else
+            codeOutside_ = true;
+          if (page == last)
+            break;
+        }
+    }
+
+    /// Return true if the page of the given address may contain
+    /// decoded instructions.
+    bool isCodePage(URV addr) const
+    {
+      size_t page = memory_.getPageIx(addr) & codeMask_;
+      if (page < codePages_.size())
+        return codePages_[page];
+      return codeOutside_;
+    }
+
     /// Update stack checker parameters after a write/poke to a CSR.
     void updateStackChecker();
 
@@ -2058,6 +2324,22 @@ namespace WdRiscv
     void execVsetvli(const DecodedInst*);
     void execVsetvl(const DecodedInst*);
 
+    /// Bulk path for integer vector-vector operations: Set element ix
+    /// of vd to op(vs1[ix], vs2[ix]) for the active elements in
+    /// [start, elems) operating on whole register groups at a time.
+    /// Return false without changing anything if the element type is
+    /// not a native integer or if the operand groups are invalid or
+    /// partially overlap, in which case caller must use the per-element
+    /// path.
+    template<typename ELEM_TYPE, typename OP>
+    bool vecBulkVv(unsigned vd, unsigned vs1, unsigned vs2, unsigned group,
+                   unsigned start, unsigned elems, bool masked, OP op);
+
+    /// Bulk path for integer vector-scalar operations. See vecBulkVv.
+    template<typename ELEM_TYPE, typename OP>
+    bool vecBulkVx(unsigned vd, unsigned vs1, ELEM_TYPE e2, unsigned group,
+                   unsigned start, unsigned elems, bool masked, OP op);
+
     template<typename ELEM_TYPE>
     void vadd_vv(unsigned vd, unsigned vs1, unsigned vs2, unsigned group,
                  unsigned start, unsigned elems, bool masked);
@@ -2653,6 +2935,37 @@ namespace WdRiscv
     void execVnclip_wx(const DecodedInst*);
     void execVnclip_wi(const DecodedInst*);
 
+    /// Helper to the unit-stride and strided vector load methods: Load
+    /// the elements of indices start to elemCount-1 of register group
+    /// vd from addresses base + ix*stride. Elements in the same page
+    /// are loaded directly from host memory after checking address
+    /// translation and permissions once for that page when the
+    /// instruction is not masked and not fault-only-first.
+    template <typename ELEM_TYPE>
+    void vectorLoadElems(unsigned vd, unsigned rs1, unsigned groupX8,
+                         uint64_t stride, bool masked, bool faultFirst);
+
+    /// Helper to vectorLoadElems: Load the elements of indices ix to
+    /// at most elemCount-1 whose addresses fall in the page of the
+    /// element of index ix directly from host memory. Return the
+    /// number of loaded elements which is zero if the element of
+    /// index ix is misaligned, crosses a page boundary, would take an
+    /// exception, or is in a page that must go through the complete
+    /// checks.
+    template <typename ELEM_TYPE>
+    unsigned vectorLoadPage(unsigned vd, unsigned rs1, unsigned groupX8,
+                            unsigned ix, unsigned elemCount, uint64_t stride);
+
+    /// Store counterpart to vectorLoadElems.
+    template <typename ELEM_TYPE>
+    void vectorStoreElems(unsigned vs3, unsigned rs1, unsigned groupX8,
+                          uint64_t stride, bool masked);
+
+    /// Store counterpart to vectorLoadPage.
+    template <typename ELEM_TYPE>
+    unsigned vectorStorePage(unsigned vs3, unsigned rs1, unsigned groupX8,
+                             unsigned ix, unsigned elemCount, uint64_t stride);
+
     template <typename ELEM_TYPE>
     void vectorLoad(const DecodedInst*, ElementWidth, bool faultOnFirstOnly);
 
@@ -2823,6 +3136,17 @@ namespace WdRiscv
 
     void loadQueueCommit(const DecodedInst&);
 
+    /// Set chain to the canonical paths of the snapshot directories
+    /// starting with the given one and following the bases of
+    /// incremental snapshots down to a full one (last in chain).
+    /// Return false if a manifest is invalid or the chain has a cycle.
+    bool snapshotChain(const std::string& dir, std::vector<std::string>& chain);
+
+    /// Load the memory of the snapshot in the given directory
+    /// following the chain of incremental snapshots down to a full
+    /// one.
+    bool loadSnapshotMemoryChain(const std::string& dir);
+
     /// Save snapshot of registers (PC, integer, floating point, CSR) into file
     bool saveSnapshotRegs(const std::string& path);
 
@@ -2890,6 +3214,7 @@ namespace WdRiscv
 
     URV nmiPc_ = 0;              // Non-maskable interrupt handler address.
     bool nmiPending_ = false;
+    bool interruptCheck_ = false; // True if nmi pending or (mip & mie) != 0.
     NmiCause nmiCause_ = NmiCause::UNKNOWN;
     bool nmiEnabled_ = true;
 
@@ -3010,11 +3335,40 @@ namespace WdRiscv
     std::vector<bool> regionHasMemMappedRegs_;
 
     // Decoded instruction cache.
-    std::vector<DecodedInst> decodeCache_;
+    std::vector<DecodedInst, HugePageAllocator<DecodedInst>> decodeCache_;
     uint32_t decodeCacheSize_ = 0;
     uint32_t decodeCacheMask_ = 0;  // Derived from decodeCacheSize_
+    void** execLabels_ = nullptr;   // Execute code indexed by InstId.
+    std::vector<bool> codePages_;   // Pages with decoded instructions.
+    size_t codeMask_ = ~size_t(0);  // Page number mask (see Hart constructor).
+    bool codeOutside_ = false;      // Decoded instructions beyond codePages_.
+
+    HostTlb hostTlb_;          // Host pages of recently accessed data pages.
+    bool hostTlbOk_ = false;   // True if hostTlb_ may be used (during a run).
+
+    // Decoded basic blocks (used in simpleRun) indexed by address.
+    std::unordered_map<uint64_t, DecodedBlock> blockCache_;
+    size_t blockCacheLimit_ = 64*1024;  // Max number of blocks in cache.
+    bool blockFlush_ = false;  // True if block cache must be flushed.
+    std::unique_ptr<Jit> jit_;  // Translator of hot blocks (null if disabled).
+    uint32_t jitThreshold_ = 16;  // Block executions before translation.
+
+    TraceBuffer* traceBuffer_ = nullptr;  // Buffered tracing if non-null.
+    std::string traceLine_;    // Trace record being formatted.
+    InstTraceRecord traceRecord_;  // Trace record being collected.
+
+    // Disassembly cache: Pool of (instruction code, text) pairs and map
+    // of instruction code to pool index plus 1.
+    std::vector<std::pair<uint32_t, std::string>> disasmPool_;
+    std::unordered_map<uint32_t, uint32_t> disasmMap_;
+    BinaryTraceWriter* binaryTrace_ = nullptr;  // Binary tracing if non-null.
+    std::unique_ptr<PcProfiler> profiler_;      // PC profiling if non-null.
+    std::unique_ptr<BbvCollector> bbv_;         // Basic block vectors if non-null.
+    CacheHierarchy* caches_ = nullptr;          // Cache model if non-null.
 
     uint32_t snapshotIx_ = 0;
+    std::string lastSnapshotDir_;   // Base of next incremental snapshot.
+    bool snapshotImage_ = false;    // Save uncompressed memory image.
 
     // Following is for test-bench support. It allow us to cancel div/rem
     bool hasLastDiv_ = false;
@@ -808,6 +808,45 @@ applyVectorConfig(Hart<URV>& hart, const nlohmann::json& config)
 }
 
 
+template <typename URV>
+static
+bool
+applyTlbConfig(Hart<URV>& hart, const nlohmann::json& config)
+{
+  if (not config.count("tlb"))
+    return true;  // Nothing to apply
+
+  unsigned errors = 0;
+  const auto& tconf = config.at("tlb");
+
+  for (const char* name : { "itlb", "dtlb" })
+    {
+      if (not tconf.count(name))
+        continue;
+
+      const auto& conf = tconf.at(name);
+      std::string prefix = std::string("tlb.") + name;
+
+      unsigned size = 64, ways = 4, superSize = 8;
+      if (conf.count("entries") and
+          not getJsonUnsigned(prefix + ".entries", conf.at("entries"), size))
+        errors++;
+      else if (conf.count("ways") and
+               not getJsonUnsigned(prefix + ".ways", conf.at("ways"), ways))
+        errors++;
+      else if (conf.count("superpage_entries") and
+               not getJsonUnsigned(prefix + ".superpage_entries",
+                                   conf.at("superpage_entries"), superSize))
+        errors++;
+      else if (not hart.configureTlb(std::string(name) == "itlb", size, ways,
+                                     superSize))
+        errors++;
+    }
+
+  return errors == 0;
+}
+
+
 template <typename URV>
 static
 bool
@@ -1264,6 +1303,9 @@ HartConfig::applyConfig(Hart<URV>& hart, bool userMode, bool verbose) const
   if (not applyVectorConfig(hart, *config_))
     errors++;
 
+  if (not applyTlbConfig(hart, *config_))
+    errors++;
+
   tag = "load_data_trigger";
   if (config_ -> count(tag))
     {
@@ -1338,6 +1380,108 @@ HartConfig::configMemory(System<URV>& system, bool iccmRw, bool unmappedElfOk,
 }
 
 
+/// Set params to the cache parameters in the given json object
+/// (size, line_size, ways, replacement, write_back, write_allocate)
+/// keeping the default value of the missing fields. Return true on
+/// success and false on failure.
+static bool
+getCacheParams(const std::string& tag, const nlohmann::json& js,
+               CacheParams& params)
+{
+  if (not js.is_object())
+    {
+      std::cerr << "Invalid " << tag << " entry in config file: Expecting an object\n";
+      return false;
+    }
+
+  unsigned errors = 0;
+
+  if (js.count("size") and not getJsonUnsigned(tag + ".size", js.at("size"), params.size_))
+    errors++;
+  if (js.count("line_size") and
+      not getJsonUnsigned(tag + ".line_size", js.at("line_size"), params.lineSize_))
+    errors++;
+  if (js.count("ways") and not getJsonUnsigned(tag + ".ways", js.at("ways"), params.ways_))
+    errors++;
+  if (js.count("write_back") and
+      not getJsonBoolean(tag + ".write_back", js.at("write_back"), params.writeBack_))
+    errors++;
+  if (js.count("write_allocate") and
+      not getJsonBoolean(tag + ".write_allocate", js.at("write_allocate"),
+                         params.writeAllocate_))
+    errors++;
+
+  if (js.count("replacement"))
+    {
+      const auto& item = js.at("replacement");
+      if (not item.is_string() or
+          not Cache::parsePolicy(item.get<std::string>(), params.policy_))
+        {
+          std::cerr << "Invalid " << tag << ".replacement in config file: "
+                    << "Expecting random, lru, or plru\n";
+          errors++;
+        }
+    }
+
+  return errors == 0;
+}
+
+
+template<typename URV>
+bool
+HartConfig::configCaches(System<URV>& system) const
+{
+  if (not config_ -> count("caches"))
+    return true;
+
+  const auto& caches = config_ -> at("caches");
+  if (not caches.is_object())
+    {
+      std::cerr << "Invalid caches entry in config file: Expecting an object\n";
+      return false;
+    }
+
+  unsigned errors = 0;
+  CacheParams l1i, l1d;
+  std::vector<CacheParams> shared;
+
+  for (auto it = caches.begin(); it != caches.end(); ++it)
+    {
+      const std::string& level = it.key();
+      std::string tag = "caches." + level;
+      CacheParams params;
+      if (not getCacheParams(tag, it.value(), params))
+        {
+          errors++;
+          continue;
+        }
+
+      if (level == "l1i")
+        l1i = params;
+      else if (level == "l1d")
+        l1d = params;
+      else if (level.size() == 2 and level.at(0) == 'l' and level.at(1) >= '2' and
+               level.at(1) <= '9')
+        {
+          size_t ix = level.at(1) - '2';
+          if (shared.size() <= ix)
+            shared.resize(ix + 1);
+          shared.at(ix) = params;
+        }
+      else
+        {
+          std::cerr << "Unknown cache level in config file: " << tag << '\n';
+          errors++;
+        }
+    }
+
+  if (errors)
+    return false;
+
+  return system.configureCaches(l1i, l1d, shared);
+}
+
+
 bool
 HartConfig::getXlen(unsigned& xlen) const
 {
@@ -1393,6 +1537,16 @@ HartConfig::getMemorySize(size_t& memSize) const
 }
 
 
+bool
+HartConfig::getHugePages(bool& flag) const
+{
+  if (not config_ -> count("huge_pages"))
+    return false;
+
+  return getJsonBoolean("huge_pages", config_ -> at("huge_pages"), flag);
+}
+
+
 bool
 HartConfig::userModeEnabled() const
 {
@@ -1825,6 +1979,12 @@ HartConfig::configMemory(System<uint32_t>&, bool, bool, bool) const;
 template bool
 HartConfig::configMemory(System<uint64_t>&, bool, bool, bool) const;
 
+template bool
+HartConfig::configCaches(System<uint32_t>&) const;
+
+template bool
+HartConfig::configCaches(System<uint64_t>&) const;
+
 
 template bool
 HartConfig::applyMemoryConfig<uint32_t>(Hart<uint32_t>&, bool, bool) const;
@@ -64,6 +64,13 @@ namespace WdRiscv
     bool configMemory(System<URV>& system, bool iccmRw, bool unmappedElfOf,
                       bool verbose) const;
 
+    /// Configure the cache hierarchy of the performance model from
+    /// the "caches" section of this object (l1i, l1d, l2, l3). Do
+    /// nothing if there is no such section. Return true on success
+    /// and false on failure.
+    template<typename URV>
+    bool configCaches(System<URV>& system) const;
+
     /// Apply the memory configuration in this object. Helper to configMemory.
     template<typename URV>
     bool applyMemoryConfig(Hart<URV>&, bool iccmRw, bool verbose) const;
@@ -93,6 +100,12 @@ namespace WdRiscv
     /// not contain a memory size configuration.
     bool getMemorySize(size_t& memSize) const;
 
+    /// Set flag to the huge pages configuration (back memory and
+    /// decode caches with huge host pages) held in this object
+    /// returning true on success and false if this object does not
+    /// contain such a configuration.
+    bool getHugePages(bool& flag) const;
+
     /// Return true if the reset value of the MISA CSR has the user
     /// extension enabled. Return false if MISA CSR is not present in
     /// this configuration or if user extension is not enabled.
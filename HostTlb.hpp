@@ -0,0 +1,132 @@
+// Copyright 2020 Western Digital Corporation or its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "trapEnums.hpp"
+
+namespace WdRiscv
+{
+
+  /// Software TLB mapping a virtual page to the host memory backing
+  /// the corresponding physical page. A page is inserted only after
+  /// a load (or store) to it passed all the checks (translation,
+  /// physical memory attributes and protection) and only if those
+  /// checks have the same outcome for every aligned access to the
+  /// page. An aligned access hitting in this TLB can then be done
+  /// directly on host memory. Read and write entries are kept
+  /// separately for each privilege mode. The TLB is direct mapped.
+  class HostTlb
+  {
+  public:
+
+    /// Define a TLB with the given number of entries (must be a
+    /// power of 2) per access type and privilege mode for pages of
+    /// the given size (must be a power of 2).
+    HostTlb(unsigned size = 256, unsigned pageSize = 4096)
+      : size_(size), mask_(size - 1), readEntries_(4*size),
+        writeEntries_(4*size)
+    {
+      pageShift_ = 0;
+      while ((1u << pageShift_) < pageSize)
+        pageShift_++;
+      pageMask_ = (uint64_t(1) << pageShift_) - 1;
+    }
+
+    /// Return the host address corresponding to the given virtual
+    /// address for a read in the given privilege mode or null if the
+    /// page of the address is not in this TLB.
+    uint8_t* findRead(uint64_t addr, PrivilegeMode mode) const
+    { return find(readEntries_, addr, mode); }
+
+    /// Same as findRead but for a write. On a hit, set physAddr to
+    /// the physical address corresponding to the given address.
+    uint8_t* findWrite(uint64_t addr, PrivilegeMode mode,
+                       uint64_t& physAddr) const
+    {
+      uint64_t pageNum = addr >> pageShift_;
+      const Entry& entry = writeEntries_[index(pageNum, mode)];
+      if (entry.virtPageNum_ != pageNum)
+        return nullptr;
+      physAddr = entry.physPage_ + (addr & pageMask_);
+      return entry.hostPage_ + (addr & pageMask_);
+    }
+
+    /// Associate the page of the given virtual address with the given
+    /// physical address and host page address (address of first byte
+    /// of page) for reads in the given privilege mode.
+    void insertRead(uint64_t addr, PrivilegeMode mode, uint64_t physAddr,
+                    uint8_t* hostPage)
+    { insert(readEntries_, addr, mode, physAddr, hostPage); }
+
+    /// Same as insertRead but for writes.
+    void insertWrite(uint64_t addr, PrivilegeMode mode, uint64_t physAddr,
+                     uint8_t* hostPage)
+    { insert(writeEntries_, addr, mode, physAddr, hostPage); }
+
+    /// Invalidate all entries.
+    void flush()
+    {
+      for (auto& entry : readEntries_)
+        entry = Entry();
+      for (auto& entry : writeEntries_)
+        entry = Entry();
+    }
+
+    /// Return the page size of this TLB.
+    uint64_t pageSize() const
+    { return pageMask_ + 1; }
+
+  private:
+
+    struct Entry
+    {
+      uint64_t virtPageNum_ = ~uint64_t(0);  // All ones if invalid.
+      uint64_t physPage_ = 0;   // Physical address of page.
+      uint8_t* hostPage_ = nullptr;
+    };
+
+    uint8_t* find(const std::vector<Entry>& entries, uint64_t addr,
+                  PrivilegeMode mode) const
+    {
+      uint64_t pageNum = addr >> pageShift_;
+      const Entry& entry = entries[index(pageNum, mode)];
+      if (entry.virtPageNum_ != pageNum)
+        return nullptr;
+      return entry.hostPage_ + (addr & pageMask_);
+    }
+
+    void insert(std::vector<Entry>& entries, uint64_t addr,
+                PrivilegeMode mode, uint64_t physAddr, uint8_t* hostPage)
+    {
+      uint64_t pageNum = addr >> pageShift_;
+      Entry& entry = entries[index(pageNum, mode)];
+      entry.virtPageNum_ = pageNum;
+      entry.physPage_ = physAddr & ~pageMask_;
+      entry.hostPage_ = hostPage;
+    }
+
+    size_t index(uint64_t pageNum, PrivilegeMode mode) const
+    { return (size_t(mode) & 3) * size_ + (pageNum & mask_); }
+
+    unsigned size_;
+    uint64_t mask_;
+    unsigned pageShift_ = 12;
+    uint64_t pageMask_ = 0xfff;
+    std::vector<Entry> readEntries_;
+    std::vector<Entry> writeEntries_;
+  };
+}
@@ -0,0 +1,186 @@
+// Copyright 2020 Western Digital Corporation or its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#ifndef __MINGW64__
+#include <sys/mman.h>
+#endif
+
+namespace WdRiscv
+{
+
+  /// Kind of host pages obtained for a huge page allocation.
+  enum class HugePageKind
+    {
+      None,         // Regular host pages.
+      Transparent,  // Regular mapping advised for transparent huge pages.
+      HugeTlb       // Mapping from the explicit huge page pool.
+    };
+
+
+  /// Return a printable name for the given huge page kind.
+  inline const char* hugePageKindName(HugePageKind kind)
+  {
+    switch (kind)
+      {
+      case HugePageKind::Transparent: return "transparent huge pages";
+      case HugePageKind::HugeTlb:     return "huge pages (hugetlb)";
+      default:                        return "regular pages";
+      }
+  }
+
+
+  /// Size of a huge host page (x86-64/aarch64 default).
+  constexpr size_t hugePageSize = size_t(2) << 20;
+
+
+  /// Return the given size rounded up to a multiple of the huge
+  /// page size.
+  inline size_t hugePageRoundUp(size_t size)
+  { return (size + hugePageSize - 1) & ~(hugePageSize - 1); }
+
+
+  /// Map zero-filled host memory of the given size (rounded up to a
+  /// multiple of the huge page size) trying first the explicit huge
+  /// page pool then falling back to a regular mapping advised for
+  /// transparent huge pages. Set kind to the kind of pages
+  /// obtained. Return null on failure. Memory must be released with
+  /// unmapHugePages using the same size.
+  inline void* mapHugePages(size_t size, HugePageKind& kind)
+  {
+    kind = HugePageKind::None;
+#ifndef __MINGW64__
+    size = hugePageRoundUp(size);
+    int prot = PROT_READ | PROT_WRITE;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+
+#ifdef MAP_HUGETLB
+    // No MAP_NORESERVE here: the pool pages must be reserved up front
+    // otherwise touching a page the pool cannot supply raises SIGBUS.
+    int hugeFlags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+    void* mem = mmap(nullptr, size, prot, hugeFlags, -1, 0);
+    if (mem != MAP_FAILED)
+      {
+        kind = HugePageKind::HugeTlb;
+        return mem;
+      }
+#endif
+
+    void* mem2 = mmap(nullptr, size, prot, flags, -1, 0);
+    if (mem2 == MAP_FAILED)
+      return nullptr;
+#ifdef MADV_HUGEPAGE
+    if (madvise(mem2, size, MADV_HUGEPAGE) == 0)
+      kind = HugePageKind::Transparent;
+#endif
+    return mem2;
+#else
+    (void) size;
+    return nullptr;
+#endif
+  }
+
+
+  /// Release memory obtained with mapHugePages.
+  inline void unmapHugePages(void* mem, size_t size)
+  {
+#ifndef __MINGW64__
+    if (mem)
+      munmap(mem, hugePageRoundUp(size));
+#else
+    (void) mem; (void) size;
+#endif
+  }
+
+
+  /// Standard-library allocator that, when enabled, obtains its
+  /// memory with mapHugePages (falling back to operator new if that
+  /// fails). Used for large tables indexed at random (e.g. decoded
+  /// instruction cache) to reduce host TLB misses.
+  template <typename T>
+  class HugePageAllocator
+  {
+  public:
+
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    HugePageAllocator(bool enable = false)
+      : enable_(enable)
+    { }
+
+    template <typename U>
+    HugePageAllocator(const HugePageAllocator<U>& other)
+      : enable_(other.enabled()), kind_(other.kind())
+    { }
+
+    T* allocate(size_t n)
+    {
+      size_t bytes = n * sizeof(T);
+      if (enable_ and bytes >= hugePageSize)
+        {
+          void* mem = mapHugePages(bytes + sizeof(Header), kind_);
+          if (mem)
+            {
+              reinterpret_cast<Header*>(mem)->mapped_ = true;
+              return reinterpret_cast<T*>(static_cast<Header*>(mem) + 1);
+            }
+        }
+      void* mem = ::operator new(bytes + sizeof(Header));
+      static_cast<Header*>(mem)->mapped_ = false;
+      return reinterpret_cast<T*>(static_cast<Header*>(mem) + 1);
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+      Header* header = reinterpret_cast<Header*>(p) - 1;
+      if (header->mapped_)
+        unmapHugePages(header, n * sizeof(T) + sizeof(Header));
+      else
+        ::operator delete(header);
+    }
+
+    /// Return true if huge pages were requested for this allocator.
+    bool enabled() const
+    { return enable_; }
+
+    /// Return the kind of host pages obtained by the most recent
+    /// allocation.
+    HugePageKind kind() const
+    { return kind_; }
+
+    bool operator==(const HugePageAllocator& other) const
+    { return enable_ == other.enable_; }
+
+    bool operator!=(const HugePageAllocator& other) const
+    { return not (*this == other); }
+
+  private:
+
+    // Precedes each allocation to record how it was obtained. Sized
+    // to preserve the alignment of the elements.
+    struct alignas(std::max_align_t) Header
+    {
+      bool mapped_ = false;
+    };
+
+    bool enable_ = false;
+    HugePageKind kind_ = HugePageKind::None;
+  };
+}
@@ -0,0 +1,553 @@
+// Copyright 2020 Western Digital Corporation or its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <cinttypes>
+#include <unistd.h>
+#include <zlib.h>
+#include "InstTrace.hpp"
+
+using namespace WdRiscv;
+
+
+/// Append to the given string a record of the instruction trace.
+template <typename URV>
+static void
+formatInstTrace(std::string& out, uint64_t tag, unsigned hartId, URV currPc,
+		const char* opcode, char resource, URV addr,
+		URV value, const char* assembly);
+
+template <>
+void
+formatInstTrace<uint32_t>(std::string& out, uint64_t tag, unsigned hartId, uint32_t currPc,
+		const char* opcode, char resource, uint32_t addr,
+		uint32_t value, const char* assembly)
+{
+  char buff[256];
+  if (resource == 'r' or resource == 'v')
+    {
+      snprintf(buff, sizeof(buff), "#%" PRId64 " %d %08x %8s r %02x         %08x  ",
+               tag, hartId, currPc, opcode, addr, value);
+    }
+  else if (resource == 'c')
+    {
+      if ((addr >> 16) == 0)
+        snprintf(buff, sizeof(buff), "#%" PRId64 " %d %08x %8s c %04x       %08x  ",
+                 tag, hartId, currPc, opcode, addr, value);
+      else
+        snprintf(buff, sizeof(buff), "#%" PRId64 " %d %08x %8s c %08x   %08x  ",
+                 tag, hartId, currPc, opcode, addr, value);
+    }
+  else
+    {
+      snprintf(buff, sizeof(buff), "#%" PRId64 " %d %08x %8s %c %08x   %08x  ", tag,
+               hartId, currPc, opcode, resource, addr, value);
+    }
+  out += buff;
+  out += assembly;
+}
+
+template <>
+void
+formatInstTrace<uint64_t>(std::string& out, uint64_t tag, unsigned hartId, uint64_t currPc,
+		const char* opcode, char resource, uint64_t addr,
+		uint64_t value, const char* assembly)
+{
+  char buff[256];
+  snprintf(buff, sizeof(buff), "#%" PRId64 " %d %016" PRIx64 " %8s %c %016" PRIx64 " %016" PRIx64 "  ",
+           tag, hartId, currPc, opcode, resource, addr, value);
+  out += buff;
+  out += assembly;
+}
+
+template <typename URV>
+static void
+formatFpInstTrace(std::string& out, uint64_t tag, unsigned hartId, URV currPc,
+		  const char* opcode, unsigned fpReg,
+		  uint64_t fpVal, const char* assembly);
+
+template <>
+void
+formatFpInstTrace<uint32_t>(std::string& out, uint64_t tag, unsigned hartId, uint32_t currPc,
+		  const char* opcode, unsigned fpReg,
+		  uint64_t fpVal, const char* assembly)
+{
+  char buff[256];
+  snprintf(buff, sizeof(buff), "#%" PRId64 " %d %08x %8s f %02x %016" PRIx64 "  ",
+           tag, hartId, currPc, opcode, fpReg, fpVal);
+  out += buff;
+  out += assembly;
+}
+
+template <>
+void
+formatFpInstTrace<uint64_t>(std::string& out, uint64_t tag, unsigned hartId, uint64_t currPc,
+		  const char* opcode, unsigned fpReg,
+		  uint64_t fpVal, const char* assembly)
+{
+  char buff[256];
+  snprintf(buff, sizeof(buff), "#%" PRId64 " %d %016" PRIx64 " %8s f %016" PRIx64 " %016" PRIx64 "  ",
+           tag, hartId, currPc, opcode, uint64_t(fpReg), fpVal);
+  out += buff;
+  out += assembly;
+}
+
+
+
+template <typename URV>
+static void
+formatRecord(const InstTraceRecord& rec, std::string& out)
+{
+  std::string tmp = rec.disasm_;
+  if (rec.interrupted_)
+    tmp += " (interrupted)";
+
+  char buff[64];
+  if (rec.hasLdSt_)
+    {
+      snprintf(buff, sizeof(buff), " [0x%" PRIx64 "]", rec.ldSt_);
+      tmp += buff;
+    }
+
+  char instBuff[16];
+  if (rec.instSize_ == 4)
+    snprintf(instBuff, sizeof(instBuff), "%08x", rec.inst_);
+  else
+    snprintf(instBuff, sizeof(instBuff), "%04x", rec.inst_ & 0xffff);
+
+  uint64_t tag = rec.tag_;
+  unsigned hart = rec.hart_;
+  URV pc = rec.pc_;
+  bool pending = false;  // True if a printed line need to be terminated.
+
+  for (const auto& change : rec.changes_)
+    {
+      switch (change.resource_)
+        {
+        case 'f':
+          if (pending) out += "  +\n";
+          formatFpInstTrace<URV>(out, tag, hart, pc, instBuff, change.addr_,
+                                 change.value_, tmp.c_str());
+          break;
+
+        case 'v':
+          if (pending) out += " +\n";
+          formatInstTrace<URV>(out, tag, hart, pc, instBuff, 'v', change.addr_,
+                               change.value_, tmp.c_str());
+          break;
+
+        case 'M':  // Wide store in a 32-bit hart.
+          {
+            if (pending) out += "  +\n";
+            char line[256];
+            snprintf(line, sizeof(line), "#%" PRId64 " %d %08x %8s m %08x %016" PRIx64 "  ",
+                     tag, hart, uint32_t(pc), instBuff, uint32_t(change.addr_),
+                     change.value_);
+            out += line;
+            out += tmp;
+          }
+          break;
+
+        default:
+          if (pending) out += "  +\n";
+          formatInstTrace<URV>(out, tag, hart, pc, instBuff, change.resource_,
+                               change.addr_, change.value_, tmp.c_str());
+          break;
+        }
+      pending = true;
+    }
+
+  if (not pending)
+    {
+      // No diffs: Generate an x0 record.
+      formatInstTrace<URV>(out, tag, hart, pc, instBuff, 'r', 0, 0, tmp.c_str());
+    }
+  out += "\n";
+}
+
+
+void
+WdRiscv::formatInstTraceRecord(const InstTraceRecord& rec, unsigned xlen,
+                               std::string& out)
+{
+  if (xlen == 64)
+    formatRecord<uint64_t>(rec, out);
+  else
+    formatRecord<uint32_t>(rec, out);
+}
+
+
+// Record kinds of the binary trace.
+enum : uint8_t { StringRecord = 1, InstRecord = 2 };
+
+// Flags of an instruction record.
+enum : uint8_t { FlagSize4 = 1, FlagInterrupted = 2, FlagLdSt = 4 };
+
+// Format version of the binary trace.
+static constexpr uint32_t binaryTraceVersion = 1;
+
+// Size of blocks handed over to the background compression thread.
+static constexpr size_t binaryTraceBlockSize = 256*1024;
+
+
+constexpr char BinaryTraceWriter::magic[8];
+
+
+bool
+BinaryTraceWriter::open(int fd)
+{
+  close();
+
+  int dupFd = dup(fd);
+  if (dupFd < 0)
+    return false;
+
+  // Favor speed over compression ratio: the records are already compact.
+  gzFile gz = gzdopen(dupFd, "wb1");
+  if (not gz)
+    {
+      ::close(dupFd);
+      return false;
+    }
+  gz_ = gz;
+
+  block_.clear();
+  block_.reserve(binaryTraceBlockSize + 1024);
+  block_.insert(block_.end(), magic, magic + sizeof(magic));
+  for (uint32_t word : { binaryTraceVersion, uint32_t(xlen_) })
+    for (unsigned i = 0; i < 4; ++i)
+      block_.push_back(char(word >> (8*i)));
+
+  closing_ = false;
+  thread_ = std::thread(&BinaryTraceWriter::loop, this);
+  return true;
+}
+
+
+uint64_t
+BinaryTraceWriter::stringIndex(uint32_t inst, const std::string& str)
+{
+  auto iter = strings_.find(inst);
+  if (iter != strings_.end() and iter->second.second == str)
+    return iter->second.first;
+
+  uint64_t index = stringCount_++;
+  strings_[inst] = std::make_pair(index, str);
+
+  block_.push_back(char(StringRecord));
+  putVarint(str.size());
+  block_.insert(block_.end(), str.begin(), str.end());
+  return index;
+}
+
+
+void
+BinaryTraceWriter::write(const InstTraceRecord& rec)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (not gz_)
+    return;
+
+  if (rec.hart_ >= harts_.size())
+    harts_.resize(rec.hart_ + 1);
+  HartState& state = harts_.at(rec.hart_);
+
+  uint64_t strIx = stringIndex(rec.inst_, rec.disasm_);
+
+  uint8_t flags = 0;
+  if (rec.instSize_ == 4)   flags |= FlagSize4;
+  if (rec.interrupted_)     flags |= FlagInterrupted;
+  if (rec.hasLdSt_)         flags |= FlagLdSt;
+
+  block_.push_back(char(InstRecord));
+  block_.push_back(char(flags));
+  putVarint(rec.hart_);
+  putSigned(int64_t(rec.tag_ - state.tag_));
+  putSigned(int64_t(rec.pc_ - state.nextPc_));  // Zero for sequential code.
+  putVarint(rec.inst_);
+  putVarint(strIx);
+  if (rec.hasLdSt_)
+    putVarint(rec.ldSt_);
+
+  putVarint(rec.changes_.size());
+  for (const auto& change : rec.changes_)
+    {
+      block_.push_back(change.resource_);
+      putVarint(change.addr_);
+      putVarint(change.value_);
+    }
+
+  state.tag_ = rec.tag_;
+  state.nextPc_ = rec.pc_ + rec.instSize_;
+
+  if (block_.size() >= binaryTraceBlockSize)
+    flushBlock();
+}
+
+
+void
+BinaryTraceWriter::flushBlock()
+{
+  if (block_.empty())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    queue_.push_back(std::move(block_));
+  }
+  queueCv_.notify_one();
+
+  block_ = std::vector<char>();
+  block_.reserve(binaryTraceBlockSize + 1024);
+}
+
+
+void
+BinaryTraceWriter::loop()
+{
+  gzFile gz = static_cast<gzFile>(gz_);
+
+  while (true)
+    {
+      std::vector<char> block;
+      {
+        std::unique_lock<std::mutex> lock(queueMutex_);
+        queueCv_.wait(lock, [this] { return closing_ or not queue_.empty(); });
+        if (queue_.empty())
+          return;  // Closing and nothing left.
+        block = std::move(queue_.front());
+        queue_.pop_front();
+      }
+
+      if (gzwrite(gz, block.data(), block.size()) != int(block.size()))
+        std::cerr << "Error: Failed to write binary trace\n";
+    }
+}
+
+
+void
+BinaryTraceWriter::close()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (not gz_)
+    return;
+
+  flushBlock();
+  {
+    std::lock_guard<std::mutex> qlock(queueMutex_);
+    closing_ = true;
+  }
+  queueCv_.notify_one();
+  thread_.join();
+
+  gzclose(static_cast<gzFile>(gz_));
+  gz_ = nullptr;
+}
+
+
+BinaryTraceReader::~BinaryTraceReader()
+{
+  if (gz_)
+    gzclose(static_cast<gzFile>(gz_));
+}
+
+
+bool
+BinaryTraceReader::open(const std::string& path)
+{
+  gzFile gz = gzopen(path.c_str(), "rb");
+  if (not gz)
+    {
+      std::cerr << "Error: Failed to open binary trace file " << path << '\n';
+      return false;
+    }
+  gz_ = gz;
+
+  if (not fill(16) or
+      memcmp(buffer_.data(), BinaryTraceWriter::magic, sizeof(BinaryTraceWriter::magic)) != 0)
+    {
+      std::cerr << "Error: File " << path << " is not a whisper binary trace\n";
+      return false;
+    }
+
+  auto getWord = [this] (size_t offset) -> uint32_t {
+                   uint32_t word = 0;
+                   for (unsigned i = 0; i < 4; ++i)
+                     word |= uint32_t(uint8_t(buffer_.at(offset + i))) << (8*i);
+                   return word;
+                 };
+
+  uint32_t version = getWord(8);
+  xlen_ = getWord(12);
+  pos_ = 16;
+
+  if (version != binaryTraceVersion or (xlen_ != 32 and xlen_ != 64))
+    {
+      std::cerr << "Error: Unsupported binary trace version/xlen in " << path << '\n';
+      return false;
+    }
+
+  return true;
+}
+
+
+bool
+BinaryTraceReader::fill(size_t n)
+{
+  if (buffer_.size() - pos_ >= n)
+    return true;
+
+  // Discard consumed bytes then read more.
+  buffer_.erase(buffer_.begin(), buffer_.begin() + pos_);
+  pos_ = 0;
+
+  gzFile gz = static_cast<gzFile>(gz_);
+  while (buffer_.size() < n)
+    {
+      size_t size = buffer_.size();
+      size_t chunk = std::max(n - size, size_t(256*1024));
+      buffer_.resize(size + chunk);
+      int count = gzread(gz, buffer_.data() + size, chunk);
+      if (count <= 0)
+        {
+          buffer_.resize(size);
+          return false;
+        }
+      buffer_.resize(size + count);
+    }
+  return true;
+}
+
+
+bool
+BinaryTraceReader::getByte(uint8_t& byte)
+{
+  if (not fill(1))
+    return false;
+  byte = buffer_[pos_++];
+  return true;
+}
+
+
+bool
+BinaryTraceReader::getVarint(uint64_t& x)
+{
+  x = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+      uint8_t byte = 0;
+      if (not getByte(byte))
+        {
+          error_ = true;
+          return false;
+        }
+      x |= uint64_t(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0)
+        return true;
+    }
+  error_ = true;
+  return false;
+}
+
+
+bool
+BinaryTraceReader::getSigned(int64_t& x)
+{
+  uint64_t u = 0;
+  if (not getVarint(u))
+    return false;
+  x = int64_t(u >> 1) ^ -int64_t(u & 1);
+  return true;
+}
+
+
+bool
+BinaryTraceReader::next(InstTraceRecord& rec)
+{
+  while (true)
+    {
+      uint8_t kind = 0;
+      if (not getByte(kind))
+        return false;  // End of file.
+
+      if (kind == StringRecord)
+        {
+          uint64_t len = 0;
+          if (not getVarint(len) or not fill(len))
+            {
+              error_ = true;
+              return false;
+            }
+          strings_.emplace_back(buffer_.data() + pos_, len);
+          pos_ += len;
+          continue;
+        }
+
+      if (kind != InstRecord)
+        {
+          error_ = true;
+          return false;
+        }
+
+      uint8_t flags = 0;
+      uint64_t hart = 0, inst = 0, strIx = 0, count = 0;
+      int64_t tagDelta = 0, pcDelta = 0;
+      if (not getByte(flags) or not getVarint(hart) or not getSigned(tagDelta) or
+          not getSigned(pcDelta) or not getVarint(inst) or not getVarint(strIx) or
+          strIx >= strings_.size() or hart > 0xffff)
+        {
+          error_ = true;
+          return false;
+        }
+
+      if (hart >= harts_.size())
+        harts_.resize(hart + 1);
+      HartState& state = harts_.at(hart);
+
+      rec.hart_ = hart;
+      rec.tag_ = state.tag_ + tagDelta;
+      rec.pc_ = state.nextPc_ + pcDelta;
+      rec.inst_ = inst;
+      rec.instSize_ = (flags & FlagSize4) ? 4 : 2;
+      rec.interrupted_ = (flags & FlagInterrupted) != 0;
+      rec.hasLdSt_ = (flags & FlagLdSt) != 0;
+      rec.ldSt_ = 0;
+      if (rec.hasLdSt_ and not getVarint(rec.ldSt_))
+        return false;
+      rec.disasm_ = strings_.at(strIx);
+
+      if (not getVarint(count))
+        return false;
+      rec.changes_.resize(count);
+      for (auto& change : rec.changes_)
+        {
+          uint8_t resource = 0;
+          if (not getByte(resource))
+            {
+              error_ = true;
+              return false;
+            }
+          change.resource_ = char(resource);
+          if (not getVarint(change.addr_) or not getVarint(change.value_))
+            return false;
+        }
+
+      state.tag_ = rec.tag_;
+      state.nextPc_ = rec.pc_ + rec.instSize_;
+      return true;
+    }
+}
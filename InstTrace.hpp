@@ -0,0 +1,193 @@
+// Copyright 2020 Western Digital Corporation or its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace WdRiscv
+{
+
+  /// One state change produced by an instruction: resource is 'r'
+  /// (integer register), 'f' (floating point register), 'v' (vector
+  /// register, value is a checksum), 'm' (memory), 'M' (64-bit store
+  /// in a 32-bit hart), or 'c' (CSR, with trigger number in bits 16
+  /// and up of the address for trigger registers).
+  struct InstTraceChange
+  {
+    char resource_ = 'r';
+    uint64_t addr_ = 0;
+    uint64_t value_ = 0;
+  };
+
+
+  /// Instruction trace record: all the information needed to render
+  /// one instruction of the text log (--logfile).
+  struct InstTraceRecord
+  {
+    uint64_t tag_ = 0;          // Instruction count.
+    unsigned hart_ = 0;         // Hart index.
+    uint64_t pc_ = 0;
+    uint32_t inst_ = 0;
+    unsigned instSize_ = 4;
+    bool interrupted_ = false;
+    bool hasLdSt_ = false;      // True if ldSt_ is valid.
+    uint64_t ldSt_ = 0;         // Load/store data address.
+    std::string disasm_;        // Disassembly without ld/st address.
+    std::vector<InstTraceChange> changes_;
+  };
+
+
+  /// Append to out the text-log rendering of the given record for a
+  /// hart of the given register width (32 or 64).
+  void formatInstTraceRecord(const InstTraceRecord& rec, unsigned xlen,
+                             std::string& out);
+
+
+  /// Write instruction trace records in a compact binary format
+  /// compressed with zlib. The stream starts with a fixed header
+  /// (magic, version, register width) followed by records. The PC and
+  /// instruction count of a record are delta-encoded against the
+  /// previous record of the same hart, all numbers are varints, and
+  /// disassembly strings are written once and then referred to by
+  /// index. Compression and file output happen in a background
+  /// thread. Records may be written concurrently by multiple harts.
+  class BinaryTraceWriter
+  {
+  public:
+
+    /// Magic number identifying a binary trace.
+    static constexpr char magic[8] = { 'W', 'H', 'S', 'P', 'T', 'R', 'C', '1' };
+
+    BinaryTraceWriter(unsigned xlen)
+      : xlen_(xlen)
+    { }
+
+    ~BinaryTraceWriter()
+    { close(); }
+
+    /// Start writing to the given file descriptor (which is
+    /// duplicated: the caller keeps ownership of fd). Return true on
+    /// success.
+    bool open(int fd);
+
+    /// Encode given record.
+    void write(const InstTraceRecord& rec);
+
+    /// Flush all records, wait for the background thread and close
+    /// the compressed stream.
+    void close();
+
+  private:
+
+    void putVarint(uint64_t x)
+    {
+      while (x >= 0x80)
+        {
+          block_.push_back(char(x | 0x80));
+          x >>= 7;
+        }
+      block_.push_back(char(x));
+    }
+
+    void putSigned(int64_t x)
+    { putVarint((uint64_t(x) << 1) ^ uint64_t(x >> 63)); }
+
+    /// Return the index of the given disassembly string of the given
+    /// instruction defining it in the stream if not yet defined.
+    uint64_t stringIndex(uint32_t inst, const std::string& str);
+
+    /// Hand over current block to the background thread.
+    void flushBlock();
+
+    /// Background thread body.
+    void loop();
+
+    struct HartState
+    {
+      uint64_t tag_ = 0;
+      uint64_t nextPc_ = 0;
+    };
+
+    unsigned xlen_ = 32;
+    void* gz_ = nullptr;             // Compressed stream (gzFile).
+    std::mutex mutex_;               // Serialize writers.
+    std::vector<char> block_;        // Block being filled.
+    std::vector<HartState> harts_;
+    std::unordered_map<uint32_t, std::pair<uint64_t, std::string>> strings_;
+    uint64_t stringCount_ = 0;
+
+    std::mutex queueMutex_;          // Protect following.
+    std::condition_variable queueCv_;
+    std::deque<std::vector<char>> queue_;
+    bool closing_ = false;
+    std::thread thread_;
+  };
+
+
+  /// Read the records of a binary trace produced by BinaryTraceWriter.
+  class BinaryTraceReader
+  {
+  public:
+
+    ~BinaryTraceReader();
+
+    /// Open given file. Return true on success. Print error message
+    /// and return false on failure.
+    bool open(const std::string& path);
+
+    /// Register width of the traced harts.
+    unsigned xlen() const
+    { return xlen_; }
+
+    /// Read next record. Return false at end of file or on error
+    /// (see hasError).
+    bool next(InstTraceRecord& rec);
+
+    /// Return true if an error (corrupt or truncated file) was seen.
+    bool hasError() const
+    { return error_; }
+
+  private:
+
+    /// Make at least n bytes available in buffer. Return false if
+    /// end of file is reached before.
+    bool fill(size_t n);
+
+    bool getByte(uint8_t& byte);
+    bool getVarint(uint64_t& x);
+    bool getSigned(int64_t& x);
+
+    struct HartState
+    {
+      uint64_t tag_ = 0;
+      uint64_t nextPc_ = 0;
+    };
+
+    void* gz_ = nullptr;
+    unsigned xlen_ = 32;
+    bool error_ = false;
+    std::vector<char> buffer_;
+    size_t pos_ = 0;
+    std::vector<HartState> harts_;
+    std::vector<std::string> strings_;
+  };
+}
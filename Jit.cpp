@@ -0,0 +1,538 @@
+// Copyright 2020 Western Digital Corporation or its affiliates.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#if defined(__x86_64__) && !defined(__MINGW64__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define WHISPER_JIT 1
+#endif
+#include "Jit.hpp"
+#include "DecodedInst.hpp"
+
+
+using namespace WdRiscv;
+
+
+// Host registers used by the translated code: rdi holds the address
+// of the integer register file, rax and rcx hold operands.
+static constexpr unsigned RAX = 0;
+static constexpr unsigned RCX = 1;
+
+// The "digit" (modrm reg field) of x86 immediate and shift operations.
+static constexpr unsigned ADD_DIGIT = 0;
+static constexpr unsigned OR_DIGIT  = 1;
+static constexpr unsigned AND_DIGIT = 4;
+static constexpr unsigned XOR_DIGIT = 6;
+static constexpr unsigned CMP_DIGIT = 7;
+static constexpr unsigned SHL_DIGIT = 4;
+static constexpr unsigned SHR_DIGIT = 5;
+static constexpr unsigned SAR_DIGIT = 7;
+
+// Opcodes of x86 "op r/m, reg" instructions.
+static constexpr uint8_t ADD_OP = 0x01;
+static constexpr uint8_t OR_OP  = 0x09;
+static constexpr uint8_t AND_OP = 0x21;
+static constexpr uint8_t SUB_OP = 0x29;
+static constexpr uint8_t XOR_OP = 0x31;
+
+
+Jit::Jit(size_t bufferSize)
+{
+#ifdef WHISPER_JIT
+  // The buffer is never writable and executable at the same time: It
+  // is executable except while a translation is copied into it (see
+  // translate).
+  void* mem = mmap(nullptr, bufferSize, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED)
+    return;
+  if (mprotect(mem, bufferSize, PROT_READ | PROT_EXEC) != 0)
+    {
+      munmap(mem, bufferSize);  // Host does not allow executable mappings.
+      return;
+    }
+  buffer_ = static_cast<uint8_t*>(mem);
+  size_ = bufferSize;
+#else
+  (void)bufferSize;
+#endif
+}
+
+
+Jit::~Jit()
+{
+#ifdef WHISPER_JIT
+  if (buffer_)
+    munmap(buffer_, size_);
+#endif
+  buffer_ = nullptr;
+}
+
+
+bool
+Jit::isTranslatable(const DecodedInst& di, bool rv64, unsigned regCount)
+{
+  const InstEntry* entry = di.instEntry();
+  if (not di.isValid() or not entry)
+    return false;
+
+  // All operands that are registers must exist (rv32e).
+  for (unsigned i = 0; i < 3; ++i)
+    if (di.ithOperandType(i) == OperandType::IntReg and di.ithOperand(i) >= regCount)
+      return false;
+
+  unsigned shiftLimit = rv64 ? 64 : 32;
+
+  switch (entry->instId())
+    {
+    case InstId::lui:
+    case InstId::c_lui:
+    case InstId::auipc:
+    case InstId::addi:
+    case InstId::c_addi:
+    case InstId::c_addi4spn:
+    case InstId::c_addi16sp:
+    case InstId::slti:
+    case InstId::sltiu:
+    case InstId::xori:
+    case InstId::ori:
+    case InstId::andi:
+    case InstId::c_andi:
+    case InstId::add:
+    case InstId::c_add:
+    case InstId::sub:
+    case InstId::c_sub:
+    case InstId::sll:
+    case InstId::slt:
+    case InstId::sltu:
+    case InstId::xor_:
+    case InstId::c_xor:
+    case InstId::srl:
+    case InstId::sra:
+    case InstId::or_:
+    case InstId::c_or:
+    case InstId::and_:
+    case InstId::c_and:
+    case InstId::c_li:
+    case InstId::c_mv:
+      return true;
+
+    case InstId::slli:
+    case InstId::srli:
+    case InstId::srai:
+    case InstId::c_slli:
+    case InstId::c_srli:
+    case InstId::c_srai:
+    case InstId::c_slli64:
+    case InstId::c_srli64:
+    case InstId::c_srai64:
+      return di.op2() < shiftLimit;   // Otherwise illegal instruction.
+
+    case InstId::addiw:
+    case InstId::c_addiw:
+    case InstId::addw:
+    case InstId::c_addw:
+    case InstId::subw:
+    case InstId::c_subw:
+    case InstId::sllw:
+    case InstId::srlw:
+    case InstId::sraw:
+      return rv64;
+
+    case InstId::slliw:
+    case InstId::srliw:
+    case InstId::sraiw:
+      return rv64 and di.op2() < 32;
+
+    default:
+      return false;
+    }
+}
+
+
+Jit::Code
+Jit::translate(const DecodedInst* insts, size_t count, bool rv64)
+{
+  if (not isAvailable())
+    return nullptr;
+
+  rv64_ = rv64;
+  code_.clear();
+
+  for (size_t i = 0; i < count; ++i)
+    emitInst(insts[i]);
+
+  emit8(0xc3);  // ret
+
+  if (used_ + code_.size() > size_)
+    return nullptr;
+
+  uint8_t* start = buffer_ + used_;
+  if (not copyCode(start))
+    return nullptr;
+  used_ += code_.size();
+
+  // Keep translations 16-byte aligned.
+  used_ = (used_ + 15) & ~size_t(15);
+
+  return reinterpret_cast<Code>(start);
+}
+
+
+bool
+Jit::copyCode(uint8_t* dest)
+{
+#ifdef WHISPER_JIT
+  // Make the pages receiving the code writable (not executable) for
+  // the duration of the copy.
+  size_t pageSize = sysconf(_SC_PAGESIZE);
+  uintptr_t first = reinterpret_cast<uintptr_t>(dest) & ~uintptr_t(pageSize - 1);
+  uintptr_t end = reinterpret_cast<uintptr_t>(dest) + code_.size();
+  void* pages = reinterpret_cast<void*>(first);
+  size_t len = end - first;
+
+  if (mprotect(pages, len, PROT_READ | PROT_WRITE) != 0)
+    return false;
+  memcpy(dest, code_.data(), code_.size());
+  return mprotect(pages, len, PROT_READ | PROT_EXEC) == 0;
+#else
+  (void)dest;
+  return false;
+#endif
+}
+
+
+void
+Jit::emitInst(const DecodedInst& di)
+{
+  unsigned rd = di.op0(), rs1 = di.op1(), rs2 = di.op2();
+  int32_t imm = di.op2As<int32_t>();
+  bool wide = rv64_;
+
+  if (rd == 0)
+    return;   // Translated instructions have no effect besides rd.
+
+  switch (di.instEntry()->instId())
+    {
+    case InstId::lui:
+    case InstId::c_lui:
+      emitMovImm(uint64_t(int64_t(int32_t(di.op1()))));
+      break;
+
+    case InstId::auipc:
+      {
+        uint64_t value = di.address() + uint64_t(int64_t(int32_t(di.op1())));
+        if (not rv64_)
+          value = uint32_t(value);
+        emitMovImm(value);
+      }
+      break;
+
+    case InstId::c_li:
+      emitMovImm(uint64_t(int64_t(imm)));
+      break;
+
+    case InstId::c_mv:
+      emitLoad(RAX, rs2);
+      break;
+
+    case InstId::addi:
+    case InstId::c_addi:
+    case InstId::c_addi4spn:
+    case InstId::c_addi16sp:
+      emitLoad(RAX, rs1);
+      emitAluImm(ADD_DIGIT, imm, wide);
+      break;
+
+    case InstId::xori:
+      emitLoad(RAX, rs1);
+      emitAluImm(XOR_DIGIT, imm, wide);
+      break;
+
+    case InstId::ori:
+      emitLoad(RAX, rs1);
+      emitAluImm(OR_DIGIT, imm, wide);
+      break;
+
+    case InstId::andi:
+    case InstId::c_andi:
+      emitLoad(RAX, rs1);
+      emitAluImm(AND_DIGIT, imm, wide);
+      break;
+
+    case InstId::slti:
+      emitLoad(RAX, rs1);
+      emitSetLess(true, &imm);
+      break;
+
+    case InstId::sltiu:
+      emitLoad(RAX, rs1);
+      emitSetLess(false, &imm);
+      break;
+
+    case InstId::slli:
+    case InstId::c_slli:
+    case InstId::c_slli64:
+      emitLoad(RAX, rs1);
+      emitShiftImm(SHL_DIGIT, rs2, wide);
+      break;
+
+    case InstId::srli:
+    case InstId::c_srli:
+    case InstId::c_srli64:
+      emitLoad(RAX, rs1);
+      emitShiftImm(SHR_DIGIT, rs2, wide);
+      break;
+
+    case InstId::srai:
+    case InstId::c_srai:
+    case InstId::c_srai64:
+      emitLoad(RAX, rs1);
+      emitShiftImm(SAR_DIGIT, rs2, wide);
+      break;
+
+    case InstId::add:
+    case InstId::c_add:
+      emitRegReg(ADD_OP, rs1, rs2, wide);
+      break;
+
+    case InstId::sub:
+    case InstId::c_sub:
+      emitRegReg(SUB_OP, rs1, rs2, wide);
+      break;
+
+    case InstId::xor_:
+    case InstId::c_xor:
+      emitRegReg(XOR_OP, rs1, rs2, wide);
+      break;
+
+    case InstId::or_:
+    case InstId::c_or:
+      emitRegReg(OR_OP, rs1, rs2, wide);
+      break;
+
+    case InstId::and_:
+    case InstId::c_and:
+      emitRegReg(AND_OP, rs1, rs2, wide);
+      break;
+
+    case InstId::addw:
+    case InstId::c_addw:
+      emitRegReg(ADD_OP, rs1, rs2, false);
+      emitSignExtend();
+      break;
+
+    case InstId::subw:
+    case InstId::c_subw:
+      emitRegReg(SUB_OP, rs1, rs2, false);
+      emitSignExtend();
+      break;
+
+    case InstId::sll:
+    case InstId::srl:
+    case InstId::sra:
+      {
+        // Host masks shift amount to 5/6 bits like RISCV.
+        InstId id = di.instEntry()->instId();
+        unsigned digit = id == InstId::sll? SHL_DIGIT : (id == InstId::srl? SHR_DIGIT : SAR_DIGIT);
+        emitLoad(RAX, rs1);
+        emitLoad(RCX, rs2);
+        emitShift(digit, wide);
+      }
+      break;
+
+    case InstId::slt:
+    case InstId::sltu:
+      emitLoad(RAX, rs1);
+      emitLoad(RCX, rs2);
+      emitSetLess(di.instEntry()->instId() == InstId::slt, nullptr);
+      break;
+
+    case InstId::addiw:
+    case InstId::c_addiw:
+      emitLoad(RAX, rs1);
+      emitAluImm(ADD_DIGIT, imm, false);
+      emitSignExtend();
+      break;
+
+    case InstId::slliw:
+    case InstId::srliw:
+    case InstId::sraiw:
+      {
+        InstId id = di.instEntry()->instId();
+        unsigned digit = id == InstId::slliw? SHL_DIGIT : (id == InstId::srliw? SHR_DIGIT : SAR_DIGIT);
+        emitLoad(RAX, rs1);
+        emitShiftImm(digit, rs2, false);
+        emitSignExtend();
+      }
+      break;
+
+    case InstId::sllw:
+    case InstId::srlw:
+    case InstId::sraw:
+      {
+        InstId id = di.instEntry()->instId();
+        unsigned digit = id == InstId::sllw? SHL_DIGIT : (id == InstId::srlw? SHR_DIGIT : SAR_DIGIT);
+        emitLoad(RAX, rs1);
+        emitLoad(RCX, rs2);
+        emitShift(digit, false);
+        emitSignExtend();
+      }
+      break;
+
+    default:
+      return;  // Not reached: caller checks isTranslatable.
+    }
+
+  emitStore(rd);
+}
+
+
+void
+Jit::emitLoad(unsigned hostReg, unsigned reg)
+{
+  // mov reg, [rdi + disp32]
+  unsigned regSize = rv64_? 8 : 4;
+  if (rv64_)
+    emit8(0x48);
+  emit8(0x8b);
+  emit8(0x87 | (hostReg << 3));
+  emit32(reg * regSize);
+}
+
+
+void
+Jit::emitStore(unsigned reg)
+{
+  // mov [rdi + disp32], rax
+  unsigned regSize = rv64_? 8 : 4;
+  if (rv64_)
+    emit8(0x48);
+  emit8(0x89);
+  emit8(0x87);
+  emit32(reg * regSize);
+}
+
+
+void
+Jit::emitMovImm(uint64_t value)
+{
+  if (not rv64_)
+    {
+      emit8(0xb8);   // mov eax, imm32
+      emit32(uint32_t(value));
+    }
+  else if (int64_t(value) == int64_t(int32_t(value)))
+    {
+      emit8(0x48);   // mov rax, sign-extended imm32
+      emit8(0xc7);
+      emit8(0xc0);
+      emit32(uint32_t(value));
+    }
+  else
+    {
+      emit8(0x48);   // movabs rax, imm64
+      emit8(0xb8);
+      emit32(uint32_t(value));
+      emit32(uint32_t(value >> 32));
+    }
+}
+
+
+void
+Jit::emitAluImm(unsigned digit, int32_t imm, bool wide)
+{
+  if (wide)
+    emit8(0x48);
+  emit8(0x81);
+  emit8(0xc0 | (digit << 3));
+  emit32(uint32_t(imm));
+}
+
+
+void
+Jit::emitShiftImm(unsigned digit, unsigned amount, bool wide)
+{
+  if (wide)
+    emit8(0x48);
+  emit8(0xc1);
+  emit8(0xc0 | (digit << 3));
+  emit8(uint8_t(amount));
+}
+
+
+void
+Jit::emitAlu(uint8_t opcode, bool wide)
+{
+  if (wide)
+    emit8(0x48);
+  emit8(opcode);
+  emit8(0xc0 | (RCX << 3) | RAX);
+}
+
+
+void
+Jit::emitRegReg(uint8_t opcode, unsigned rs1, unsigned rs2, bool wide)
+{
+  emitLoad(RAX, rs1);
+  emitLoad(RCX, rs2);
+  emitAlu(opcode, wide);
+}
+
+
+void
+Jit::emitShift(unsigned digit, bool wide)
+{
+  if (wide)
+    emit8(0x48);
+  emit8(0xd3);
+  emit8(0xc0 | (digit << 3));
+}
+
+
+void
+Jit::emitSetLess(bool isSigned, const int32_t* imm)
+{
+  if (imm)
+    emitAluImm(CMP_DIGIT, *imm, rv64_);
+  else
+    {
+      // cmp rax, rcx
+      if (rv64_)
+        emit8(0x48);
+      emit8(0x39);
+      emit8(0xc0 | (RCX << 3) | RAX);
+    }
+
+  // setl al or setb al
+  emit8(0x0f);
+  emit8(isSigned ? 0x9c : 0x92);
+  emit8(0xc0);
+
+  // movzx eax, al (clears upper half of rax)
+  emit8(0x0f);
+  emit8(0xb6);
+  emit8(0xc0);
+}
+
+
+void
+Jit::emitSignExtend()
+{
+  // movsxd rax, eax
+  emit8(0x48);
+  emit8(0x63);
+  emit8(0xc0);
+}
@@ -0,0 +1,125 @@
+// Copyright 2020 Western Digital Corporation or its affiliates.
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace WdRiscv
+{
+
+  class DecodedInst;
+
+
+  /// Translate runs of decoded integer register-to-register
+  /// instructions (add, addi, lui, shifts, ...) into host (x86-64)
+  /// code. A translated run is a function taking the address of the
+  /// integer register file and updating it as if the instructions of
+  /// the run were executed in sequence. Translated instructions
+  /// cannot take exceptions: loads, stores, branches, CSR and system
+  /// instructions are never translated and remain with the
+  /// interpreter. On a host other than x86-64 nothing is translated.
+  class Jit
+  {
+  public:
+
+    /// Translated code: Update integer registers at given address.
+    typedef void (*Code)(void* regs);
+
+    /// Define a translator with the given code buffer size in bytes.
+    /// The translator is unavailable if the buffer cannot be mapped
+    /// executable or if the host is not supported.
+    Jit(size_t bufferSize = 16*1024*1024);
+
+    ~Jit();
+
+    /// Return true if this translator can produce code.
+    bool isAvailable() const
+    { return buffer_ != nullptr; }
+
+    /// Return true if the given decoded instruction can be translated
+    /// for a hart with the given register width (rv64 if true, rv32
+    /// otherwise) and integer register count.
+    static bool isTranslatable(const DecodedInst& di, bool rv64,
+                               unsigned regCount);
+
+    /// Translate the given count of decoded instructions (which must
+    /// all be translatable) for a hart with the given register width.
+    /// Return the translated code or null if the code buffer is full.
+    Code translate(const DecodedInst* insts, size_t count, bool rv64);
+
+    /// Discard all the translated code.
+    void reset()
+    { used_ = 0; }
+
+  private:
+
+    /// Copy code_ to the given address in the code buffer, making the
+    /// affected pages writable for the copy and executable again
+    /// after. Return false on failure.
+    bool copyCode(uint8_t* dest);
+
+    /// Append the translation of the given instruction to code_.
+    void emitInst(const DecodedInst& di);
+
+    /// Load given RISCV integer register into given host register.
+    void emitLoad(unsigned hostReg, unsigned reg);
+
+    /// Store host register rax into given RISCV integer register.
+    void emitStore(unsigned reg);
+
+    /// Set host register rax to the given value.
+    void emitMovImm(uint64_t value);
+
+    /// Emit operation (opcode/digit) between rax and a sign extended
+    /// 32-bit immediate.
+    void emitAluImm(unsigned digit, int32_t imm, bool wide);
+
+    /// Emit shift of rax by an immediate amount.
+    void emitShiftImm(unsigned digit, unsigned amount, bool wide);
+
+    /// Emit two-operand operation: rax = rax op rcx.
+    void emitAlu(uint8_t opcode, bool wide);
+
+    /// Emit rax = rs1 op rs2 where rs1 and rs2 are RISCV registers.
+    void emitRegReg(uint8_t opcode, unsigned rs1, unsigned rs2, bool wide);
+
+    /// Emit shift of rax by cl.
+    void emitShift(unsigned digit, bool wide);
+
+    /// Emit set rax to 1 if rax is less than operand (rcx if imm is
+    /// null, immediate otherwise) and 0 otherwise.
+    void emitSetLess(bool isSigned, const int32_t* imm);
+
+    /// Sign extend eax into rax.
+    void emitSignExtend();
+
+    void emit8(uint8_t byte)
+    { code_.push_back(byte); }
+
+    void emit32(uint32_t word)
+    {
+      for (unsigned i = 0; i < 4; ++i)
+        code_.push_back(uint8_t(word >> (i*8)));
+    }
+
+    uint8_t* buffer_ = nullptr;  // Code buffer (never writable and executable at once).
+    size_t size_ = 0;            // Buffer size in bytes.
+    size_t used_ = 0;            // Bytes of buffer in use.
+    bool rv64_ = false;          // Width of the hart being translated.
+    std::vector<uint8_t> code_;  // Code of the current translation.
+  };
+}
@@ -21,6 +21,9 @@
 #include <boost/algorithm/string.hpp>
 #ifndef __MINGW64__
 #include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #endif
 #include <elfio/elfio.hpp>
 #include <zlib.h>
@@ -29,7 +32,39 @@
 using namespace WdRiscv;
 
 
-Memory::Memory(size_t size, size_t pageSize, size_t regionSize)
+/// Return zero-filled host memory of the given size. Host pages are
+/// committed as they are touched: Untouched parts use no host memory.
+/// Return null on failure.
+static
+void*
+mapZeroed(size_t bytes)
+{
+#ifndef __MINGW64__
+  void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  return mem == MAP_FAILED ? nullptr : mem;
+#else
+  return calloc(bytes, 1);
+#endif
+}
+
+
+/// Release memory obtained from mapZeroed.
+static
+void
+unmapZeroed(void* mem, size_t bytes)
+{
+#ifndef __MINGW64__
+  munmap(mem, bytes);
+#else
+  (void) bytes;
+  free(mem);
+#endif
+}
+
+
+Memory::Memory(size_t size, size_t pageSize, size_t regionSize,
+               bool hugePages)
   : size_(size), data_(nullptr), pageSize_(pageSize), reservations_(1),
     lastWriteData_(1), pmaMgr_(size, pageSize)
 { 
@@ -58,35 +93,52 @@ Memory::Memory(size_t size, size_t pageSize, size_t regionSize)
   if (regionCount_ * regionSize_ < size_)
     regionCount_++;
 
-#ifndef __MINGW64__
-  void* mem = mmap(nullptr, size_, PROT_READ | PROT_WRITE,
-		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
-  if (mem == (void*) -1)
+  // Use one flat host region unless the memory is too large (or
+  // sparse) in which case pages are allocated on first touch.
+  if (size_ <= maxFlatSize_ and hugePages)
     {
-      std::cerr << "Failed to map " << size_ << " bytes using mmap.\n";
-#else
-  void* mem = malloc(size_);
-  if (mem == nullptr)
+      data_ = reinterpret_cast<uint8_t*>(mapHugePages(size_, hugeKind_));
+      hugeMapped_ = data_ != nullptr;
+    }
+
+  if (size_ <= maxFlatSize_ and not data_)
     {
-      std::cerr << "Failed to alloc " << size_ << " bytes using malloc.\n";
+#ifndef __MINGW64__
+      void* mem = mmap(nullptr, size_, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if (mem != (void*) -1)
+        data_ = reinterpret_cast<uint8_t*>(mem);
+#else
+      data_ = reinterpret_cast<uint8_t*>(calloc(size_, 1));
 #endif
-      throw std::runtime_error("Out of memory");
     }
 
-  data_ = reinterpret_cast<uint8_t*>(mem);
+  lineStamps_.reset(new std::atomic<uint32_t>[stampMask_ + 1]());
 
-  // Mark all regions as non-configured.
-  regionConfigured_.resize(regionCount_);
+  if (not data_)
+    {
+      // Split the page number so that neither the directory nor a
+      // table has more than 2^26 entries.
+      unsigned pageBits = 0;
+      while (pageBits < 64 and ((pageCount_ - 1) >> pageBits) != 0)
+        pageBits++;
+      dirShift_ = std::max(13u, pageBits > 26 ? pageBits - 26 : 0u);
+      dirMask_ = (size_t(1) << dirShift_) - 1;
+      dirSize_ = ((pageCount_ - 1) >> dirShift_) + 1;
+      pageDir_ = reinterpret_cast<TableSlot*>(mapZeroed(dirSize_*sizeof(TableSlot)));
+      zeroPage_ = reinterpret_cast<uint8_t*>(calloc(pageSize_, 1));
+      if (not pageDir_ or not zeroPage_)
+        throw std::runtime_error("Out of memory");
+    }
 
-  // Mark all regions as having neither iccm or dccm/mem-mappped-reg.
-  regionHasLocalInst_.resize(regionCount_);
-  regionHasLocalData_.resize(regionCount_);
 }
 
 
 Memory::~Memory()
 {
-  if (data_)
+  if (data_ and hugeMapped_)
+    unmapHugePages(data_, size_);
+  else if (data_)
     {
 #ifndef __MINGW64__
       munmap(data_, size_);
@@ -96,8 +148,18 @@ Memory::~Memory()
       data_ = nullptr;
     }
 
-  delete cache_;
-  cache_ = nullptr;
+  enableDirtyPageTracking(false);
+
+  for (size_t page : pageIxs_)
+    free(sparsePage(page));
+  for (size_t ix : tableIxs_)
+    unmapZeroed(pageDir_[ix].load(), (dirMask_ + 1)*sizeof(PageSlot));
+  if (pageDir_)
+    unmapZeroed(pageDir_, dirSize_*sizeof(TableSlot));
+  pageDir_ = nullptr;
+  free(zeroPage_);
+
+  deleteCache();
 }
 
 
@@ -165,7 +227,7 @@ Memory::loadHexFile(const std::string& fileName)
 	    {
 	      if (not errors)
 		{
-		  if (data_[addr] != 0)
+		  if (peekData(addr) != 0)
 		    overwrites++;
                   if (not specialInitializeByte(addr, value & 0xff))
                     {
@@ -254,7 +316,7 @@ Memory::loadElfSegment(ELFIO::elfio& reader, int segIx, size_t& end,
 
       for (size_t i = 0; i < size; ++i)
         {
-          if (data_[addr + i] != 0)
+          if (peekData(addr + i) != 0)
             overwrites++;
 
           if (not specialInitializeByte(addr + i, secData[i]))
@@ -294,7 +356,7 @@ Memory::loadElfSegment(ELFIO::elfio& reader, int segIx, size_t& end,
   const char* segData = seg->get_data();
   for (size_t i = 0; i < segSize; ++i)
     {
-      if (data_[vaddr + i] != 0)
+      if (peekData(vaddr + i) != 0)
         overwrites++;
       if (not specialInitializeByte(vaddr + i, segData[i]))
         {
@@ -492,6 +554,40 @@ Memory::collectElfSymbols(ELFIO::elfio& reader)
 	    }
 	}
     }
+
+  sortElfSymbols();
+}
+
+
+void
+Memory::sortElfSymbols()
+{
+  symbolRanges_.clear();
+  for (const auto& kv : symbols_)
+    {
+      const ElfSymbol& sym = kv.second;
+      if (sym.size_ == 0)
+        continue;  // Cannot contain an address.
+      SymbolRange range;
+      range.addr_ = sym.addr_;
+      range.end_ = sym.addr_ + sym.size_;
+      range.name_ = &kv.first;
+      symbolRanges_.push_back(range);
+    }
+
+  std::sort(symbolRanges_.begin(), symbolRanges_.end(),
+            [] (const SymbolRange& a, const SymbolRange& b) {
+              if (a.addr_ != b.addr_)
+                return a.addr_ < b.addr_;
+              return *a.name_ < *b.name_;
+            });
+
+  size_t maxEnd = 0;
+  for (auto& range : symbolRanges_)
+    {
+      maxEnd = std::max(maxEnd, range.end_);
+      range.maxEnd_ = maxEnd;
+    }
 }
 
 
@@ -610,14 +706,22 @@ Memory::findElfSymbol(const std::string& symbol, ElfSymbol& value) const
 bool
 Memory::findElfFunction(size_t addr, std::string& name, ElfSymbol& value) const
 {
-  for (const auto& kv : symbols_)
+  // Last symbol starting at or before addr, then walk back to the
+  // nearest one containing addr (symbols may nest or overlap).
+  auto iter = std::upper_bound(symbolRanges_.begin(), symbolRanges_.end(), addr,
+                               [] (size_t a, const SymbolRange& range) {
+                                 return a < range.addr_;
+                               });
+
+  while (iter != symbolRanges_.begin())
     {
-      auto& sym = kv.second;
-      size_t start = sym.addr_, end = sym.addr_ + sym.size_;
-      if (addr >= start and addr < end)
+      --iter;
+      if (iter->maxEnd_ <= addr)
+        break;  // No earlier symbol reaches addr.
+      if (addr < iter->end_)
 	{
-	  name = kv.first;
-	  value = sym;
+	  name = *iter->name_;
+	  value = ElfSymbol(iter->addr_, iter->end_ - iter->addr_);
 	  return true;
 	}
     }
@@ -759,7 +863,7 @@ Memory::saveSnapshot(const std::string& filename,
   bool success = true;
   for (auto& blk: used_blocks)
     {
-      uint8_t* buffer = data_+blk.first;
+      uint64_t addr = blk.first;
       size_t remainingSize = blk.second;
       assert(prev_addr<=blk.first);
       prev_addr = blk.first+blk.second;
@@ -768,13 +872,13 @@ Memory::saveSnapshot(const std::string& filename,
         {
           std::cout << "-";
           fflush(stdout);
-          size_t current_chunk = std::min(remainingSize, max_chunk);
-          int resp = gzwrite(gzout, buffer, current_chunk);
+          size_t current_chunk = std::min(remainingSize, contiguousSize(addr, max_chunk));
+          int resp = gzwrite(gzout, readHostAddr(addr), current_chunk);
           success = resp > 0 and size_t(resp) == current_chunk;
           if (not success)
             break;
           remainingSize -= current_chunk;
-          buffer += current_chunk;
+          addr += current_chunk;
         }
       if (not success)
         break;
@@ -811,7 +915,7 @@ Memory::loadSnapshot(const std::string & filename,
   size_t remainingSize = 0;
   for (auto& blk: used_blocks)
     {
-      uint8_t * buffer = data_+blk.first;
+      uint64_t addr = blk.first;
       remainingSize = blk.second;
       assert(prev_addr<=blk.first);
       prev_addr = blk.first+blk.second;
@@ -820,15 +924,15 @@ Memory::loadSnapshot(const std::string & filename,
         {
           std::cout << "-";
           fflush(stdout);
-          size_t current_chunk = std::min(remainingSize, max_chunk);
-          int resp = gzread(gzin, buffer, current_chunk);
+          size_t current_chunk = std::min(remainingSize, contiguousSize(addr, max_chunk));
+          int resp = gzread(gzin, hostAddr(addr), current_chunk);
           if (resp == 0)
             {
               success = gzeof(gzin);
               break;
             }
           remainingSize -= resp;
-          buffer += resp;
+          addr += resp;
         }
       if(not success)
         break;
@@ -848,6 +952,291 @@ Memory::loadSnapshot(const std::string & filename,
 }
 
 
+bool
+Memory::saveSnapshotImage(const std::string& filename,
+                          const std::vector<std::pair<uint64_t,uint64_t>>& used_blocks)
+{
+#ifndef __MINGW64__
+  // The image may be mapped as guest memory (by this process if it
+  // was restored from it or by others): Never rewrite it in place.
+  // Write a temporary file in the same directory and rename it over
+  // the target.
+  std::string tmpName = filename + ".XXXXXX";
+  int fd = mkstemp(&tmpName[0]);
+  if (fd < 0)
+    {
+      std::cerr << "Memory::saveSnapshotImage failed - cannot create "
+                << tmpName << " for write\n";
+      return false;
+    }
+  fchmod(fd, 0644);
+
+  // File offset is memory address. Zero pages are not written leaving
+  // holes in the file (which read as zero).
+  bool success = ftruncate(fd, size_) == 0;
+  std::vector<uint8_t> zero(pageSize_);
+
+  uint64_t nextPage = 0;  // Pages below this are already saved.
+  for (auto& blk : used_blocks)
+    {
+      if (not success or blk.second == 0 or blk.first >= size_)
+        continue;
+      uint64_t first = std::max(nextPage, blk.first >> pageShift_);
+      uint64_t end = std::min(blk.first + blk.second, uint64_t(size_));
+      uint64_t last = (end - 1) >> pageShift_;
+      for (uint64_t page = first; page <= last and success; ++page)
+        {
+          uint64_t addr = page << pageShift_;
+          const uint8_t* host = nullptr;
+          if (data_)
+            host = data_ + addr;
+          else
+            {
+              host = sparsePage(page);
+            }
+          if (not host or memcmp(host, zero.data(), pageSize_) == 0)
+            continue;
+          success = pwrite(fd, host, pageSize_, addr) == ssize_t(pageSize_);
+        }
+      nextPage = std::max(nextPage, last + 1);
+    }
+
+  if (not success)
+    std::cerr << "Memory::saveSnapshotImage failed - write into " << tmpName
+              << " failed with errno " << strerror(errno) << "\n";
+  if (close(fd) != 0)
+    success = false;
+
+  if (success and rename(tmpName.c_str(), filename.c_str()) != 0)
+    {
+      std::cerr << "Memory::saveSnapshotImage failed - cannot rename "
+                << tmpName << " to " << filename << ": " << strerror(errno) << "\n";
+      success = false;
+    }
+  if (not success)
+    unlink(tmpName.c_str());
+  return success;
+#else
+  std::cerr << "Memory::saveSnapshotImage: Not supported on this platform\n";
+  return false;
+#endif
+}
+
+
+bool
+Memory::loadSnapshotImage(const std::string& filename,
+                          const std::vector<std::pair<uint64_t,uint64_t>>& used_blocks)
+{
+#ifndef __MINGW64__
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    {
+      std::cerr << "Memory::loadSnapshotImage failed - cannot open "
+                << filename << " for read\n";
+      return false;
+    }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 or uint64_t(st.st_size) != size_)
+    {
+      std::cerr << "Memory::loadSnapshotImage failed - size of " << filename
+                << " is different from that of memory\n";
+      close(fd);
+      return false;
+    }
+
+  // Map the pages of the used blocks directly from the file (private
+  // copy-on-write mapping faulted in on demand) when the memory is
+  // one flat region of regular host pages. Otherwise, read them.
+  size_t hostPageSize = sysconf(_SC_PAGESIZE);
+  bool canMap = data_ and not hugeMapped_ and (pageSize_ % hostPageSize) == 0;
+
+  bool success = true;
+  for (auto& blk : used_blocks)
+    {
+      if (not success or blk.second == 0 or blk.first >= size_)
+        continue;
+
+      uint64_t begin = blk.first;
+      uint64_t end = std::min(blk.first + blk.second, uint64_t(size_));
+
+      if (canMap)
+        {
+          // Extend to host page boundaries: Whole pages were saved.
+          uint64_t first = begin & ~uint64_t(hostPageSize - 1);
+          uint64_t last = ((end + hostPageSize - 1) & ~uint64_t(hostPageSize - 1));
+          last = std::min(last, uint64_t(size_));
+          void* mem = mmap(data_ + first, last - first, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_FIXED | MAP_NORESERVE, fd, first);
+          if (mem != MAP_FAILED)
+            continue;
+        }
+
+      for (uint64_t addr = begin; addr < end and success; )
+        {
+          size_t chunk = contiguousSize(addr, std::min(uint64_t(1) << 30, end - addr));
+          ssize_t resp = pread(fd, hostAddr(addr), chunk, addr);
+          success = resp == ssize_t(chunk);
+          addr += chunk;
+        }
+    }
+
+  if (not success)
+    std::cerr << "Memory::loadSnapshotImage failed - read from " << filename
+              << " failed with errno " << strerror(errno) << "\n";
+
+  close(fd);  // Mappings remain valid.
+  return success;
+#else
+  std::cerr << "Memory::loadSnapshotImage: Not supported on this platform\n";
+  return false;
+#endif
+}
+
+
+void
+Memory::enableDirtyPageTracking(bool flag)
+{
+  if (flag == (dirty_ != nullptr))
+    return;
+
+  if (flag)
+    {
+#ifndef __MINGW64__
+      // Untouched parts of the map use no host memory.
+      void* mem = mmap(nullptr, pageCount_, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if (mem != (void*) -1)
+        dirty_ = reinterpret_cast<uint8_t*>(mem);
+#else
+      dirty_ = reinterpret_cast<uint8_t*>(calloc(pageCount_, 1));
+#endif
+      if (not dirty_)
+        std::cerr << "Failed to allocate dirty page map\n";
+      return;
+    }
+
+#ifndef __MINGW64__
+  munmap(dirty_, pageCount_);
+#else
+  free(dirty_);
+#endif
+  dirty_ = nullptr;
+}
+
+
+void
+Memory::clearDirtyPages()
+{
+  if (not dirty_)
+    return;
+#ifndef __MINGW64__
+  // Drop the pages of the map: They read back as zero.
+  if (madvise(dirty_, pageCount_, MADV_DONTNEED) == 0)
+    return;
+#endif
+  memset(dirty_, 0, pageCount_);
+}
+
+
+bool
+Memory::saveDirtyPages(const std::string& filename,
+                       const std::vector<std::pair<uint64_t,uint64_t>>& used_blocks,
+                       uint64_t& count)
+{
+  count = 0;
+  if (not dirty_)
+    return false;
+
+  gzFile gzout = gzopen(filename.c_str(), "wb");
+  if (not gzout)
+    {
+      std::cerr << "Memory::saveDirtyPages failed - cannot open " << filename
+                << " for write\n";
+      return false;
+    }
+
+  // Header: page size. Followed by one record per page: page address
+  // and page data.
+  uint64_t header = pageSize_;
+  bool success = gzwrite(gzout, &header, sizeof(header)) == sizeof(header);
+
+  uint64_t nextPage = 0;  // Pages below this are already saved.
+  for (auto& blk : used_blocks)
+    {
+      if (not success or blk.second == 0 or blk.first >= size_)
+        continue;
+      uint64_t first = std::max(nextPage, blk.first >> pageShift_);
+      uint64_t end = std::min(blk.first + blk.second, uint64_t(size_));
+      uint64_t last = (end - 1) >> pageShift_;
+      for (uint64_t page = first; page <= last and success; ++page)
+        {
+          if (not dirty_[page])
+            continue;
+          uint64_t addr = page << pageShift_;
+          success = (gzwrite(gzout, &addr, sizeof(addr)) == sizeof(addr) and
+                     gzwrite(gzout, readHostAddr(addr), pageSize_) == int(pageSize_));
+          count++;
+        }
+      nextPage = std::max(nextPage, last + 1);
+    }
+
+  if (not success)
+    std::cerr << "Memory::saveDirtyPages failed - write into " << filename
+              << " failed with errno " << strerror(errno) << "\n";
+  if (gzclose(gzout) != Z_OK)
+    success = false;
+  return success;
+}
+
+
+bool
+Memory::loadDirtyPages(const std::string& filename)
+{
+  gzFile gzin = gzopen(filename.c_str(), "rb");
+  if (not gzin)
+    {
+      std::cerr << "Memory::loadDirtyPages failed - cannot open "
+                << filename << " for read\n";
+      return false;
+    }
+
+  bool success = true;
+  uint64_t header = 0;
+  if (gzread(gzin, &header, sizeof(header)) != sizeof(header) or
+      header != pageSize_)
+    {
+      std::cerr << "Memory::loadDirtyPages failed - " << filename
+                << ": Bad header or page size different from that of memory\n";
+      success = false;
+    }
+
+  while (success)
+    {
+      uint64_t addr = 0;
+      int resp = gzread(gzin, &addr, sizeof(addr));
+      if (resp == 0 and gzeof(gzin))
+        break;
+      if (resp != sizeof(addr) or addr >= size_ or (addr & (pageSize_ - 1)))
+        {
+          std::cerr << "Memory::loadDirtyPages failed - " << filename
+                    << ": Corrupt or truncated file\n";
+          success = false;
+          break;
+        }
+      if (gzread(gzin, hostAddr(addr), pageSize_) != int(pageSize_))
+        {
+          std::cerr << "Memory::loadDirtyPages failed - " << filename
+                    << ": Truncated file\n";
+          success = false;
+        }
+    }
+
+  gzclose(gzin);
+  return success;
+}
+
+
 bool
 Memory::saveCacheSnapshot(const std::string& path)
 {
@@ -870,7 +1259,106 @@ void
 Memory::copy(const Memory& other)
 {
   size_t n = std::min(size_, other.size_);
-  memcpy(data_, other.data_, n);
+  if (data_ and other.data_)
+    {
+      memcpy(data_, other.data_, n);
+      return;
+    }
+
+  if (other.data_)
+    {
+      for (size_t addr = 0; addr < n; addr += pageSize_)
+        memcpy(hostAddr(addr), other.data_ + addr, std::min(pageSize_, n - addr));
+      return;
+    }
+
+  // Copy the pages touched in the sparse source.
+  std::lock_guard<std::mutex> lock(other.sparseMutex_);
+  for (size_t page : other.pageIxs_)
+    {
+      size_t addr = page << other.pageShift_;
+      if (addr >= n)
+        continue;
+      const uint8_t* host = other.sparsePage(page);
+      for (size_t offset = 0; offset < other.pageSize_ and addr + offset < n; )
+        {
+          size_t chunk = contiguousSize(addr + offset, std::min(other.pageSize_ - offset,
+                                                                n - addr - offset));
+          memcpy(hostAddr(addr + offset), host + offset, chunk);
+          offset += chunk;
+        }
+    }
+}
+
+
+uint8_t*
+Memory::allocatePage(size_t page) const
+{
+  std::lock_guard<std::mutex> lock(sparseMutex_);
+
+  // Publish a table or page only once it is zero-filled: Lookups
+  // (see sparsePage) do not take the lock.
+  TableSlot& slot = pageDir_[page >> dirShift_];
+  PageSlot* table = slot.load(std::memory_order_relaxed);
+  if (not table)
+    {
+      table = reinterpret_cast<PageSlot*>(mapZeroed((dirMask_ + 1)*sizeof(PageSlot)));
+      if (not table)
+        throw std::runtime_error("Out of memory");
+      slot.store(table, std::memory_order_release);
+      tableIxs_.push_back(page >> dirShift_);
+    }
+
+  PageSlot& pageSlot = table[page & dirMask_];
+  uint8_t* host = pageSlot.load(std::memory_order_relaxed);
+  if (not host)
+    {
+      host = reinterpret_cast<uint8_t*>(calloc(pageSize_, 1));
+      if (not host)
+        throw std::runtime_error("Out of memory");
+      pageSlot.store(host, std::memory_order_release);
+      pageIxs_.push_back(page);
+      residentPages_++;
+    }
+  return host;
+}
+
+
+size_t
+Memory::residentSize() const
+{
+  if (not data_)
+    {
+      // Directory and tables are mapped lazily: Estimate their
+      // resident part by one host page per entry set.
+      std::lock_guard<std::mutex> lock(sparseMutex_);
+      size_t hostPageSize = 4096;
+      size_t tables = tableIxs_.size();
+      size_t dirBytes = std::min(dirSize_*sizeof(TableSlot), (tables + 1)*hostPageSize);
+      size_t tableBytes = std::min(tables*(dirMask_ + 1)*sizeof(PageSlot),
+                                   (tables + residentPages_)*hostPageSize);
+      return (residentPages_ + 1)*pageSize_ + dirBytes + tableBytes;
+    }
+
+#if defined(__linux__)
+  // Count the pages of the flat region that the host made resident.
+  size_t hostPageSize = sysconf(_SC_PAGESIZE);
+  size_t chunk = hostPageSize * 64*1024;
+  std::vector<unsigned char> vec(64*1024);
+  size_t resident = 0;
+  for (size_t offset = 0; offset < size_; offset += chunk)
+    {
+      size_t len = std::min(chunk, size_ - offset);
+      if (mincore(data_ + offset, len, vec.data()) != 0)
+        return size_;
+      size_t count = (len + hostPageSize - 1) / hostPageSize;
+      for (size_t i = 0; i < count; ++i)
+        resident += vec[i] & 1;
+    }
+  return resident * hostPageSize;
+#else
+  return size_;
+#endif
 }
 
 
@@ -896,7 +1384,10 @@ Memory::specialInitializeByte(size_t addr, uint8_t value)
   if (writeCallback_)
     writeCallback_(addr, 1, value);
   else
-    data_[addr] = value;
+    {
+      *hostAddr(addr) = value;
+      markDirty(addr);
+    }
   return true;
 }
 
@@ -978,9 +1469,8 @@ Memory::narrowCcmRegion(size_t addr, bool trim)
 
   // If a region is ever configured, then only the configured parts
   // are available (accessible).
-  if (not regionConfigured_.at(region))
+  if (regionConfigured_.insert(region).second)
     {
-      regionConfigured_.at(region) = true;
       if (trim)
         {
           // Region never configured. Make it all inaccessible.
@@ -1000,7 +1490,7 @@ Memory::defineIccm(size_t addr, size_t size, bool trim)
 
   size_t region = addr / regionSize_;
   if (region < regionCount_)
-  regionHasLocalInst_.at(region) = true;
+    regionHasLocalInst_.insert(region);
 
   narrowCcmRegion(addr, trim);
   checkCcmOverlap("ICCM", addr, size, true, false, false);
@@ -1021,7 +1511,7 @@ Memory::defineDccm(size_t addr, size_t size, bool trim)
 
   size_t region = addr / regionSize_;
   if (region < regionCount_ and trim)
-    regionHasLocalData_.at(region) = true;
+    regionHasLocalData_.insert(region);
 
   narrowCcmRegion(addr, trim);
   checkCcmOverlap("DCCM", addr, size, false, true, false);
@@ -1042,7 +1532,7 @@ Memory::defineMemoryMappedRegisterArea(size_t addr, size_t size, bool trim)
 
   size_t region = addr / regionSize_;
   if (region < regionCount_ and trim)
-    regionHasLocalData_.at(region) = true;
+    regionHasLocalData_.insert(region);
 
   narrowCcmRegion(addr, trim);
   checkCcmOverlap("PIC memory", addr, size, false, false, true);
@@ -1110,16 +1600,14 @@ Memory::defineMemoryMappedRegisterWriteMask(size_t addr, uint32_t mask)
 void
 Memory::finishCcmConfig(bool iccmRw)
 {
-  for (size_t region = 0; region < regionCount_; ++region)
+  // Only regions with DCCM, PIC, or ICCM are configured.
+  for (size_t region : regionConfigured_)
     {
-      if (not regionConfigured_.at(region))
-	continue;   // Region does not have DCCM, PIC, or ICCM.
-
       // True if region has DCCM/PIC section(s).
-      bool hasData = regionHasLocalData_.at(region);
+      bool hasData = regionHasLocalData_.count(region);
 
       // True if region has ICCM section(s).
-      bool hasInst = regionHasLocalInst_.at(region);
+      bool hasInst = regionHasLocalInst_.count(region);
 
       if (hasInst and hasData)
 	{
@@ -1160,62 +1648,10 @@ Memory::finishCcmConfig(bool iccmRw)
 bool
 Memory::configureCache(uint64_t size, unsigned lineSize, unsigned setSize)
 {
-  delete cache_;
-  cache_ = nullptr;
+  deleteCache();
 
-  if (size == 0)
-    {
-      std::cerr << "Bad cache size: " << size << '\n';
-      return false;
-    }
-  unsigned logSize = static_cast<unsigned>(std::log2(size));
-  uint64_t p2Size = uint64_t(1) << logSize;
-  if (p2Size != size)
-    {
-      std::cerr << "Cache size not a power of 2: " << size << '\n';
-      return false;
-    }
-  if (size > 64L*1024L*1024L)
-    {
-      std::cerr << "Cache size too large: " << size << '\n';
-      return false;
-    }
-
-  if (setSize == 0)
-    {
-      std::cerr << "Bad cache associativity: " << setSize << '\n';
-      return false;
-    }
-  unsigned logSetSize = static_cast<unsigned>(std::log2(setSize));
-  unsigned p2SetSize = unsigned(1) << logSetSize;
-  if (p2SetSize != setSize)
-    {
-      std::cerr << "Cache associtivy is not a power of 2: " << setSize << '\n';
-      return false;
-    }
-  if (setSize > 64)
-    {
-      std::cerr << "Cache associativity too large: " << setSize << '\n';
-      return false;
-    }
-
-  if (lineSize == 0)
-    {
-      std::cerr << "Bad cache line size: " << lineSize << '\n';
-      return false;
-    }
-  unsigned logLineSize = static_cast<unsigned>(std::log2(lineSize));
-  unsigned p2LineSize = unsigned(1) << logLineSize;
-  if (p2LineSize != lineSize)
-    {
-      std::cerr << "Cache line size is not a power of 2: " << lineSize << '\n';
-      return false;
-    }
-  if (lineSize > 1024)
-    {
-      std::cerr << "Cache line size too large: " << lineSize << '\n';
-      return false;
-    }
+  if (not Cache::checkConfig(size, lineSize, setSize))
+    return false;
 
   cache_ = new Cache(size, lineSize, setSize);
   return true;
@@ -1225,6 +1661,8 @@ Memory::configureCache(uint64_t size, unsigned lineSize, unsigned setSize)
 void
 Memory::deleteCache()
 {
+  if (cache_)
+    cache_->printStats(std::cerr, "Cache");
   delete cache_;
   cache_ = nullptr;
 }
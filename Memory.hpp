@@ -14,15 +14,21 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <vector>
+#include <set>
 #include <unordered_map>
 #include <functional>
 #include <mutex>
+#include <atomic>
+#include <memory>
 #include <type_traits>
 #include <cassert>
+#include <cstring>
 #include "PmaManager.hpp"
 #include "Cache.hpp"
+#include "HugePage.hpp"
 
 
 namespace ELFIO
@@ -61,9 +67,10 @@ namespace WdRiscv
     /// zero. Given memory size (byte count) must be a multiple of 4
     /// otherwise, it is truncated to a multiple of 4. The memory
     /// is partitioned into regions according to the region size which
-    /// must be a power of 2.
+    /// must be a power of 2. If hugePages is true, try to back the
+    /// memory with huge host pages (see hugePageKind).
     Memory(size_t size, size_t pageSize = 4*1024,
-	   size_t regionSize = 256*1024*1024);
+	   size_t regionSize = 256*1024*1024, bool hugePages = false);
 
     /// Destructor.
     ~Memory();
@@ -71,12 +78,34 @@ namespace WdRiscv
     /// Define number of hardware threads for LR/SC. FIX: put this in
     /// constructor.
     void setHartCount(unsigned count)
-    { reservations_.resize(count); lastWriteData_.resize(count); }
+    {
+      reservations_.resize(count);
+      lastWriteData_.resize(count);
+      singleHart_ = count <= 1;
+    }
+
+    /// Return true if this memory is accessed by a single hart: No
+    /// synchronization is then needed between accesses.
+    bool isSingleHart() const
+    { return singleHart_; }
 
     /// Return memory size in bytes.
     size_t size() const
     { return size_; }
 
+    /// Return true if this memory is backed by host pages allocated
+    /// on first touch rather than by one contiguous host region.
+    bool isSparse() const
+    { return data_ == nullptr; }
+
+    /// Return the kind of host pages backing this memory.
+    HugePageKind hugePageKind() const
+    { return hugeKind_; }
+
+    /// Return the number of host bytes currently backing this memory
+    /// (resident footprint).
+    size_t residentSize() const;
+
     /// Read an unsigned integer value of type T from memory at the
     /// given address into value assuming a little-endian memory
     /// organization. Return true on success. Return false if any of
@@ -91,13 +120,13 @@ namespace WdRiscv
       if (address + sizeof(T) > size_)
         return false;
 #else
-      Pma pma1 = pmaMgr_.getPma(address);
+      Pma pma1 = pmaMgr_.getPma(address, PmaManager::Read);
       if (not pma1.isRead())
 	return false;
 
       if (address & (sizeof(T) - 1))  // If address is misaligned
 	{
-          Pma pma2 = pmaMgr_.getPma(address + sizeof(T) - 1);
+          Pma pma2 = pmaMgr_.getPma(address + sizeof(T) - 1, PmaManager::Read);
           if (not pma2.isRead())
             return false;
         }
@@ -121,9 +150,9 @@ namespace WdRiscv
           value = val;
         }
       else
-        value = *(reinterpret_cast<const T*>(data_ + address));
+        value = loadData<T>(address);
 #else
-      value = *(reinterpret_cast<const T*>(data_ + address));
+      value = loadData<T>(address);
 #endif
 
       if (cache_)
@@ -137,13 +166,13 @@ namespace WdRiscv
     template <typename T>
     bool readInst(size_t address, T& value) const
     {
-      Pma pma = pmaMgr_.getPma(address);
+      Pma pma = pmaMgr_.getPma(address, PmaManager::Fetch);
       if (pma.isExec())
 	{
 	  if (address & (sizeof(T) -1))
 	    {
               // Misaligned address: Check next address.
-              Pma pma2 = pmaMgr_.getPma(address + sizeof(T) - 1);
+              Pma pma2 = pmaMgr_.getPma(address + sizeof(T) - 1, PmaManager::Fetch);
 	      if (pma != pma2)
                 return false;  // Cannot cross an ICCM boundary.
 	    }
@@ -157,9 +186,9 @@ namespace WdRiscv
               value = val;
             }
           else
-            value = *(reinterpret_cast<const T*>(data_ + address));
+            value = loadData<T>(address);
 #else
-          value = *(reinterpret_cast<const T*>(data_ + address));
+          value = loadData<T>(address);
 #endif
 
           if (cache_)
@@ -175,13 +204,13 @@ namespace WdRiscv
     template <typename T>
     bool checkWrite(size_t address, T& value)
     {
-      Pma pma1 = pmaMgr_.getPma(address);
+      Pma pma1 = pmaMgr_.getPma(address, PmaManager::Write);
       if (not pma1.isWrite())
 	return false;
 
       if (address & (sizeof(T) - 1))  // If address is misaligned
 	{
-          Pma pma2 = pmaMgr_.getPma(address + sizeof(T) - 1);
+          Pma pma2 = pmaMgr_.getPma(address + sizeof(T) - 1, PmaManager::Write);
           if (pma1 != pma2)
             return false;
 	}
@@ -212,17 +241,17 @@ namespace WdRiscv
       if (address + sizeof(T) > size_)
         return false;
       sysHartIx = sysHartIx; // Avoid unused var warning.
-      *(reinterpret_cast<T*>(data_ + address)) = value;
+      storeData(address, value);
       return true;
 #endif
 
-      Pma pma1 = pmaMgr_.getPma(address);
+      Pma pma1 = pmaMgr_.getPma(address, PmaManager::Write);
       if (not pma1.isWrite())
 	return false;
 
       if (address & (sizeof(T) - 1))  // If address is misaligned
 	{
-          Pma pma2 = pmaMgr_.getPma(address + sizeof(T) - 1);
+          Pma pma2 = pmaMgr_.getPma(address + sizeof(T) - 1, PmaManager::Write);
           if (pma1 != pma2)
             return false;
 	}
@@ -255,12 +284,12 @@ namespace WdRiscv
         }
       else
         {
-          lwd.prevValue_ = *(reinterpret_cast<T*>(data_ + address));
-          *(reinterpret_cast<T*>(data_ + address)) = value;
+          lwd.prevValue_ = loadData<T>(address);
+          storeData(address, value);
         }
 #else
-      lwd.prevValue_ = *(reinterpret_cast<T*>(data_ + address));
-      *(reinterpret_cast<T*>(data_ + address)) = value;
+      lwd.prevValue_ = loadData<T>(address);
+      storeData(address, value);
 #endif
 
       return true;
@@ -293,7 +322,7 @@ namespace WdRiscv
         return false;
 
 #ifdef FAST_SLOPPY
-      value = *(reinterpret_cast<const T*>(data_ + address));
+      value = loadData<T>(address);
       return true;
 #endif
 
@@ -331,7 +360,7 @@ namespace WdRiscv
         }
 #endif
 
-      value = *(reinterpret_cast<const T*>(data_ + address));
+      value = loadData<T>(address);
       return true;
     }
 
@@ -482,7 +511,7 @@ namespace WdRiscv
         }
 #endif
 
-      *(reinterpret_cast<T*>(data_ + address)) = value;
+      storeData(address, value);
       return true;
     }
 
@@ -536,6 +565,49 @@ namespace WdRiscv
     size_t pageSize() const
     { return pageSize_; }
 
+    /// Write the given value at the given host address which must
+    /// correspond to the given memory address (see directPage). The
+    /// write is recorded as a last write like with the write method.
+    template <typename T>
+    void writeDirect(unsigned sysHartIx, size_t address, uint8_t* host,
+                     T value)
+    {
+      recordWrite(sysHartIx, address, *(reinterpret_cast<T*>(host)), value);
+      *(reinterpret_cast<T*>(host)) = value;
+      markDirty(address);
+    }
+
+    /// Copy size bytes from the given buffer to the given host address
+    /// which must correspond to the given memory address (see
+    /// directPage). The bytes must not cross a page boundary. Unlike
+    /// writeDirect, the copy is not recorded as a last write.
+    void copyDirect(size_t address, uint8_t* host, const void* data,
+                    size_t size)
+    {
+      memcpy(host, data, size);
+      markDirty(address);
+    }
+
+    /// Return the host address of the first byte of the page
+    /// containing the given address if every aligned access to that
+    /// page can be done directly on host memory: The page attributes
+    /// are uniform, readable (and writable if write is true), and
+    /// exclude memory-mapped registers, and no cache model or access
+    /// callback is attached. Return null otherwise.
+    uint8_t* directPage(size_t address, bool write)
+    {
+      if (cache_ or not pmaMgr_.isPageUniform(address))
+        return nullptr;
+#ifdef MEM_CALLBACKS
+      if (readCallback_ or writeCallback_)
+        return nullptr;
+#endif
+      Pma pma = pmaMgr_.getPma(address);
+      if (not pma.isRead() or pma.isMemMappedReg() or (write and not pma.isWrite()))
+        return nullptr;
+      return hostAddr(getPageStartAddr(address));
+    }
+
     /// Return the region size.
     size_t regionSize() const
     { return regionSize_; }
@@ -650,35 +722,58 @@ namespace WdRiscv
     /// emulation.
     bool getSimMemAddr(size_t addr, size_t& simAddr)
     {
-      if (addr >= size_)
-	return false;
+      if (addr >= size_ or not data_)
+	return false;  // Sparse memory is not contiguous on the host.
       simAddr = reinterpret_cast<size_t>(data_ + addr);
       return true;
     }
 
-    /// Track LR instructin resrvations.
+    /// Record a write of size bytes at the given address done outside
+    /// of the store/poke methods (through getSimMemAddr) if dirty page
+    /// tracking is enabled.
+    void markDirty(size_t addr, size_t size)
+    {
+      if (not dirty_ or size == 0 or addr >= size_)
+        return;
+      size_t last = addr + std::min(size - 1, size_ - 1 - addr);
+      for (size_t page = addr >> pageShift_; page <= (last >> pageShift_); ++page)
+        dirty_[page] = 1;
+    }
+
+    /// Track LR instructin resrvations. A reservation is only
+    /// modified by its own hart except for pokes.
     struct Reservation
     {
       size_t addr_ = 0;
       unsigned size_ = 0;
       bool valid_ = false;
+      uint32_t stamp_ = 0;    // Stamp of reserved line when made.
+      uint64_t value_ = 0;    // Value loaded by the LR.
     };
-      
+
     /// Invalidate LR reservations matching address of poked/written
     /// bytes and belonging to harts other than the given hart-id. The
     /// memory tracks one reservation per hart indexed by local hart
-    /// ids.
+    /// ids. In a multi-hart system, this is lock-free: the stamps of
+    /// the cache lines of the written bytes are advanced which
+    /// invalidates any reservation taken earlier on those lines. The
+    /// reservation of the writing hart is preserved.
     void invalidateOtherHartLr(unsigned sysHartIx, size_t addr,
                                unsigned storeSize)
     {
-      for (size_t i = 0; i < reservations_.size(); ++i)
+      if (singleHart_ or not anyLr_.load(std::memory_order_relaxed))
+        return;
+
+      auto& res = reservations_[sysHartIx];
+      size_t resIx = stampIx(res.addr_);
+      size_t last = stampIx(addr + storeSize - 1);
+      for (size_t ix = stampIx(addr); ; ix = (ix + 1) & stampMask_)
         {
-          if (i == sysHartIx) continue;
-          auto& res = reservations_[i];
-          if (addr >= res.addr_ and (addr - res.addr_) < res.size_)
-            res.valid_ = false;
-          else if (addr < res.addr_ and (res.addr_ - addr) < storeSize)
-            res.valid_ = false;
+          uint32_t prev = lineStamps_[ix].fetch_add(1, std::memory_order_release);
+          if (res.valid_ and ix == resIx and res.stamp_ == prev)
+            res.stamp_ = prev + 1;
+          if (ix == last)
+            break;
         }
     }
 
@@ -701,13 +796,21 @@ namespace WdRiscv
     void invalidateLr(unsigned sysHartIx)
     { reservations_.at(sysHartIx).valid_ = false; }
 
-    /// Make a LR reservation for the given hart.
-    void makeLr(unsigned sysHartIx, size_t addr, unsigned size)
+    /// Make a LR reservation for the given hart. Value is the value
+    /// loaded by the LR.
+    void makeLr(unsigned sysHartIx, size_t addr, unsigned size,
+                uint64_t value)
     {
       auto& res = reservations_.at(sysHartIx);
       res.addr_ = addr;
       res.size_ = size;
       res.valid_ = true;
+      res.value_ = value;
+      if (not singleHart_)
+        {
+          anyLr_.store(true, std::memory_order_relaxed);
+          res.stamp_ = lineStamps_[stampIx(addr)].load(std::memory_order_acquire);
+        }
     }
 
     /// Return true if given hart has a valid LR reservation for the
@@ -715,7 +818,88 @@ namespace WdRiscv
     bool hasLr(unsigned sysHartIx, size_t addr) const
     {
       auto& res = reservations_.at(sysHartIx);
-      return res.valid_ and res.addr_ == addr;
+      if (not res.valid_ or res.addr_ != addr)
+        return false;
+      if (singleHart_)
+        return true;
+      uint32_t stamp = lineStamps_[stampIx(addr)].load(std::memory_order_acquire);
+      return stamp == res.stamp_;
+    }
+
+    /// Write the given value for a store-conditional of the given
+    /// hart which must hold a reservation for the given address. In
+    /// a multi-hart system the write is done with a host atomic
+    /// compare-and-swap against the value loaded by the LR: Set
+    /// changed to true and return false if another hart modified the
+    /// location since. Return false if the location is not writable.
+    /// Locations that cannot be accessed atomically on the host (see
+    /// atomicHostAddr) are compared and written under a lock. Since
+    /// that depends only on the location and the memory configuration,
+    /// all the harts accessing such a location take the locked path.
+    template <typename T>
+    bool writeConditional(unsigned sysHartIx, size_t address, T value,
+                          bool& changed)
+    {
+      changed = false;
+      if (singleHart_)
+        return write(sysHartIx, address, value);
+
+      T* host = reinterpret_cast<T*>(atomicHostAddr(address, sizeof(T)));
+      if (not host)
+        {
+          std::lock_guard<std::mutex> lock(lrMutex_);
+          T current = 0;
+          if (read(address, current) and current != T(reservations_.at(sysHartIx).value_))
+            {
+              changed = true;
+              return false;
+            }
+          return write(sysHartIx, address, value);
+        }
+
+      T prev = T(reservations_.at(sysHartIx).value_);
+      if (not __atomic_compare_exchange_n(host, &prev, value, false,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+        {
+          changed = true;
+          return false;
+        }
+
+      recordWrite(sysHartIx, address, prev, value);
+      return true;
+    }
+
+    /// Return the host address of the given simulated address if an
+    /// aligned access of the given size to it can be done atomically
+    /// on host memory: The location is readable and writable, not a
+    /// memory-mapped register, and no cache model or access callback
+    /// is attached. Return null otherwise.
+    uint8_t* atomicHostAddr(size_t address, unsigned size)
+    {
+      if (cache_ or (address & (size - 1)) or address + size > size_)
+        return nullptr;
+#ifdef MEM_CALLBACKS
+      if (readCallback_ or writeCallback_)
+        return nullptr;
+#endif
+      Pma pma = pmaMgr_.getPma(address, PmaManager::Write);
+      if (not pma.isRead() or not pma.isWrite() or pma.isMemMappedReg())
+        return nullptr;
+      markDirty(address);
+      return hostAddr(address);
+    }
+
+    /// Record the given write (done by the given hart directly on
+    /// host memory) in the last-write information of the hart.
+    template <typename T>
+    void recordWrite(unsigned sysHartIx, size_t address, T prevValue,
+                     T value)
+    {
+      auto& lwd = lastWriteData_[sysHartIx];
+      lwd.size_ = sizeof(T);
+      lwd.addr_ = address;
+      lwd.value_ = value;
+      lwd.prevValue_ = prevValue;
     }
 
     /// Load contents of given ELF segment into memory.
@@ -726,6 +910,9 @@ namespace WdRiscv
     /// Helper to loadElfFile: Collet ELF symbols.
     void collectElfSymbols(ELFIO::elfio& reader);
 
+    /// Rebuild symbolRanges_ from symbols_.
+    void sortElfSymbols();
+
     /// Take a snapshot of the entire simulated memory into binary
     /// file. Return true on success or false on failure
     bool saveSnapshot(const std::string& filename,
@@ -736,6 +923,47 @@ namespace WdRiscv
     bool loadSnapshot(const std::string& filename,
                       const std::vector<std::pair<uint64_t,uint64_t>>& used_blocks);
 
+    /// Save the used blocks of the simulated memory into an
+    /// uncompressed image file in which the offset of a byte is its
+    /// address (zero pages are left as holes). Return true on success
+    /// or false on failure.
+    bool saveSnapshotImage(const std::string& filename,
+                           const std::vector<std::pair<uint64_t,uint64_t>>& used_blocks);
+
+    /// Load the used blocks of the simulated memory from an image file
+    /// saved by saveSnapshotImage. When possible, the file is mapped
+    /// (private, copy-on-write) as the backing store of the blocks so
+    /// that pages are read on first touch and shared between
+    /// simulators restoring the same image: The file must then not be
+    /// modified while in use. Return true on success or false on
+    /// failure.
+    bool loadSnapshotImage(const std::string& filename,
+                           const std::vector<std::pair<uint64_t,uint64_t>>& used_blocks);
+
+    /// Enable/disable tracking of the pages modified since the last
+    /// call to clearDirtyPages (see saveDirtyPages).
+    void enableDirtyPageTracking(bool flag);
+
+    /// Return true if dirty page tracking is enabled.
+    bool isTrackingDirtyPages() const
+    { return dirty_ != nullptr; }
+
+    /// Mark all pages as clean.
+    void clearDirtyPages();
+
+    /// Save the contents of the pages modified since the last call to
+    /// clearDirtyPages that overlap the given used blocks into the
+    /// given binary file (compressed). Return true on success or false
+    /// on failure. Set count to the number of saved pages.
+    bool saveDirtyPages(const std::string& filename,
+                        const std::vector<std::pair<uint64_t,uint64_t>>& used_blocks,
+                        uint64_t& count);
+
+    /// Overlay the simulated memory with the pages saved by
+    /// saveDirtyPages in the given file. Return true on success or
+    /// false on failure.
+    bool loadDirtyPages(const std::string& filename);
+
     /// Save tags of cache to the given file (sorted in descending
     /// order by age) returning true on success and false on
     /// failure. Return true if no cache is present.
@@ -747,6 +975,112 @@ namespace WdRiscv
 
   private:
 
+    /// Return the host address of the byte at the given simulated
+    /// address. With sparse backing the page of the address is
+    /// allocated on first touch and the returned address is valid up
+    /// to the end of that page only.
+    uint8_t* hostAddr(size_t address) const
+    {
+      if (data_)
+        return data_ + address;
+      return sparseHostAddr(address);
+    }
+
+    /// Return the host address of the byte at the given simulated
+    /// address for reading only. An untouched sparse page is not
+    /// allocated: it reads from a shared zero page.
+    const uint8_t* readHostAddr(size_t address) const
+    {
+      if (data_)
+        return data_ + address;
+      const uint8_t* host = sparsePage(address >> pageShift_);
+      return (host ? host : zeroPage_) + (address & (pageSize_ - 1));
+    }
+
+    /// Return the value of type T in host memory at the given
+    /// simulated address.
+    template <typename T>
+    T loadData(size_t address) const
+    {
+      if (data_ or (address & (pageSize_ - 1)) + sizeof(T) <= pageSize_)
+        return *(reinterpret_cast<const T*>(readHostAddr(address)));
+
+      T value = 0;  // Sparse access crossing a page boundary.
+      for (unsigned i = 0; i < sizeof(T); ++i)
+        value |= T(peekData(address + i)) << (8*i);
+      return value;
+    }
+
+    /// Store the given value in host memory at the given simulated
+    /// address.
+    template <typename T>
+    void storeData(size_t address, T value)
+    {
+      if (dirty_)
+        {
+          dirty_[address >> pageShift_] = 1;
+          dirty_[(address + sizeof(T) - 1) >> pageShift_] = 1;
+        }
+
+      if (data_ or (address & (pageSize_ - 1)) + sizeof(T) <= pageSize_)
+        {
+          *(reinterpret_cast<T*>(hostAddr(address))) = value;
+          return;
+        }
+
+      for (unsigned i = 0; i < sizeof(T); ++i)  // Crossing a page boundary.
+        *sparseHostAddr(address + i) = uint8_t(value >> (8*i));
+    }
+
+    /// Return the byte at the given address without allocating host
+    /// memory for it: an untouched sparse page reads as zero.
+    uint8_t peekData(size_t address) const
+    { return *readHostAddr(address); }
+
+    /// Sparse backing: Return the host page backing the given page
+    /// number or null if that page was never touched. Safe to call
+    /// concurrently with allocatePage.
+    uint8_t* sparsePage(size_t page) const
+    {
+      PageSlot* table = pageDir_[page >> dirShift_].load(std::memory_order_acquire);
+      if (not table)
+        return nullptr;
+      return table[page & dirMask_].load(std::memory_order_acquire);
+    }
+
+    /// Sparse backing: Return the host address of the byte at the
+    /// given address allocating its page if needed.
+    uint8_t* sparseHostAddr(size_t address) const
+    {
+      size_t page = address >> pageShift_;
+      uint8_t* host = sparsePage(page);
+      if (not host)
+        host = allocatePage(page);
+      return host + (address & (pageSize_ - 1));
+    }
+
+    /// Return the number of bytes, at most limit, that can be accessed
+    /// in host memory starting at the host address of the given
+    /// simulated address.
+    size_t contiguousSize(size_t address, size_t limit) const
+    {
+      if (data_)
+        return limit;
+      return std::min(limit, pageSize_ - (address & (pageSize_ - 1)));
+    }
+
+    /// Record a write to the page of the given address if dirty page
+    /// tracking is enabled.
+    void markDirty(size_t address)
+    {
+      if (dirty_)
+        dirty_[address >> pageShift_] = 1;
+    }
+
+    /// Sparse backing: Allocate (zero-filled) the host page backing
+    /// the given page number if not already done and return it.
+    uint8_t* allocatePage(size_t page) const;
+
     /// Information about last write operation by a hart.
     struct LastWriteData
     {
@@ -757,7 +1091,34 @@ namespace WdRiscv
     };
 
     size_t size_;        // Size of memory in bytes.
-    uint8_t* data_;      // Pointer to memory data.
+    uint8_t* data_;      // Pointer to memory data (null if sparse).
+    bool hugeMapped_ = false;   // True if data_ is from mapHugePages.
+    HugePageKind hugeKind_ = HugePageKind::None;
+
+    // Sparse backing (used when the memory is too large to be mapped
+    // as one host region): two-level directory of host pages indexed
+    // by page number. The directory and the second-level tables are
+    // mapped lazily (untouched parts use no host memory) so that the
+    // whole 64-bit address space may be backed. Pages and tables are
+    // allocated on first touch (under sparseMutex_) and published with
+    // release stores so that harts may look them up without locking.
+    // Reads of untouched pages use zeroPage_.
+    using PageSlot = std::atomic<uint8_t*>;
+    using TableSlot = std::atomic<PageSlot*>;
+    static constexpr size_t maxFlatSize_ = size_t(1) << 36;
+    TableSlot* pageDir_ = nullptr;
+    size_t dirSize_ = 0;       // Entries in pageDir_.
+    uint8_t* zeroPage_ = nullptr;
+    unsigned dirShift_ = 13;   // Page number bits covered by second level.
+    size_t dirMask_ = (size_t(1) << 13) - 1;
+    mutable std::vector<size_t> tableIxs_;  // Directory entries with a table.
+    mutable std::vector<size_t> pageIxs_;   // Allocated pages (page numbers).
+    mutable size_t residentPages_ = 0;  // Allocated host pages (sparse).
+    mutable std::mutex sparseMutex_;
+
+    // Dirty page map (one byte per page, non-zero if page was written
+    // since last clearDirtyPages). Null if tracking is disabled.
+    uint8_t* dirty_ = nullptr;
 
     // Memory is organized in regions (e.g. 256 Mb). Each region is
     // organized in pages (e.g 4kb). Each page is associated with
@@ -765,9 +1126,9 @@ namespace WdRiscv
     // associated with write-masks (one 4-byte mask per word).
     size_t regionCount_    = 16;
     size_t regionSize_     = 256*1024*1024;
-    std::vector<bool> regionConfigured_; // One per region.
-    std::vector<bool> regionHasLocalInst_; // One per region.
-    std::vector<bool> regionHasLocalData_; // One per region.
+    std::set<size_t> regionConfigured_;    // Indices of configured regions.
+    std::set<size_t> regionHasLocalInst_;  // Regions with ICCM.
+    std::set<size_t> regionHasLocalData_;  // Regions with DCCM/PIC.
 
     size_t pageCount_     = 1024*1024; // Should be derived from page size.
     size_t pageSize_      = 4*1024;    // Must be a power of 2.
@@ -782,7 +1143,29 @@ namespace WdRiscv
 
     std::unordered_map<std::string, ElfSymbol> symbols_;
 
+    // Symbols of non-zero size sorted by address for findElfFunction.
+    // Max end is the largest end address of this symbol and all the
+    // preceding ones: a backward search stops once it is not past
+    // the searched address.
+    struct SymbolRange
+    {
+      size_t addr_ = 0;
+      size_t end_ = 0;
+      size_t maxEnd_ = 0;
+      const std::string* name_ = nullptr;  // Key in symbols_.
+    };
+    std::vector<SymbolRange> symbolRanges_;
+
     std::vector<Reservation> reservations_;
+    bool singleHart_ = true;
+
+    // Reservation stamps (multi-hart only): one per hashed cache
+    // line, advanced by every store to the line.
+    size_t stampIx(size_t addr) const
+    { return (addr >> 6) & stampMask_; }
+    static constexpr size_t stampMask_ = (size_t(1) << 14) - 1;
+    std::unique_ptr<std::atomic<uint32_t>[]> lineStamps_;
+    std::atomic<bool> anyLr_ = false;  // True once a reservation is made.
     std::vector<LastWriteData> lastWriteData_;
 
     PmaManager pmaMgr_;
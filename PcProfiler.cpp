@@ -0,0 +1,220 @@
+// Copyright 2020 Western Digital Corporation or its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <map>
+#include <cinttypes>
+#include "PcProfiler.hpp"
+
+using namespace WdRiscv;
+
+
+PcProfiler::PcProfiler(bool perBlock)
+  : perBlock_(perBlock)
+{
+  // Root of the call tree: code executed before any tracked call.
+  nodes_.push_back(Node());
+  frames_.push_back(Frame());
+}
+
+
+static bool
+isLinkReg(unsigned reg)
+{
+  return reg == 1 or reg == 5;
+}
+
+
+void
+PcProfiler::updateStack(uint64_t pc, const DecodedInst& di, uint64_t nextPc)
+{
+  InstId id = di.instEntry()->instId();
+  unsigned rd = di.op0();
+  uint64_t returnAddr = pc + di.instSize();
+
+  if (id == InstId::jal or id == InstId::c_jal)
+    {
+      if (isLinkReg(rd))
+        call(nextPc, returnAddr);
+      return;
+    }
+
+  // jalr, c.jalr, c.jr: Use the return-address-stack hints of the
+  // RISCV spec.
+  unsigned rs1 = di.op1();
+  bool rdLink = isLinkReg(rd), rs1Link = isLinkReg(rs1);
+
+  if (rdLink and rs1Link and rd != rs1)
+    {
+      ret(nextPc);   // Co-routine style: pop then push.
+      call(nextPc, returnAddr);
+    }
+  else if (rdLink)
+    call(nextPc, returnAddr);
+  else if (rs1Link)
+    ret(nextPc);
+}
+
+
+void
+PcProfiler::call(uint64_t target, uint64_t returnAddr)
+{
+  if (frames_.size() >= maxDepth_)
+    return;  // Runaway recursion: Stay in current frame.
+
+  uint32_t parent = frames_.back().node_;
+  ChildKey key{parent, target};
+  auto iter = children_.find(key);
+  uint32_t node = 0;
+  if (iter != children_.end())
+    node = iter->second;
+  else
+    {
+      node = nodes_.size();
+      Node child;
+      child.parent_ = parent;
+      child.entry_ = target;
+      nodes_.push_back(child);
+      children_[key] = node;
+    }
+
+  Frame frame;
+  frame.node_ = node;
+  frame.returnAddr_ = returnAddr;
+  frames_.push_back(frame);
+}
+
+
+void
+PcProfiler::ret(uint64_t target)
+{
+  // Pop to the frame returning to the target (this also handles
+  // frames skipped by longjmp or exceptions). If no frame matches,
+  // pop one frame. The root frame is never popped.
+  for (size_t i = frames_.size(); i > 1; --i)
+    if (frames_[i-1].returnAddr_ == target)
+      {
+        frames_.resize(i-1);
+        return;
+      }
+
+  if (frames_.size() > 1)
+    frames_.pop_back();
+}
+
+
+std::string
+PcProfiler::functionName(uint64_t addr, const Symbolizer& symbolizer)
+{
+  std::string name;
+  uint64_t start = 0;
+  if (symbolizer and symbolizer(addr, name, start))
+    return name;
+
+  char buff[32];
+  snprintf(buff, sizeof(buff), "0x%" PRIx64, addr);
+  return buff;
+}
+
+
+void
+PcProfiler::report(FILE* out, const Symbolizer& symbolizer)
+{
+  if (perBlock_ and blockCount_)
+    endBlock();
+
+  uint64_t total = 0;
+  std::map<std::string, uint64_t> funcCounts;
+  for (const auto& [pc, count] : pcCounts_)
+    {
+      std::string name;
+      uint64_t start = 0;
+      if (not symbolizer or not symbolizer(pc, name, start))
+        name = "??";
+      funcCounts[name] += count;
+      total += count;
+    }
+
+  std::vector<std::pair<std::string, uint64_t>> funcs(funcCounts.begin(),
+                                                      funcCounts.end());
+  std::stable_sort(funcs.begin(), funcs.end(),
+                   [] (const auto& a, const auto& b) { return a.second > b.second; });
+
+  double scale = total ? 100.0 / double(total) : 0;
+
+  fprintf(out, "Retired instructions: %" PRIu64 "\n\n", total);
+  fprintf(out, "%14s %7s  %s\n", "Count", "Percent", "Function");
+  for (const auto& [name, count] : funcs)
+    fprintf(out, "%14" PRIu64 " %6.2f%%  %s\n", count, double(count)*scale,
+            name.c_str());
+
+  // Hottest addresses.
+  std::vector<std::pair<uint64_t, uint64_t>> pcs(pcCounts_.begin(), pcCounts_.end());
+  std::sort(pcs.begin(), pcs.end(),
+            [] (const auto& a, const auto& b) {
+              return a.second != b.second ? a.second > b.second : a.first < b.first;
+            });
+  if (pcs.size() > 100)
+    pcs.resize(100);
+
+  fprintf(out, "\n%18s %14s %7s  %s\n", perBlock_? "Block" : "Address",
+          "Count", "Percent", "Location");
+  for (const auto& [pc, count] : pcs)
+    {
+      std::string name;
+      uint64_t start = 0;
+      std::string location = "??";
+      if (symbolizer and symbolizer(pc, name, start))
+        {
+          char buff[32];
+          snprintf(buff, sizeof(buff), "+0x%" PRIx64, pc - start);
+          location = name + buff;
+        }
+      fprintf(out, "0x%016" PRIx64 " %14" PRIu64 " %6.2f%%  %s\n", pc, count,
+              double(count)*scale, location.c_str());
+    }
+}
+
+
+void
+PcProfiler::reportFolded(FILE* out, const Symbolizer& symbolizer,
+                         const std::string& prefix)
+{
+  std::vector<std::string> names(nodes_.size());
+  for (size_t i = 1; i < nodes_.size(); ++i)
+    names.at(i) = functionName(nodes_.at(i).entry_, symbolizer);
+  names.at(0) = prefix.empty() ? "[root]" : prefix;
+
+  std::vector<uint32_t> path;
+  for (size_t i = 0; i < nodes_.size(); ++i)
+    {
+      if (nodes_.at(i).count_ == 0)
+        continue;
+
+      path.clear();
+      for (uint32_t n = i; n != 0; n = nodes_.at(n).parent_)
+        path.push_back(n);
+      path.push_back(0);
+
+      std::string line;
+      for (size_t j = path.size(); j > 0; --j)
+        {
+          if (j != path.size())
+            line += ';';
+          line += names.at(path.at(j-1));
+        }
+      fprintf(out, "%s %" PRIu64 "\n", line.c_str(), nodes_.at(i).count_);
+    }
+}
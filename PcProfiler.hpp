@@ -0,0 +1,144 @@
+// Copyright 2020 Western Digital Corporation or its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include "DecodedInst.hpp"
+
+namespace WdRiscv
+{
+
+  /// Guest program profiler: Count retired instructions per program
+  /// counter (or per straight-line run of instructions for lower
+  /// overhead) and per call stack. Calls and returns are inferred
+  /// from jal/jalr using the RISCV link register conventions (x1 or
+  /// x5 as link register).
+  class PcProfiler
+  {
+  public:
+
+    /// Map an address to the name and start address of the function
+    /// containing it. Return false if no function contains it.
+    typedef std::function<bool(uint64_t addr, std::string& name,
+                               uint64_t& start)> Symbolizer;
+
+    /// Define a profiler. If perBlock is true, counts are kept per
+    /// run of sequentially executed instructions and attributed to
+    /// the address of the first instruction of the run.
+    PcProfiler(bool perBlock = false);
+
+    /// Record the retirement of the given decoded instruction at the
+    /// given pc. NextPc is the address of the next instruction.
+    void retire(uint64_t pc, const DecodedInst& di, uint64_t nextPc)
+    {
+      if (perBlock_)
+        {
+          if (blockCount_ == 0)
+            blockStart_ = pc;
+          blockCount_++;
+          if (nextPc != pc + di.instSize())
+            endBlock();
+        }
+      else
+        pcCounts_[pc]++;
+
+      nodes_[frames_.back().node_].count_++;
+
+      InstId id = di.instEntry()->instId();
+      if (id == InstId::jal or id == InstId::jalr or id == InstId::c_jal or
+          id == InstId::c_jalr or id == InstId::c_jr)
+        updateStack(pc, di, nextPc);
+    }
+
+    /// Write a report of the instruction counts per function sorted
+    /// in decreasing order followed by the hottest addresses.
+    void report(FILE* out, const Symbolizer& symbolizer);
+
+    /// Write the call stack profile in folded-stack format (one line
+    /// per stack: function names separated by semicolons followed by
+    /// a space and the count of instructions retired in that stack)
+    /// suitable for flame graph tools. Prefix, if not empty, is added
+    /// as the outermost frame of every stack.
+    void reportFolded(FILE* out, const Symbolizer& symbolizer,
+                      const std::string& prefix);
+
+  private:
+
+    /// Account for the pending run of instructions (per-block mode).
+    void endBlock()
+    {
+      pcCounts_[blockStart_] += blockCount_;
+      blockCount_ = 0;
+    }
+
+    /// Track calls and returns for a jal/jalr instruction.
+    void updateStack(uint64_t pc, const DecodedInst& di, uint64_t nextPc);
+
+    /// Push a frame for a call to the given target with the given
+    /// return address.
+    void call(uint64_t target, uint64_t returnAddr);
+
+    /// Pop frames for a return to the given address.
+    void ret(uint64_t target);
+
+    /// Return the name of the function at the given address.
+    static std::string functionName(uint64_t addr, const Symbolizer& symbolizer);
+
+    // A node of the call tree: a distinct call stack.
+    struct Node
+    {
+      uint32_t parent_ = 0;
+      uint64_t entry_ = 0;   // Called address.
+      uint64_t count_ = 0;   // Instructions retired in this stack.
+    };
+
+    struct Frame
+    {
+      uint32_t node_ = 0;
+      uint64_t returnAddr_ = 0;
+    };
+
+    struct ChildKey
+    {
+      uint32_t parent_;
+      uint64_t entry_;
+
+      bool operator==(const ChildKey& other) const
+      { return parent_ == other.parent_ and entry_ == other.entry_; }
+    };
+
+    struct ChildKeyHash
+    {
+      size_t operator()(const ChildKey& key) const
+      { return std::hash<uint64_t>()(key.entry_ * 31 + key.parent_); }
+    };
+
+    static constexpr size_t maxDepth_ = 1024;
+
+    bool perBlock_ = false;
+    uint64_t blockStart_ = 0;
+    uint64_t blockCount_ = 0;
+    std::unordered_map<uint64_t, uint64_t> pcCounts_;
+
+    std::vector<Node> nodes_;
+    std::vector<Frame> frames_;
+    std::unordered_map<ChildKey, uint32_t, ChildKeyHash> children_;
+  };
+}
@@ -15,6 +15,7 @@
 #include <iostream>
 #include <cmath>
 #include <cassert>
+#include <algorithm>
 #include "PmaManager.hpp"
 
 using namespace WdRiscv;
@@ -36,113 +37,121 @@ PmaManager::PmaManager(uint64_t memSize, uint64_t pageSize)
 
   // Whole memory is intially set for instruction/data/atomic access.
   // No iccm/dccm/mmr/io.
-  pagePmas_.resize(pageCount, Pma::Default);
+  Interval iv;
+  iv.start_ = 0;
+  iv.size_ = memSize_;
+  iv.pma_ = Pma(Pma::Default);
+  intervals_.push_back(iv);
+
+  for (auto& hit : lastHit_)
+    hit = 0;
 }
 
 
+Pma
+PmaManager::lookup(uint64_t addr, AccessType type) const
+{
+  if (addr >= memSize_)
+    return Pma();
+  size_t ix = findInterval(addr);
+  lastHit_[type].store(ix, std::memory_order_relaxed);
+  return intervals_[ix].pma_;
+}
+
+
+size_t
+PmaManager::findInterval(uint64_t addr) const
+{
+  // Find last interval starting at or before addr.
+  auto iter = std::upper_bound(intervals_.begin(), intervals_.end(), addr,
+                               [] (uint64_t a, const Interval& iv) {
+                                 return a < iv.start_;
+                               });
+  assert(iter != intervals_.begin());
+  return (iter - intervals_.begin()) - 1;
+}
+
+
+size_t
+PmaManager::split(uint64_t addr)
+{
+  if (addr >= memSize_)
+    return intervals_.size();
+
+  size_t ix = findInterval(addr);
+  Interval& iv = intervals_[ix];
+  if (iv.start_ == addr)
+    return ix;
+
+  Interval upper = iv;
+  upper.start_ = addr;
+  upper.size_ = iv.start_ + iv.size_ - addr;
+  iv.size_ = addr - iv.start_;
+  intervals_.insert(intervals_.begin() + ix + 1, upper);
+  return ix + 1;
+}
+
+
+template <typename F>
 void
-PmaManager::enable(uint64_t a0, uint64_t a1, Pma::Attrib attrib)
+PmaManager::update(uint64_t a0, uint64_t a1, F func)
 {
   a0 = (a0 >> 2) << 2;   // Make word aligned.
   a1 = (a1 >> 2) << 2;   // Make word aligned.
 
-  unsigned mask = attrib;
-
-  while (a0 <= a1)
+  if (a0 > a1 or a0 >= memSize_)
+    return;
+  uint64_t end = std::min(a1 + 4, memSize_);  // One past last word.
+
+  size_t first = split(a0);
+  size_t last = split(end);  // One past last interval to change.
+  for (size_t ix = first; ix < last; ++ix)
+    intervals_[ix].pma_ = func(intervals_[ix].pma_);
+
+  // Merge adjacent intervals with identical attributes. Only the
+  // changed intervals and their neighbors need to be examined.
+  size_t lo = first ? first - 1 : 0;
+  size_t hi = std::min(last + 1, intervals_.size());
+  size_t count = lo;
+  for (size_t ix = lo; ix < hi; ++ix)
     {
-      uint64_t p0 = getPageStartAddr(a0);
-      uint64_t p1 = getPageStartAddr(a1);
-      bool doWord = (a0 != p0) or (p0 == p1 and (a1 - a0 + 4 != pageSize_));
-      Pma pma = getPma(a0);
-      doWord = doWord or pma.word_;
-      if (doWord)
-        {
-          fracture(a0);
-          uint64_t last = std::min(a1, p0 + pageSize_ - 4);
-          for ( ; a0 <= last; a0 += 4)
-            {
-              pma = getPma(a0);
-              pma.attrib_ = pma.attrib_ | mask;
-              wordPmas_[a0>>2] = pma;
-            }
-        }
+      if (count > lo and intervals_[count-1].pma_ == intervals_[ix].pma_)
+        intervals_[count-1].size_ += intervals_[ix].size_;
       else
-        {
-          pma.attrib_ = pma.attrib_ | mask;
-          uint64_t pageIx = getPageIx(p0);
-          pagePmas_[pageIx] = pma;
-          a0 += pageSize_;
-        }
+        intervals_[count++] = intervals_[ix];
     }
+  intervals_.erase(intervals_.begin() + count, intervals_.begin() + hi);
+
+  for (auto& hit : lastHit_)
+    hit = 0;
 }
 
 
 void
-PmaManager::disable(uint64_t a0, uint64_t a1, Pma::Attrib attrib)
+PmaManager::enable(uint64_t a0, uint64_t a1, Pma::Attrib attrib)
 {
-  a0 = (a0 >> 2) << 2;   // Make word aligned.
-  a1 = (a1 >> 2) << 2;   // Make word aligned.
+  update(a0, a1, [attrib] (Pma pma) {
+                   pma.attrib_ = pma.attrib_ | attrib;
+                   return pma;
+                 });
+}
 
-  unsigned mask = ~attrib;
 
-  while (a0 <= a1)
-    {
-      uint64_t p0 = getPageStartAddr(a0);
-      uint64_t p1 = getPageStartAddr(a1);
-      bool doWord = (a0 != p0) or (p0 == p1 and (a1 - a0 + 4 != pageSize_));
-      Pma pma = getPma(a0);
-      doWord = doWord or pma.word_;
-      if (doWord)
-        {
-          fracture(a0);
-          uint64_t last = std::min(a1, p0 + pageSize_ - 4);
-          for ( ; a0 <= last; a0 += 4)
-            {
-              pma = getPma(a0);
-              pma.attrib_ = pma.attrib_ & mask;
-              wordPmas_[a0>>2] = pma;
-            }
-        }
-      else
-        {
-          pma.attrib_ = pma.attrib_ & mask;
-          uint64_t pageIx = getPageIx(p0);
-          pagePmas_[pageIx] = pma;
-          a0 += pageSize_;
-        }
-    }
+void
+PmaManager::disable(uint64_t a0, uint64_t a1, Pma::Attrib attrib)
+{
+  unsigned mask = ~attrib;
+  update(a0, a1, [mask] (Pma pma) {
+                   pma.attrib_ = pma.attrib_ & mask;
+                   return pma;
+                 });
 }
 
 
 void
 PmaManager::setAttribute(uint64_t a0, uint64_t a1, Pma::Attrib attrib)
 {
-  a0 = (a0 >> 2) << 2;   // Make word aligned.
-  a1 = (a1 >> 2) << 2;   // Make word aligned.
-
-  while (a0 <= a1)
-    {
-      uint64_t p0 = getPageStartAddr(a0);
-      uint64_t p1 = getPageStartAddr(a1);
-      bool doWord = (a0 != p0) or (p0 == p1 and (a1 - a0 + 4 != pageSize_));
-      Pma pma = getPma(a0);
-      doWord = doWord or pma.word_;
-      if (doWord)
-        {
-          fracture(a0);
-          Pma pma(attrib);
-          pma.word_ = true;
-          uint64_t last = std::min(a1, p0 + pageSize_ - 4);
-          for ( ; a0 <= last; a0 += 4)
-            wordPmas_[a0>>2] = pma;
-        }
-      else
-        {
-          uint64_t pageIx = getPageIx(p0);
-          pagePmas_[pageIx] = Pma(attrib);
-          a0 += pageSize_;
-        }
-    }
+  update(a0, a1, [attrib] (Pma) { return Pma(attrib); });
 }
 
 
@@ -262,19 +271,3 @@ PmaManager::changeMemMappedBase(uint64_t newBase)
   memMappedBase_ = newBase;
   return true;
 }
-
-
-void
-PmaManager::fracture(uint64_t addr)
-{
-  uint64_t pageIx = getPageIx(addr);
-  Pma pma = pagePmas_.at(pageIx);
-  if (pma.word_)
-    return;
-  pma.word_= true;
-
-  uint64_t words = pageSize_ / 4;
-  uint64_t wordIx = (pageIx*pageSize_) >> 2;
-  for (uint64_t i = 0; i < words; ++i, wordIx++)
-    wordPmas_[wordIx] = pma;
-}
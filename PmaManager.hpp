@@ -16,14 +16,13 @@
 
 #include <cstdint>
 #include <vector>
-#include <unordered_map>
+#include <atomic>
 
 namespace WdRiscv
 {
 
-  /// Physical memory attribute. An instance of this is usually
-  /// associated with a memory page. For sub-page attribution, an
-  /// instance is associated with a word-aligned memory word.
+  /// Physical memory attribute. An instance of this is associated
+  /// with a range of word-aligned memory words (see PmaManager).
   class Pma
   {
   public:
@@ -44,7 +43,7 @@ namespace WdRiscv
     /// Default constructor: No access allowed. No-dccm, no-iccm,
     /// no-mmr, no-atomic.
     Pma(Attrib a = None)
-      : attrib_(a), word_(false)
+      : attrib_(a)
     { }
 
     /// Return true if mapped.
@@ -109,7 +108,6 @@ namespace WdRiscv
   private:
 
     uint16_t attrib_ = 0;
-    bool word_ = false;     // True if word granularity otherwise page.
   };
 
 
@@ -123,28 +121,39 @@ namespace WdRiscv
 
     friend class Memory;
 
+    /// Type of access for which an attribute is looked up. Each type
+    /// has its own last-hit entry: fetches and data accesses usually
+    /// hit different intervals.
+    enum AccessType { Fetch, Read, Write, Other, AccessTypeCount };
+
     PmaManager(uint64_t memorySize, uint64_t pageSize);
 
     /// Return the physical memory attribute associated with the
     /// word-aligned word designated by the given address. Return an
     /// unmapped attribute if the given address is out of memory
-    /// range. Internally we associate a pma object with each page of
-    /// a regions where the first/last address is aligned with the
-    /// first/last address of a page. For a region where the first/last
-    /// address is not page-aligned we associate a pma object with
-    /// each word before/after the first/last page aligned address.
-    Pma getPma(uint64_t addr) const
+    /// range. Attributes are kept in a sorted table of intervals of
+    /// word-aligned words: the interval hit by the most recent lookup
+    /// of the given access type is checked first and the table is
+    /// searched only on a miss.
+    Pma getPma(uint64_t addr, AccessType type = Other) const
+    {
+      size_t ix = lastHit_[type].load(std::memory_order_relaxed);
+      const Interval& iv = intervals_[ix];
+      if (addr - iv.start_ < iv.size_)
+        return iv.pma_;
+      return lookup(addr, type);
+    }
+
+    /// Return true if the page containing the given address is in
+    /// memory range and all the words of that page have the same
+    /// attributes.
+    bool isPageUniform(uint64_t addr) const
     {
-      uint64_t ix = getPageIx(addr);
-      if (ix >= pagePmas_.size())
-        return Pma();
-      Pma pma = pagePmas_[ix];
-      if (pma.word_)
-        {
-          addr = (addr >> 2);  // Get word index.
-          pma = wordPmas_.at(addr);
-        }
-      return pma;
+      uint64_t start = getPageStartAddr(addr);
+      if (start >= memSize_)
+        return false;
+      const Interval& iv = intervals_[findInterval(start)];
+      return start + pageSize_ - iv.start_ <= iv.size_;
     }
 
     /// Enable given attribute in word-aligned words overlapping given
@@ -230,18 +239,38 @@ namespace WdRiscv
 
   private:
 
-    /// Fracture attribute of page overlapping given address into word
+    /// Range of memory with uniform attributes.
+    struct Interval
+    {
+      uint64_t start_ = 0;  // Address of first byte.
+      uint64_t size_ = 0;   // Byte count.
+      Pma pma_;
+    };
+
+    /// Slow path of getPma: Search the interval table and remember
+    /// the interval found in the last-hit entry of the given type.
+    Pma lookup(uint64_t addr, AccessType type) const;
+
+    /// Return the index of the interval containing the given address
+    /// which must be in memory range.
+    size_t findInterval(uint64_t addr) const;
+
+    /// Split the interval containing the given address (if in memory
+    /// range) so that an interval starts at that address. Return the
+    /// index of that interval or the interval count if out of range.
+    size_t split(uint64_t addr);
+
+    /// Replace the attributes of the word-aligned words overlapping
+    /// the given region with the result of applying the given
+    /// function to them. Merge adjacent intervals with identical
     /// attributes.
-    void fracture(uint64_t addr);
-
-    /// Return the page number corresponding to the given address.
-    uint64_t getPageIx(uint64_t addr) const
-    { return addr >> pageShift_; }
+    template <typename F>
+    void update(uint64_t a0, uint64_t a1, F func);
 
   private:
 
-    std::vector<Pma> pagePmas_;
-    std::unordered_map<uint64_t, Pma> wordPmas_; // Map word index to pma.
+    std::vector<Interval> intervals_;  // Sorted, cover whole memory.
+    mutable std::atomic<size_t> lastHit_[AccessTypeCount];
     uint64_t memSize_;
     uint64_t pageSize_ = 4*1024;
     unsigned pageShift_ = 12;
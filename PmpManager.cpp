@@ -14,6 +14,7 @@
 
 #include <iostream>
 #include <cmath>
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include "PmpManager.hpp"
@@ -37,8 +38,10 @@ PmpManager::PmpManager(uint64_t memSize, uint64_t pageSize)
   assert(pageCount * pageSize_ == memSize_);
 
   // Mark memory as no access (machine mode still has access because
-  // it is not checked).
-  pagePmps_.resize(pageCount, Pmp::None);
+  // it is not checked). Keep one entry per page for at most
+  // maxTablePages_ pages: Higher addresses use the (few) ranges set
+  // by setMode.
+  pagePmps_.resize(std::min(pageCount, maxTablePages_), Pmp::None);
 }
 
 
@@ -53,6 +56,7 @@ PmpManager::reset()
   for (auto& entry : pagePmps_)
     entry = Pmp(Pmp::None);
   wordPmps_.clear();
+  ranges_.clear();
 }
 
 
@@ -66,6 +70,20 @@ PmpManager::setMode(uint64_t a0, uint64_t a1, Pmp::Type type, Pmp::Mode mode,
   a0 = (a0 >> 2) << 2;   // Make word aligned.
   a1 = (a1 >> 2) << 2;   // Make word aligned.
 
+  uint64_t tableEnd = pagePmps_.size() * pageSize_;
+  if (a1 >= tableEnd)
+    {
+      Range range;
+      range.first_ = std::max(a0, tableEnd);
+      range.last_ = a1 + 3;
+      range.pmp_ = Pmp(mode, pmpIx, lock, type);
+      if (range.first_ <= range.last_)
+        ranges_.push_back(range);
+      if (a0 >= tableEnd)
+        return;
+      a1 = tableEnd - 4;
+    }
+
   while (a0 <= a1)
     {
       uint64_t p0 = getPageStartAddr(a0);
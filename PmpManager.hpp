@@ -133,7 +133,7 @@ namespace WdRiscv
     {
       uint64_t ix = getPageIx(addr);
       if (ix >= pagePmps_.size())
-        return Pmp();
+        return rangePmp(addr);
       Pmp pmp = pagePmps_[ix];
       if (pmp.word_)
         {
@@ -143,14 +143,31 @@ namespace WdRiscv
       return pmp;
     }
 
+    /// Return true if the page containing the given address is in
+    /// memory range and all the words of that page have the same
+    /// protection (the page was not fractured into words).
+    bool isPageUniform(uint64_t addr) const
+    {
+      uint64_t ix = getPageIx(addr);
+      if (ix < pagePmps_.size())
+        return not pagePmps_[ix].word_;
+      return isRangePageUniform(addr);
+    }
+
     /// Similar to getPmp but it also updates the access count associated with
     /// each PMP entry.
     inline Pmp accessPmp(uint64_t addr) const
     {
       uint64_t ix = getPageIx(addr);
+      Pmp pmp;
       if (ix >= pagePmps_.size())
-        return Pmp();
-      Pmp pmp = pagePmps_[ix];
+        {
+          if (addr >= memSize_)
+            return pmp;
+          pmp = rangePmp(addr);
+        }
+      else
+        pmp = pagePmps_[ix];
       if (pmp.word_)
         {
           addr = (addr >> 2);  // Get word index.
@@ -183,7 +200,7 @@ namespace WdRiscv
     void fracture(uint64_t addr)
     {
       uint64_t pageIx = getPageIx(addr);
-      if (pageIx > pagePmps_.size())
+      if (pageIx >= pagePmps_.size())
         return;
 
       Pmp pmp = pagePmps_.at(pageIx);
@@ -201,9 +218,48 @@ namespace WdRiscv
     uint64_t getPageIx(uint64_t addr) const
     { return addr >> pageShift_; }
 
+    /// Return the pmp of the given address which is beyond the pages
+    /// covered by pagePmps_: The last range set over the address
+    /// wins. Return a no-access object if no range covers the address.
+    Pmp rangePmp(uint64_t addr) const
+    {
+      if (addr < memSize_)
+        for (auto iter = ranges_.rbegin(); iter != ranges_.rend(); ++iter)
+          if (addr >= iter->first_ and addr <= iter->last_)
+            return iter->pmp_;
+      return Pmp();
+    }
+
+    /// Return true if all the words of the page of the given address,
+    /// which is beyond the pages covered by pagePmps_, have the same
+    /// protection.
+    bool isRangePageUniform(uint64_t addr) const
+    {
+      if (addr >= memSize_)
+        return false;
+      uint64_t first = getPageStartAddr(addr), last = first + pageSize_ - 1;
+      for (auto iter = ranges_.rbegin(); iter != ranges_.rend(); ++iter)
+        if (iter->first_ <= last and iter->last_ >= first)
+          return iter->first_ <= first and iter->last_ >= last;
+      return true;
+    }
+
+    /// Protection of an address range (inclusive bounds).
+    struct Range
+    {
+      uint64_t first_ = 0;
+      uint64_t last_ = 0;
+      Pmp pmp_;
+    };
+
+    // Number of pages covered by pagePmps_. The protection of pages
+    // beyond (in very large memories) is looked up in ranges_.
+    static constexpr uint64_t maxTablePages_ = uint64_t(1) << 22;
+
   private:
 
     std::vector<Pmp> pagePmps_;
+    std::vector<Range> ranges_;   // In the order they were set.
     std::unordered_map<uint64_t, Pmp> wordPmps_; // Map word index to pmp.
     uint64_t memSize_;
     uint64_t pageSize_ = 4*1024;
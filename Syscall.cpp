@@ -54,8 +54,9 @@ using namespace WdRiscv;
 #endif
 
 
-// Copy x86 stat buffer to riscv kernel_stat buffer.
-static void
+// Copy x86 stat buffer to riscv kernel_stat buffer. Return the number
+// of bytes written.
+static size_t
 copyStatBufferToRiscv(const struct stat& buff, void* rvBuff)
 {
   char* ptr = (char*) rvBuff;
@@ -93,11 +94,13 @@ copyStatBufferToRiscv(const struct stat& buff, void* rvBuff)
   *((uint32_t*) ptr) = buff.st_ctim.tv_sec;     ptr += 4;
   *((uint32_t*) ptr) = buff.st_ctim.tv_nsec;    ptr += 4;
 #endif
+  return ptr - (char*) rvBuff;
 }
 
 
-// Copy x86 tms struct (used by times) to riscv (32-bit version).
-static void
+// Copy x86 tms struct (used by times) to riscv (32-bit version). Return
+// the number of bytes written.
+static size_t
 copyTmsToRiscv32(const struct tms& buff, void* rvBuff)
 {
   char* ptr = (char*) rvBuff;
@@ -105,11 +108,13 @@ copyTmsToRiscv32(const struct tms& buff, void* rvBuff)
   *((uint32_t*) ptr) = buff.tms_stime;          ptr += 4;
   *((uint32_t*) ptr) = buff.tms_cutime;         ptr += 4;
   *((uint32_t*) ptr) = buff.tms_cstime;         ptr += 4;
+  return ptr - (char*) rvBuff;
 }
 
 
-// Copy x86 tms struct (used by times) to riscv (64-bit version).
-static void
+// Copy x86 tms struct (used by times) to riscv (64-bit version). Return
+// the number of bytes written.
+static size_t
 copyTmsToRiscv64(const struct tms& buff, void* rvBuff)
 {
   char* ptr = (char*) rvBuff;
@@ -117,36 +122,42 @@ copyTmsToRiscv64(const struct tms& buff, void* rvBuff)
   *((uint64_t*) ptr) = buff.tms_stime;          ptr += 8;
   *((uint64_t*) ptr) = buff.tms_cutime;         ptr += 8;
   *((uint64_t*) ptr) = buff.tms_cstime;         ptr += 8;
+  return ptr - (char*) rvBuff;
 }
 
 
-// Copy x86 timeval buffer to riscv timeval buffer (32-bit version).
-static void
+// Copy x86 timeval buffer to riscv timeval buffer (32-bit
+// version). Return the number of bytes written.
+static size_t
 copyTimevalToRiscv32(const struct timeval& buff, void* rvBuff)
 {
   char* ptr = (char*) rvBuff;
   *((uint64_t*) ptr) = buff.tv_sec;             ptr += 8;
   *((uint32_t*) ptr) = buff.tv_usec;            ptr += 4;
+  return ptr - (char*) rvBuff;
 }
 
 
-// Copy x86 timeval buffer to riscv timeval buffer (32-bit version).
-static void
+// Copy x86 timeval buffer to riscv timeval buffer (64-bit
+// version). Return the number of bytes written.
+static size_t
 copyTimevalToRiscv64(const struct timeval& buff, void* rvBuff)
 {
   char* ptr = (char*) rvBuff;
   *((uint64_t*) ptr) = buff.tv_sec;             ptr += 8;
   *((uint64_t*) ptr) = buff.tv_usec;            ptr += 8;
+  return ptr - (char*) rvBuff;
 }
 
 
-// Copy x86 timezone to riscv
-static void
+// Copy x86 timezone to riscv. Return the number of bytes written.
+static size_t
 copyTimezoneToRiscv(const struct timezone& buff, void* rvBuff)
 {
   char* ptr = (char*) rvBuff;
   *((uint32_t*) ptr) = buff.tz_minuteswest;     ptr += 4;
   *((uint32_t*) ptr) = buff.tz_dsttime;         ptr += 4;
+  return ptr - (char*) rvBuff;
 }
 
 
@@ -607,7 +618,9 @@ Syscall<URV>::emulate()
 	  return SRV(-errno);
 	// Linux getcwd system call returns count of bytes placed in buffer
 	// unlike the C-library interface which returns pointer to buffer.
-	return strlen((char*) buffAddr) + 1;
+	size_t len = strlen((char*) buffAddr) + 1;
+	hart_.markSimMemDirty(a0, len);
+	return len;
       }
 
     case 25:       // fcntl
@@ -625,6 +638,8 @@ Syscall<URV>::emulate()
 	      if (not hart_.getSimMemAddr(a2, addr))
 		return SRV(-EINVAL);
 	      arg = (void*) addr;
+	      if (cmd == F_GETLK)
+		hart_.markSimMemDirty(a2, sizeof(struct flock));
 	    }
 	  }
 	int rc = fcntl(fd, cmd, arg);
@@ -641,6 +656,10 @@ Syscall<URV>::emulate()
 	    return SRV(-EINVAL);
 	errno = 0;
 	int rc = ioctl(fd, req, (char*) addr);
+	// The size of the argument is not known for all requests: Assume
+	// at most a page is written.
+	if (rc >= 0 and addr)
+	  hart_.markSimMemDirty(a2, 4096);
 	return rc < 0 ? SRV(-errno) : rc;
       }
 
@@ -741,6 +760,8 @@ Syscall<URV>::emulate()
 
 	errno = 0;
 	int rc = getdirentries64(fd, (char*) buffAddr, count, &base);
+	if (rc > 0)
+	  hart_.markSimMemDirty(a1, rc);
 	return rc < 0 ? SRV(-errno) : rc;
 #endif
       }
@@ -812,6 +833,8 @@ Syscall<URV>::emulate()
 	errno = 0;
 	ssize_t rc = readlinkat(dirfd, (const char*) pathAddr,
 				(char*) bufAddr, bufSize);
+	if (rc > 0)
+	  hart_.markSimMemDirty(buf, rc);
 	return  rc < 0 ? SRV(-errno) : rc;
       }
 
@@ -836,7 +859,7 @@ Syscall<URV>::emulate()
 	  return SRV(-errno);
 
 	// RvBuff contains an address: We cast it to a pointer.
-        copyStatBufferToRiscv(buff, (void*) rvBuff);
+        hart_.markSimMemDirty(a2, copyStatBufferToRiscv(buff, (void*) rvBuff));
 	return rc;
       }
 #endif
@@ -855,7 +878,7 @@ Syscall<URV>::emulate()
 	  return SRV(-errno);
 
 	// RvBuff contains an address: We cast it to a pointer.
-        copyStatBufferToRiscv(buff, (void*) rvBuff);
+        hart_.markSimMemDirty(a1, copyStatBufferToRiscv(buff, (void*) rvBuff));
 	return rc;
       }
 
@@ -902,6 +925,8 @@ Syscall<URV>::emulate()
 
 	errno = 0;
 	ssize_t rc = read(fd, (void*) buffAddr, count);
+	if (rc > 0)
+	  hart_.markSimMemDirty(a1, rc);
 	return rc < 0 ? SRV(-errno) : rc;
       }
 
@@ -964,10 +989,12 @@ Syscall<URV>::emulate()
 	if (ticks < 0)
 	  return SRV(-errno);
 
+	size_t size = 0;
 	if (sizeof(URV) == 4)
-	  copyTmsToRiscv32(tms0, (void*) buffAddr);
+	  size = copyTmsToRiscv32(tms0, (void*) buffAddr);
 	else
-	  copyTmsToRiscv64(tms0, (void*) buffAddr);
+	  size = copyTmsToRiscv64(tms0, (void*) buffAddr);
+	hart_.markSimMemDirty(a0, size);
 	
 	return ticks;
       }
@@ -983,6 +1010,7 @@ Syscall<URV>::emulate()
 	errno = 0;
 	int rc = uname(uts);
 	strcpy(uts->release, "5.14.0");
+	hart_.markSimMemDirty(a0, sizeof(struct utsname));
 	return rc < 0 ? SRV(-errno) : rc;
       }
 
@@ -1012,14 +1040,16 @@ Syscall<URV>::emulate()
 
 	if (tvAddr)
 	  {
+	    size_t size = 0;
 	    if (sizeof(URV) == 4)
-	      copyTimevalToRiscv32(tv0, (void*) tvAddr);
+	      size = copyTimevalToRiscv32(tv0, (void*) tvAddr);
 	    else
-	      copyTimevalToRiscv64(tv0, (void*) tvAddr);
+	      size = copyTimevalToRiscv64(tv0, (void*) tvAddr);
+	    hart_.markSimMemDirty(a0, size);
 	  }
 	
 	if (tzAddr)
-	  copyTimezoneToRiscv(tz0, (void*) tzAddr);
+	  hart_.markSimMemDirty(a1, copyTimezoneToRiscv(tz0, (void*) tzAddr));
 
 	return rc;
       }
@@ -1160,7 +1190,7 @@ Syscall<URV>::emulate()
 	  return SRV(-EINVAL);
 
 	// RvBuff contains an address: We cast it to a pointer.
-        copyStatBufferToRiscv(buff, (void*) rvBuff);
+        hart_.markSimMemDirty(a1, copyStatBufferToRiscv(buff, (void*) rvBuff));
 	return rc;
       }
     }
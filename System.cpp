@@ -12,6 +12,18 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+
+#if defined(__cpp_lib_filesystem)
+  #include <filesystem>
+  namespace FileSystem = std::filesystem;
+#else
+  #include <experimental/filesystem>
+  namespace FileSystem = std::experimental::filesystem;
+#endif
+
 #include "Hart.hpp"
 #include "Core.hpp"
 #include "System.hpp"
@@ -21,12 +33,13 @@ using namespace WdRiscv;
 
 template <typename URV>
 System<URV>::System(unsigned coreCount, unsigned hartsPerCore, size_t memSize,
-                    size_t pageSize)
+                    size_t pageSize, bool hugePages)
   : hartCount_(coreCount * hartsPerCore), hartsPerCore_(hartsPerCore)
 {
   cores_.resize(coreCount);
 
-  memory_ = std::make_shared<Memory>(memSize, pageSize);
+  size_t regionSize = 256*1024*1024;
+  memory_ = std::make_shared<Memory>(memSize, pageSize, regionSize, hugePages);
 
   Memory& mem = *(memory_.get());
   mem.setHartCount(hartCount_);
@@ -42,6 +55,8 @@ System<URV>::System(unsigned coreCount, unsigned hartsPerCore, size_t memSize,
         {
           auto hart = core->ithHart(i);
           sysHarts_.push_back(hart);
+          if (hugePages)
+            decodeCacheHugeKind_ = hart->useHugePagesForDecodeCache(true);
         }
     }
 }
@@ -50,6 +65,46 @@ System<URV>::System(unsigned coreCount, unsigned hartsPerCore, size_t memSize,
 template <typename URV>
 System<URV>::~System()
 {
+  for (auto hart : sysHarts_)
+    hart->setCacheHierarchy(nullptr);
+}
+
+
+template <typename URV>
+bool
+System<URV>::configureCaches(const CacheParams& l1i, const CacheParams& l1d,
+                             const std::vector<CacheParams>& shared)
+{
+  for (auto hart : sysHarts_)
+    hart->setCacheHierarchy(nullptr);
+  caches_.reset();
+
+  bool ok = true;
+  auto check = [&ok] (const CacheParams& params, const std::string& name) {
+    if (params.size_)
+      ok = Cache::checkConfig(params.size_, params.lineSize_, params.ways_, name) and ok;
+  };
+
+  check(l1i, "L1I");
+  check(l1d, "L1D");
+  for (size_t i = 0; i < shared.size(); ++i)
+    check(shared.at(i), "L" + std::to_string(i + 2));
+  if (not ok)
+    return false;
+
+  caches_ = std::make_unique<CacheHierarchy>(hartCount_, l1i, l1d, shared);
+  for (auto hart : sysHarts_)
+    hart->setCacheHierarchy(caches_.get());
+  return true;
+}
+
+
+template <typename URV>
+void
+System<URV>::printCacheStats(std::ostream& out) const
+{
+  if (caches_)
+    caches_->printStats(out);
 }
 
 
@@ -62,5 +117,124 @@ System<URV>::checkUnmappedElf(bool flag)
 }
 
 
+template <typename URV>
+bool
+System<URV>::isSystemSnapshot(const std::string& dir)
+{
+  return FileSystem::is_regular_file(FileSystem::path(dir) / "system");
+}
+
+
+template <typename URV>
+bool
+System<URV>::saveSnapshot(const std::string& dir)
+{
+  FileSystem::path dirPath = dir;
+  typedef std::pair<uint64_t, uint64_t> Block;
+  std::vector<Block> allBlocks;
+
+  for (unsigned i = 0; i < sysHarts_.size(); ++i)
+    {
+      FileSystem::path hartPath = dirPath / ("hart" + std::to_string(i));
+      if (not FileSystem::is_directory(hartPath))
+        if (not FileSystem::create_directories(hartPath))
+          {
+            std::cerr << "Error: Failed to create snapshot directory "
+                      << hartPath << '\n';
+            return false;
+          }
+
+      std::vector<Block> blocks;
+      if (not sysHarts_.at(i)->saveSnapshotState(hartPath.string(), blocks))
+        return false;
+      allBlocks.insert(allBlocks.end(), blocks.begin(), blocks.end());
+    }
+
+  // Merge the memory blocks used by the harts: The memory is saved
+  // once.
+  std::sort(allBlocks.begin(), allBlocks.end());
+  std::vector<Block> usedBlocks;
+  for (const auto& blk : allBlocks)
+    {
+      if (blk.second == 0)
+        continue;
+      if (not usedBlocks.empty())
+        {
+          Block& last = usedBlocks.back();
+          if (blk.first <= last.first + last.second)
+            {
+              last.second = std::max(last.first + last.second,
+                                     blk.first + blk.second) - last.first;
+              continue;
+            }
+        }
+      usedBlocks.push_back(blk);
+    }
+
+  FileSystem::path usedBlocksPath = dirPath / "usedblocks";
+  std::ofstream blocksOfs(usedBlocksPath.string(), std::ios::trunc);
+  for (const auto& blk : usedBlocks)
+    blocksOfs << blk.first << " " << blk.second << "\n";
+  blocksOfs.close();
+  if (not blocksOfs)
+    {
+      std::cerr << "Error: Failed to write " << usedBlocksPath << '\n';
+      return false;
+    }
+
+  if (not sysHarts_.at(0)->saveSnapshotMemory(dirPath.string(), usedBlocks))
+    return false;
+
+  // Written last: Marks the snapshot as complete.
+  FileSystem::path systemPath = dirPath / "system";
+  std::ofstream ofs(systemPath.string(), std::ios::trunc);
+  ofs << "harts " << sysHarts_.size() << "\n";
+  ofs.close();
+  if (not ofs)
+    {
+      std::cerr << "Error: Failed to write " << systemPath << '\n';
+      return false;
+    }
+
+  return true;
+}
+
+
+template <typename URV>
+bool
+System<URV>::loadSnapshot(const std::string& dir)
+{
+  FileSystem::path dirPath = dir;
+  FileSystem::path systemPath = dirPath / "system";
+
+  std::ifstream ifs(systemPath.string());
+  std::string tag;
+  unsigned count = 0;
+  if (not (ifs >> tag >> count) or tag != "harts")
+    {
+      std::cerr << "Error: Invalid system snapshot file " << systemPath << '\n';
+      return false;
+    }
+  if (count != sysHarts_.size())
+    {
+      std::cerr << "Error: Snapshot " << dir << " has " << count << " harts but"
+                << " system has " << sysHarts_.size() << '\n';
+      return false;
+    }
+
+  if (not sysHarts_.at(0)->loadSnapshotMemory(dirPath.string()))
+    return false;
+
+  for (unsigned i = 0; i < sysHarts_.size(); ++i)
+    {
+      FileSystem::path hartPath = dirPath / ("hart" + std::to_string(i));
+      if (not sysHarts_.at(i)->loadSnapshotState(hartPath.string()))
+        return false;
+    }
+
+  return true;
+}
+
+
 template class WdRiscv::System<uint32_t>;
 template class WdRiscv::System<uint64_t>;
@@ -18,6 +18,7 @@
 #include <memory>               // For shared_ptr
 #include <functional>
 #include "Memory.hpp"
+#include "CacheHierarchy.hpp"
 
 
 namespace WdRiscv
@@ -44,9 +45,11 @@ namespace WdRiscv
 
     /// Constructor: Construct a system with n (coreCount) cores each
     /// consisting of m (hartsPerCore) harts. The harts in this system
-    /// are indexed with 0 to n*m - 1.
+    /// are indexed with 0 to n*m - 1. If hugePages is true, try to
+    /// back the memory and the decoded instruction caches of the
+    /// harts with huge host pages.
     System(unsigned coreCount, unsigned hartsPerCore, size_t memSize,
-           size_t pageSize);
+           size_t pageSize, bool hugePages = false);
 
     ~System();
 
@@ -105,6 +108,49 @@ namespace WdRiscv
       memory_->defineWriteMemoryCallback(callback);
     }
 
+    /// Return the number of host bytes currently backing the
+    /// simulated memory.
+    size_t memoryResidentSize() const
+    { return memory_->residentSize(); }
+
+    /// Return the kind of host pages backing the simulated memory.
+    HugePageKind memoryHugePageKind() const
+    { return memory_->hugePageKind(); }
+
+    /// Return the kind of host pages backing the decoded instruction
+    /// caches of the harts.
+    HugePageKind decodeCacheHugePageKind() const
+    { return decodeCacheHugeKind_; }
+
+    /// Define a cache hierarchy for the performance model: A private
+    /// level-1 instruction and data cache per hart (with the given
+    /// parameters) followed by the given shared levels (L2, L3, ...).
+    /// A level of zero size is absent. Any previously defined
+    /// hierarchy is replaced. Return true on success and false if a
+    /// level has invalid parameters.
+    bool configureCaches(const CacheParams& l1i, const CacheParams& l1d,
+                         const std::vector<CacheParams>& shared);
+
+    /// Print the statistics of the cache hierarchy on the given
+    /// stream. Do nothing if no hierarchy is defined.
+    void printCacheStats(std::ostream& out) const;
+
+    /// Save a snapshot of the whole system (state of every hart, LR
+    /// reservations, timer alarms, and the shared memory saved once)
+    /// into the given directory: The state of hart i goes into
+    /// sub-directory hart<i>. The harts must be stopped. Return true
+    /// on success and false on failure.
+    bool saveSnapshot(const std::string& dir);
+
+    /// Restore the whole system from a snapshot saved by
+    /// saveSnapshot. The snapshot must have the same number of harts
+    /// as this system. Return true on success and false on failure.
+    bool loadSnapshot(const std::string& dir);
+
+    /// Return true if the given directory holds a system snapshot
+    /// (see saveSnapshot) rather than a single-hart snapshot.
+    static bool isSystemSnapshot(const std::string& dir);
+
     /// Break a hart-index-in-system into a core-index and a
     /// hart-index in core. Return true if successful and false if
     /// igven hart-index-in-system is out of bounds.
@@ -122,9 +168,11 @@ namespace WdRiscv
 
     unsigned hartCount_;
     unsigned hartsPerCore_;
+    HugePageKind decodeCacheHugeKind_ = HugePageKind::None;
 
     std::vector< std::shared_ptr<CoreClass> > cores_;
     std::vector< std::shared_ptr<HartClass> > sysHarts_; // All harts in system.
     std::shared_ptr<Memory> memory_ = nullptr;
+    std::unique_ptr<CacheHierarchy> caches_;  // Performance model caches.
   };
 }
@@ -1,12 +1,58 @@
 #include <cmath>
+#include <iostream>
 #include "VirtMem.hpp"
 
 using namespace WdRiscv;
 
 
-Tlb::Tlb(unsigned size)
-  : entries_(size)
+Tlb::Tlb(unsigned size, unsigned ways, unsigned superSize)
 {
+  configure(size, ways, superSize);
+}
+
+
+static bool
+isPowerOf2(uint64_t x)
+{
+  return x != 0 and (x & (x - 1)) == 0;
+}
+
+
+bool
+Tlb::checkConfig(unsigned size, unsigned ways, unsigned superSize,
+                 const std::string& tag)
+{
+  if (not isPowerOf2(size))
+    {
+      std::cerr << tag << ": TLB size is not a power of 2: " << size << '\n';
+      return false;
+    }
+  if (ways != 0 and (not isPowerOf2(ways) or ways > size))
+    {
+      std::cerr << tag << ": TLB associativity (" << ways << ") is not a power of "
+                << "2 or is larger than the TLB size (" << size << ")\n";
+      return false;
+    }
+  if (superSize > 1024)
+    {
+      std::cerr << tag << ": TLB superpage entry count too large: " << superSize
+                << '\n';
+      return false;
+    }
+  return true;
+}
+
+
+void
+Tlb::configure(unsigned size, unsigned ways, unsigned superSize)
+{
+  if (ways == 0 or ways > size)
+    ways = size;
+  ways_ = ways;
+  setMask_ = size / ways - 1;
+
+  entries_.assign(size, TlbEntry());
+  superEntries_.assign(superSize, TlbEntry());
 }
 
 
@@ -14,33 +60,42 @@ void
 Tlb::insertEntry(uint64_t virtPageNum, uint64_t physPageNum, uint32_t asid,
                  bool global, bool isUser, bool read, bool write, bool exec)
 {
-  TlbEntry* best = nullptr;
-  for (size_t i = 0; i < entries_.size(); ++i)
-    {
-      auto& entry = entries_[i];
-      if (not entry.valid_ or (best and entry.time_ < best->time_))
-        best = &entry;
-    }
-  best->valid_ = true;
-  best->virtPageNum_ = virtPageNum;
-  best->physPageNum_ = physPageNum;
-  best->time_ = time_++;
-  best->asid_ = asid;
-  best->global_ = global;
-  best->user_ = isUser;
-  best->read_ = read;
-  best->write_ = write;
-  best->exec_ = exec;
+  TlbEntry entry;
+  entry.valid_ = true;
+  entry.virtPageNum_ = virtPageNum;
+  entry.physPageNum_ = physPageNum;
+  entry.asid_ = asid;
+  entry.global_ = global;
+  entry.user_ = isUser;
+  entry.read_ = read;
+  entry.write_ = write;
+  entry.exec_ = exec;
+  insertEntry(entry);
 }
 
 
 void
 Tlb::insertEntry(const TlbEntry& te)
 {
+  // Superpages go to their own array. If there is none, the
+  // translation is not cached.
+  TlbEntry* set = nullptr;
+  size_t count = 0;
+  if (te.superBits_)
+    {
+      set = superEntries_.data();
+      count = superEntries_.size();
+    }
+  else
+    {
+      set = &entries_[(te.virtPageNum_ & setMask_) * ways_];
+      count = ways_;
+    }
+
   TlbEntry* best = nullptr;
-  for (size_t i = 0; i < entries_.size(); ++i)
+  for (size_t i = 0; i < count; ++i)
     {
-      auto& entry = entries_[i];
+      auto& entry = set[i];
       if (not entry.valid_)
         {
           best = &entry;
@@ -50,6 +105,61 @@ Tlb::insertEntry(const TlbEntry& te)
         best = &entry;
     }
 
+  if (not best)
+    return;
+
   *best = te;
   best->time_ = time_++;
 }
+
+
+void
+Tlb::invalidateVirtualPage(uint64_t pageNum)
+{
+  // A base page can only be in the set of its page number.
+  TlbEntry* set = &entries_[(pageNum & setMask_) * ways_];
+  for (unsigned way = 0; way < ways_; ++way)
+    if (set[way].matches(pageNum))
+      set[way].valid_ = false;
+  for (auto& entry : superEntries_)
+    if (entry.matches(pageNum))
+      entry.valid_ = false;
+}
+
+
+void
+Tlb::invalidateAsid(uint32_t asid)
+{
+  for (auto& entry : entries_)
+    if (entry.asid_ == asid and not entry.global_)
+      entry.valid_ = false;
+  for (auto& entry : superEntries_)
+    if (entry.asid_ == asid and not entry.global_)
+      entry.valid_ = false;
+}
+
+
+void
+Tlb::invalidateVirtualPageAsid(uint64_t pageNum, uint32_t asid)
+{
+  TlbEntry* set = &entries_[(pageNum & setMask_) * ways_];
+  for (unsigned way = 0; way < ways_; ++way)
+    {
+      auto& entry = set[way];
+      if (entry.matches(pageNum) and entry.asid_ == asid and not entry.global_)
+        entry.valid_ = false;
+    }
+  for (auto& entry : superEntries_)
+    if (entry.matches(pageNum) and entry.asid_ == asid and not entry.global_)
+      entry.valid_ = false;
+}
+
+
+void
+Tlb::printStats(std::ostream& out, const std::string& name) const
+{
+  uint64_t lookups = hits_ + misses_;
+  double ratio = lookups == 0? 0. : double(misses_)/double(lookups);
+  out << name << " lookups: " << lookups << " misses: " << misses_
+      << " miss ratio: " << ratio << '\n';
+}
@@ -15,6 +15,9 @@
 #pragma once
 
 #include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
 
 namespace WdRiscv
 {
@@ -26,6 +29,7 @@ namespace WdRiscv
     uint64_t physPageNum_ = 0;
     uint64_t time_ = 0;      // Access time (we use order to approximate time).
     uint32_t asid_ = 0;      // Address space identifier.
+    uint32_t superBits_ = 0; // Count of page number bits covered by a superpage.
     bool valid_ = false;
     bool global_ = false;    // 
     bool user_ = false;      // User-mode entry if true.
@@ -34,29 +38,71 @@ namespace WdRiscv
     bool exec_ = false;      // Execute Access.
     bool accessed_ = false;
     bool dirty_ = false;
+
+    /// Return true if this entry covers the given virtual page number.
+    bool matches(uint64_t pageNum) const
+    { return ((pageNum ^ virtPageNum_) >> superBits_) == 0; }
+
+    /// Return the physical page number corresponding to the given
+    /// virtual page number which must be covered by this entry.
+    uint64_t physPageNum(uint64_t pageNum) const
+    { return physPageNum_ | (pageNum & ((uint64_t(1) << superBits_) - 1)); }
   };
 
 
-  /// Translation lookaside buffer.
+  /// Translation lookaside buffer: A set-associative array for base
+  /// pages and a small fully associative array for superpages
+  /// (megapages, gigapages, ...). Replacement is least recently used
+  /// within a set.
   class Tlb
   {
   public:
 
-    /// Define a a TLB with the given size (number of entries).
-    Tlb(unsigned size);
+    /// Define a TLB with the given size (number of base page entries)
+    /// organized in sets of the given associativity (ways) and with
+    /// the given number of superpage entries. The size and ways must
+    /// be powers of 2 and the ways must not exceed the size. A ways
+    /// value of zero makes the base page array fully associative.
+    Tlb(unsigned size, unsigned ways = 0, unsigned superSize = 8);
+
+    /// Return true if the given geometry is valid (see constructor)
+    /// printing an error message on standard error and returning
+    /// false otherwise. The tag is used in the error messages.
+    static bool checkConfig(unsigned size, unsigned ways, unsigned superSize,
+                            const std::string& tag);
+
+    /// Change the geometry of this TLB (see constructor). All the
+    /// entries are invalidated. The counters are preserved.
+    void configure(unsigned size, unsigned ways, unsigned superSize);
 
     /// Return pointer to TLB entry associated with given virtual page
     /// number and address space identifier.  Return nullptr if no
     /// such entry.
     TlbEntry* findEntry(uint64_t pageNum, uint32_t asid)
     {
-      for (auto& entry : entries_)
-        if (entry.valid_ and entry.virtPageNum_ == pageNum)
+      TlbEntry* set = &entries_[(pageNum & setMask_) * ways_];
+      for (unsigned way = 0; way < ways_; ++way)
+        {
+          auto& entry = set[way];
+          if (entry.valid_ and entry.virtPageNum_ == pageNum)
+            if (entry.global_ or entry.asid_ == asid)
+              {
+                hits_++;
+                entry.time_ = time_++;
+                return &entry;
+              }
+        }
+
+      for (auto& entry : superEntries_)
+        if (entry.valid_ and entry.matches(pageNum))
           if (entry.global_ or entry.asid_ == asid)
             {
+              hits_++;
               entry.time_ = time_++;
               return &entry;
             }
+
+      misses_++;
       return nullptr;
     }
 
@@ -67,19 +113,48 @@ namespace WdRiscv
                      uint32_t asid, bool global, bool isUser, bool read,
                      bool write, bool exec);
 
-    /// Insert copy of given entry.
+    /// Insert copy of given entry. An entry with non-zero superBits_
+    /// goes into the superpage array.
     void insertEntry(const TlbEntry& entry);
 
+    /// Invalidate all the entries.
     void invalidate()
-    { for (auto& entry : entries_) entry.valid_ = false; }
+    {
+      for (auto& entry : entries_) entry.valid_ = false;
+      for (auto& entry : superEntries_) entry.valid_ = false;
+    }
+
+    /// Invalidate the entries covering the given virtual page number
+    /// regardless of their address space (including global entries).
+    void invalidateVirtualPage(uint64_t pageNum);
+
+    /// Invalidate the non-global entries of the given address space.
+    void invalidateAsid(uint32_t asid);
+
+    /// Invalidate the non-global entries of the given address space
+    /// covering the given virtual page number.
+    void invalidateVirtualPageAsid(uint64_t pageNum, uint32_t asid);
 
-  protected:
+    /// Return the number of lookups that found an entry.
+    uint64_t hits() const
+    { return hits_; }
+
+    /// Return the number of lookups that did not find an entry.
+    uint64_t misses() const
+    { return misses_; }
+
+    /// Print the hit and miss counts of this TLB on the given
+    /// stream. Each line starts with the given name.
+    void printStats(std::ostream& out, const std::string& name) const;
 
   private:
 
-    std::vector<TlbEntry> entries_;
+    std::vector<TlbEntry> entries_;       // Base pages: ways_ entries per set.
+    std::vector<TlbEntry> superEntries_;  // Superpages: fully associative.
+    unsigned ways_ = 1;
+    uint64_t setMask_ = 0;
     uint64_t time_ = 0;  // Access time (we use access order as approximation).
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
   };
 }
-
-    
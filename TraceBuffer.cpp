@@ -0,0 +1,172 @@
+// Copyright 2020 Western Digital Corporation or its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <chrono>
+#include "TraceBuffer.hpp"
+
+using namespace WdRiscv;
+
+
+TraceWriter::TraceWriter(FILE* out, unsigned hartCount, size_t maxPending)
+  : out_(out), maxPending_(maxPending), pending_(hartCount)
+{
+  for (unsigned i = 0; i < hartCount; ++i)
+    buffers_.push_back(std::make_unique<TraceBuffer>());
+}
+
+
+TraceWriter::~TraceWriter()
+{
+  stop();
+}
+
+
+void
+TraceWriter::start()
+{
+  if (thread_.joinable())
+    return;
+  stop_ = false;
+  thread_ = std::thread(&TraceWriter::loop, this);
+}
+
+
+void
+TraceWriter::stop()
+{
+  if (not thread_.joinable())
+    return;
+
+  for (auto& buffer : buffers_)
+    buffer->finish();
+
+  stop_ = true;
+  thread_.join();
+
+  collect();
+  drain(true);
+  if (out_)
+    fflush(out_);
+}
+
+
+bool
+TraceWriter::collect()
+{
+  bool moved = false;
+  for (size_t ix = 0; ix < buffers_.size(); ++ix)
+    {
+      TraceBuffer& buffer = *buffers_.at(ix);
+      Pending& pending = pending_.at(ix);
+
+      std::lock_guard<std::mutex> lock(buffer.mutex_);
+      pending.horizon_ = buffer.horizon_;
+      while (not buffer.full_.empty())
+        {
+          pendingBytes_ += buffer.full_.front().size();
+          pending.chunks_.push_back(std::move(buffer.full_.front()));
+          buffer.full_.pop_front();
+          moved = true;
+        }
+    }
+  return moved;
+}
+
+
+void
+TraceWriter::writeHead(unsigned hartIx)
+{
+  Pending& pending = pending_.at(hartIx);
+  const std::vector<char>& chunk = pending.chunks_.front();
+
+  const char* p = chunk.data() + pending.offset_;
+  uint32_t len = 0;
+  memcpy(&len, p + sizeof(uint64_t), sizeof(len));
+  fwrite(p + sizeof(uint64_t) + sizeof(len), 1, len, out_);
+
+  pending.offset_ += sizeof(uint64_t) + sizeof(len) + len;
+  if (pending.offset_ >= chunk.size())
+    {
+      pendingBytes_ -= chunk.size();
+      pending.chunks_.pop_front();
+      pending.offset_ = 0;
+    }
+}
+
+
+bool
+TraceWriter::drain(bool force)
+{
+  bool wrote = false;
+  unsigned count = pending_.size();
+
+  while (true)
+    {
+      // Find smallest (tag, hart-index) among the pending records.
+      unsigned best = count;
+      uint64_t bestTag = 0;
+      for (unsigned ix = 0; ix < count; ++ix)
+        {
+          const Pending& pending = pending_.at(ix);
+          if (pending.empty())
+            continue;
+          uint64_t tag = pending.headTag();
+          if (best == count or tag < bestTag)
+            {
+              best = ix;
+              bestTag = tag;
+            }
+        }
+
+      if (best == count)
+        break;  // Nothing pending.
+
+      // Check that no hart with nothing pending can still produce a
+      // record that sorts before the candidate.
+      bool blocked = false;
+      if (not force and pendingBytes_ <= maxPending_)
+        for (unsigned ix = 0; ix < count and not blocked; ++ix)
+          {
+            const Pending& pending = pending_.at(ix);
+            uint64_t horizon = pending.horizon_;
+            if (pending.empty() and
+                (horizon < bestTag or (horizon == bestTag and ix < best)))
+              blocked = true;
+          }
+      if (blocked)
+        break;
+
+      writeHead(best);
+      wrote = true;
+    }
+
+  return wrote;
+}
+
+
+void
+TraceWriter::loop()
+{
+  while (true)
+    {
+      bool stopping = stop_;
+      bool moved = collect();
+      bool wrote = drain(false);
+      if (stopping)
+        break;
+      if (not moved and not wrote)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
@@ -0,0 +1,176 @@
+// Copyright 2020 Western Digital Corporation or its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+
+namespace WdRiscv
+{
+
+  /// Per-hart buffer of instruction trace records. The hart appends
+  /// formatted records (each tagged with the instruction count) to a
+  /// private chunk without any locking. Full chunks are handed over to
+  /// a TraceWriter which drains them in a background thread. Only the
+  /// hand-over of a chunk (once every few thousand records) takes a
+  /// lock.
+  class TraceBuffer
+  {
+  public:
+
+    friend class TraceWriter;
+
+    /// Tag value of a buffer whose hart will produce no more records.
+    static constexpr uint64_t doneTag = ~uint64_t(0);
+
+    TraceBuffer(size_t chunkSize = 64*1024)
+      : chunkSize_(chunkSize)
+    { chunk_.reserve(chunkSize + 256); }
+
+    /// Append a record with the given tag and text. Tags of successive
+    /// records must not decrease.
+    void append(uint64_t tag, const std::string& text)
+    {
+      uint32_t len = text.size();
+      size_t offset = chunk_.size();
+      chunk_.resize(offset + sizeof(tag) + sizeof(len) + len);
+      char* p = chunk_.data() + offset;
+      memcpy(p, &tag, sizeof(tag));
+      memcpy(p + sizeof(tag), &len, sizeof(len));
+      memcpy(p + sizeof(tag) + sizeof(len), text.data(), len);
+      lastTag_ = tag;
+      if (chunk_.size() >= chunkSize_)
+        publish();
+    }
+
+    /// Hand over the records appended so far to the writer. The hart
+    /// will not produce records with tags smaller than that of the
+    /// last appended record.
+    void publish()
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (not chunk_.empty())
+        {
+          full_.push_back(std::move(chunk_));
+          chunk_ = std::vector<char>();
+          chunk_.reserve(chunkSize_ + 256);
+        }
+      if (horizon_ != doneTag)
+        horizon_ = lastTag_;
+    }
+
+    /// Hand over the records appended so far and mark this buffer as
+    /// done: the hart will not produce any more records.
+    void finish()
+    {
+      publish();
+      std::lock_guard<std::mutex> lock(mutex_);
+      horizon_ = doneTag;
+    }
+
+  private:
+
+    size_t chunkSize_;
+    std::vector<char> chunk_;      // Chunk being filled by hart.
+    uint64_t lastTag_ = 0;         // Tag of last appended record.
+
+    std::mutex mutex_;             // Protect the following.
+    std::deque<std::vector<char>> full_;  // Chunks handed over to writer.
+    uint64_t horizon_ = 0;         // Smallest tag hart may still produce.
+  };
+
+
+  /// Drain the trace buffers of the harts of a system in a background
+  /// thread merging their records into a single trace file. Records
+  /// are written in (tag, hart-index) order: a record is written once
+  /// no buffer can produce a record that sorts before it. To bound
+  /// memory, if the records held by the writer exceed a limit (e.g.
+  /// when a hart starts long after the others), the smallest
+  /// available record is written without waiting.
+  class TraceWriter
+  {
+  public:
+
+    /// Define a writer for the given number of harts writing to the
+    /// given file.
+    TraceWriter(FILE* out, unsigned hartCount,
+                size_t maxPending = size_t(256) << 20);
+
+    ~TraceWriter();
+
+    /// Return the buffer associated with the given hart index.
+    TraceBuffer* buffer(unsigned hartIx)
+    { return hartIx < buffers_.size()? buffers_.at(hartIx).get() : nullptr; }
+
+    /// Start the background thread.
+    void start();
+
+    /// Mark all buffers done, wait for the background thread to write
+    /// all pending records, and flush the output file.
+    void stop();
+
+  private:
+
+    /// Pending records of one hart: chunks taken from its buffer and
+    /// the read offset into the first chunk.
+    struct Pending
+    {
+      std::deque<std::vector<char>> chunks_;
+      size_t offset_ = 0;
+      uint64_t horizon_ = 0;
+
+      bool empty() const
+      { return chunks_.empty(); }
+
+      uint64_t headTag() const
+      {
+        uint64_t tag = 0;
+        memcpy(&tag, chunks_.front().data() + offset_, sizeof(tag));
+        return tag;
+      }
+    };
+
+    /// Move published chunks from the buffers to the pending lists.
+    /// Return true if anything was moved.
+    bool collect();
+
+    /// Write pending records that can no longer be preceded by a
+    /// record yet to come. If force is true, write all pending
+    /// records. Return true if anything was written.
+    bool drain(bool force);
+
+    /// Write the first pending record of the given hart.
+    void writeHead(unsigned hartIx);
+
+    /// Background thread body.
+    void loop();
+
+    FILE* out_ = nullptr;
+    size_t maxPending_ = 0;
+    size_t pendingBytes_ = 0;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers_;
+    std::vector<Pending> pending_;
+    std::thread thread_;
+    std::atomic<bool> stop_ = false;
+  };
+}
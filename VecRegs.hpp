@@ -19,6 +19,8 @@
 #include <vector>
 #include <string>
 #include <cassert>
+#include <cstring>
+#include <algorithm>
 
 namespace WdRiscv
 {
@@ -401,6 +403,34 @@ namespace WdRiscv
       return true;
     }
 
+    /// Return a pointer to the elements of type T of the register
+    /// group starting at the given register if the first count
+    /// elements of the group are valid (same checks as read/write
+    /// with element index count-1). Return nullptr otherwise.
+    template<typename T>
+    T* groupData(uint32_t regNum, uint32_t count, uint32_t groupX8)
+    {
+      if (count * sizeof(T) > ((bytesPerReg_*groupX8) >> 3))
+        return nullptr;
+      if (regNum*bytesPerReg_ + count*sizeof(T) > bytesPerReg_*regCount_)
+        return nullptr;
+      return reinterpret_cast<T*>(data_ + regNum*bytesPerReg_);
+    }
+
+    /// Return the 64 bits of the given mask register corresponding to
+    /// the elements of indices ix to ix+63 (ix must be a multiple of
+    /// 64). Bits beyond the end of the register are zero.
+    uint64_t maskWord(uint32_t maskReg, uint32_t ix) const
+    {
+      uint64_t word = 0;
+      uint32_t byteIx = ix >> 3;
+      if (maskReg >= regCount_ or byteIx >= bytesPerReg_)
+        return word;
+      uint32_t count = std::min(uint32_t(sizeof(word)), bytesPerReg_ - byteIx);
+      memcpy(&word, data_ + maskReg*bytesPerReg_ + byteIx, count);
+      return word;
+    }
+
     /// Return the pointers to the 1st byte of the memory area
     /// associated with the given vector. Return nullptr if
     /// vector index is out of bounds.
@@ -8,9 +8,10 @@ using namespace WdRiscv;
 
 
 VirtMem::VirtMem(unsigned hartIx, Memory& memory, unsigned pageSize,
-                 PmpManager& pmpMgr, unsigned tlbSize)
+                 PmpManager& pmpMgr, unsigned tlbSize, unsigned tlbWays)
   : memory_(memory), mode_(Sv32), pageSize_(pageSize), hartIx_(hartIx),
-    pmpMgr_(pmpMgr), tlb_(tlbSize)
+    pmpMgr_(pmpMgr), itlb_(tlbSize, tlbWays), dtlb_(tlbSize, tlbWays),
+    walkCache_(64)
 {
   pageBits_ = static_cast<unsigned>(std::log2(pageSize_));
   unsigned p2PageSize =  unsigned(1) << pageBits_;
@@ -58,7 +59,7 @@ VirtMem::translateForFetch(uint64_t va, PrivilegeMode priv, uint64_t& pa)
 
   // Lookup virtual page number in TLB.
   uint64_t virPageNum = va >> pageBits_;
-  TlbEntry* entry = tlb_.findEntry(virPageNum, asid_);
+  TlbEntry* entry = itlb_.findEntry(virPageNum, asid_);
   if (entry)
     {
       // Use TLB entry.
@@ -74,7 +75,7 @@ VirtMem::translateForFetch(uint64_t va, PrivilegeMode priv, uint64_t& pa)
             return pageFaultType(false, false, true);
           entry->accessed_ = true;
         }
-      pa = (entry->physPageNum_ << pageBits_) | (va & pageMask_);
+      pa = (entry->physPageNum(virPageNum) << pageBits_) | (va & pageMask_);
       return ExceptionCause::NONE;
     }
 
@@ -94,7 +95,7 @@ VirtMem::translateForLoad(uint64_t va, PrivilegeMode priv, uint64_t& pa)
 
   // Lookup virtual page number in TLB.
   uint64_t virPageNum = va >> pageBits_;
-  TlbEntry* entry = tlb_.findEntry(virPageNum, asid_);
+  TlbEntry* entry = dtlb_.findEntry(virPageNum, asid_);
   if (entry)
     {
       // Use TLB entry.
@@ -111,7 +112,7 @@ VirtMem::translateForLoad(uint64_t va, PrivilegeMode priv, uint64_t& pa)
             return pageFaultType(true, false, false);
           entry->accessed_ = true;
         }
-      pa = (entry->physPageNum_ << pageBits_) | (va & pageMask_);
+      pa = (entry->physPageNum(virPageNum) << pageBits_) | (va & pageMask_);
       return ExceptionCause::NONE;
     }
 
@@ -130,7 +131,7 @@ VirtMem::translateForStore(uint64_t va, PrivilegeMode priv, uint64_t& pa)
 
   // Lookup virtual page number in TLB.
   uint64_t virPageNum = va >> pageBits_;
-  TlbEntry* entry = tlb_.findEntry(virPageNum, asid_);
+  TlbEntry* entry = dtlb_.findEntry(virPageNum, asid_);
   if (entry)
     {
       // Use TLB entry.
@@ -147,7 +148,7 @@ VirtMem::translateForStore(uint64_t va, PrivilegeMode priv, uint64_t& pa)
           entry->accessed_ = true;
           entry->dirty_ = true;
         }
-      pa = (entry->physPageNum_ << pageBits_) | (va & pageMask_);
+      pa = (entry->physPageNum(virPageNum) << pageBits_) | (va & pageMask_);
       return ExceptionCause::NONE;
     }
 
@@ -167,7 +168,8 @@ VirtMem::translate(uint64_t va, PrivilegeMode priv, bool read, bool write,
 
   // Lookup virtual page number in TLB.
   uint64_t virPageNum = va >> pageBits_;
-  TlbEntry* entry = tlb_.findEntry(virPageNum, asid_);
+  Tlb& tlb = exec? itlb_ : dtlb_;
+  TlbEntry* entry = tlb.findEntry(virPageNum, asid_);
   if (entry)
     {
       // Use TLB entry.
@@ -187,7 +189,7 @@ VirtMem::translate(uint64_t va, PrivilegeMode priv, bool read, bool write,
           if (write)
             entry->dirty_ = true;
         }
-      pa = (entry->physPageNum_ << pageBits_) | (va & pageMask_);
+      pa = (entry->physPageNum(virPageNum) << pageBits_) | (va & pageMask_);
       return ExceptionCause::NONE;
     }
 
@@ -230,7 +232,12 @@ VirtMem::pageTableWalkUpdateTlb(uint64_t va, PrivilegeMode priv, bool read,
 
   // If successful, cache translation results in TLB.
   if (cause == ExceptionCause::NONE)
-    tlb_.insertEntry(tmpTlbEntry);
+    {
+      if (exec)
+        itlb_.insertEntry(tmpTlbEntry);
+      else
+        dtlb_.insertEntry(tmpTlbEntry);
+    }
 
   return cause;
 }
@@ -255,6 +262,22 @@ VirtMem::pageTableWalk(uint64_t address, PrivilegeMode privMode, bool read, bool
   uint64_t pteAddr = 0;
   int ii = levels - 1;
 
+  // Skip the levels whose non-leaf entries are in the page-walk
+  // cache: Start at the deepest level with a known page table. The
+  // prefix of level i is made of the virtual page number bits of the
+  // levels above i.
+  bool cached = false;
+  for (int level = 0; level < ii and not cached; ++level)
+    if (findWalkCache(level, address >> pte.paPpnShift(level + 1), root))
+      {
+        ii = level;
+        cached = true;
+      }
+  if (cached)
+    walkCacheHits_++;
+  else
+    walkCacheMisses_++;
+
   while (true)
     {
       // 3.
@@ -281,6 +304,7 @@ VirtMem::pageTableWalk(uint64_t address, PrivilegeMode privMode, bool read, bool
           if (ii < 0)
             return pageFaultType(read, write, exec);
           root = pte.ppn() * pageSize_;
+          insertWalkCache(ii, address >> pte.paPpnShift(ii + 1), root, pteAddr);
           // goto 3.
         }
       else
@@ -338,9 +362,14 @@ VirtMem::pageTableWalk(uint64_t address, PrivilegeMode privMode, bool read, bool
   for (unsigned j = ii; j < levels; ++j)
     pa = pa | pte.ppn(j) << pte.paPpnShift(j);
 
-  // Update tlb-entry with data found in page table entry.
-  tlbEntry.virtPageNum_ = address >> pageBits_;
-  tlbEntry.physPageNum_ = pa >> pageBits_;
+  // Update tlb-entry with data found in page table entry. A leaf
+  // above the last level maps a superpage: The entry covers the page
+  // numbers differing only in the bits of the lower levels.
+  unsigned superBits = pte.paPpnShift(ii) - pte.paPpnShift(0);
+  uint64_t superMask = (uint64_t(1) << superBits) - 1;
+  tlbEntry.virtPageNum_ = (address >> pageBits_) & ~superMask;
+  tlbEntry.physPageNum_ = (pa >> pageBits_) & ~superMask;
+  tlbEntry.superBits_ = superBits;
   tlbEntry.asid_ = asid_;
   tlbEntry.valid_ = true;
   tlbEntry.global_ = pte.global();
@@ -355,6 +384,106 @@ VirtMem::pageTableWalk(uint64_t address, PrivilegeMode privMode, bool read, bool
 }
 
 
+bool
+VirtMem::configureTlb(bool instr, unsigned size, unsigned ways,
+                      unsigned superSize)
+{
+  if (not Tlb::checkConfig(size, ways, superSize, instr? "ITLB" : "DTLB"))
+    return false;
+
+  Tlb& tlb = instr? itlb_ : dtlb_;
+  tlb.configure(size, ways, superSize);
+  return true;
+}
+
+
+void
+VirtMem::flushTlb(uint64_t va, bool useVa, uint32_t asid, bool useAsid)
+{
+  // The non-leaf entries cached for the walks are invalidated
+  // whatever the operands.
+  flushWalkCache();
+
+  uint64_t pageNum = va >> pageBits_;
+
+  for (Tlb* tlb : { &itlb_, &dtlb_ })
+    {
+      if (useVa and useAsid)
+        tlb->invalidateVirtualPageAsid(pageNum, asid);
+      else if (useVa)
+        tlb->invalidateVirtualPage(pageNum);
+      else if (useAsid)
+        tlb->invalidateAsid(asid);
+      else
+        tlb->invalidate();
+    }
+}
+
+
+void
+VirtMem::printTlbStats(std::ostream& out, const std::string& prefix) const
+{
+  itlb_.printStats(out, prefix + "ITLB");
+  dtlb_.printStats(out, prefix + "DTLB");
+
+  uint64_t walks = walkCacheHits_ + walkCacheMisses_;
+  double ratio = walks == 0? 0. : double(walkCacheMisses_)/double(walks);
+  out << prefix << "Page walks: " << walks << " walk cache misses: "
+      << walkCacheMisses_ << " miss ratio: " << ratio << '\n';
+}
+
+
+void
+VirtMem::insertWalkCache(unsigned level, uint64_t prefix, uint64_t root,
+                         uint64_t pteAddr)
+{
+  uint64_t page = pteAddr >> 12;  // Page table pages are 4 KB.
+  uint64_t pageCount = memory_.size() >> 12;
+  if (page >= pageCount)
+    return;  // Outside simulated memory: Do not cache.
+
+  if (walkPages_.empty())
+    {
+      // In very large memories, fold page numbers onto a bounded map:
+      // A store to a page sharing an entry with a page table page
+      // (needlessly) flushes the cache.
+      constexpr uint64_t maxPages = uint64_t(1) << 24;
+      if (pageCount > maxPages)
+        {
+          pageCount = maxPages;
+          walkPageMask_ = maxPages - 1;
+        }
+      walkPages_.resize(pageCount);
+    }
+  page &= walkPageMask_;
+
+  auto& entry = walkCache_[walkCacheIndex(level, prefix)];
+  entry.valid_ = true;
+  entry.rootPage_ = pageTableRootPage_;
+  entry.prefix_ = prefix;
+  entry.table_ = root;
+  entry.level_ = level;
+
+  if (not walkPages_[page])
+    {
+      walkPages_[page] = true;
+      walkPageList_.push_back(page);
+    }
+}
+
+
+void
+VirtMem::flushWalkCache()
+{
+  for (auto& entry : walkCache_)
+    entry.valid_ = false;
+
+  for (auto page : walkPageList_)
+    walkPages_[page] = false;
+  walkPageList_.clear();
+}
+
+
 bool
 VirtMem::setPageSize(uint64_t size)
 {
@@ -376,8 +376,11 @@ namespace WdRiscv
 
     enum Mode { Bare = 0, Sv32 = 1, Sv39 = 8, Sv48 = 9, Sv57 = 10, Sv64 = 11 };
 
+    /// Define a virtual memory translator with separate instruction
+    /// and data TLBs each having tlbSize entries organized in sets of
+    /// tlbWays entries (see Tlb).
     VirtMem(unsigned hartIx, Memory& memory, unsigned pageSize,
-            PmpManager& pmpMgr, unsigned tlbSize);
+            PmpManager& pmpMgr, unsigned tlbSize, unsigned tlbWays);
 
     /// Perform virtual to physical memory address translation and
     /// check for read access if the read flag is true (similary aslo
@@ -405,6 +408,40 @@ namespace WdRiscv
     uint64_t pageStartAddress(uint64_t address) const
     { return (address >> pageBits_) << pageBits_; }
 
+    /// Change the geometry of the instruction TLB (instr is true) or
+    /// the data TLB (see Tlb) invalidating its entries. Return true on
+    /// success and false if the geometry is not valid.
+    bool configureTlb(bool instr, unsigned size, unsigned ways,
+                      unsigned superSize);
+
+    /// Invalidate TLB entries as done by SFENCE.VMA: If useVa is true,
+    /// only the entries covering the given virtual address and, if
+    /// useAsid is true, only the non-global entries of the given
+    /// address space.
+    void flushTlb(uint64_t va, bool useVa, uint32_t asid, bool useAsid);
+
+    /// Print the hit/miss counts of the instruction and data TLBs and
+    /// of the page-walk cache on the given stream. Each line starts
+    /// with the given prefix.
+    void printTlbStats(std::ostream& out, const std::string& prefix) const;
+
+    /// Invalidate the page-walk cache (cached non-leaf page table
+    /// entries).
+    void flushWalkCache();
+
+    /// Called after a store to the given physical address: Invalidate
+    /// the page-walk cache if the address is in a page holding one of
+    /// the cached page table entries.
+    void noteStore(uint64_t physAddr)
+    {
+      if (not walkPageList_.empty())
+        {
+          uint64_t page = (physAddr >> 12) & walkPageMask_;  // 4 KB pages.
+          if (page < walkPages_.size() and walkPages_[page])
+            flushWalkCache();
+        }
+    }
+
     /// Debug method: Print all the entries in the page table.
     void printPageTable(std::ostream& os) const;
 
@@ -421,6 +458,38 @@ namespace WdRiscv
     ExceptionCause pageTableWalk(uint64_t va, PrivilegeMode pm, bool read, bool write,
                                  bool exec, uint64_t& pa, TlbEntry& tlbEntry);
 
+    /// Return in root the address of the page table of the given
+    /// level reached from the current root page when translating a
+    /// virtual address with the given prefix (virtual page number
+    /// bits of the higher levels). Return true if found in the
+    /// page-walk cache and false otherwise.
+    bool findWalkCache(unsigned level, uint64_t prefix, uint64_t& root)
+    {
+      const auto& entry = walkCache_[walkCacheIndex(level, prefix)];
+      if (entry.valid_ and entry.level_ == level and entry.prefix_ == prefix and
+          entry.rootPage_ == pageTableRootPage_)
+        {
+          root = entry.table_;
+          return true;
+        }
+      return false;
+    }
+
+    /// Remember in the page-walk cache that the page table of the
+    /// given level for the given prefix (see findWalkCache) is at
+    /// address root. The non-leaf entry pointing to it is at address
+    /// pteAddr: A store to its page invalidates the cache.
+    void insertWalkCache(unsigned level, uint64_t prefix, uint64_t root,
+                         uint64_t pteAddr);
+
+    /// Return the index of the page-walk cache slot for the given
+    /// level and prefix.
+    size_t walkCacheIndex(unsigned level, uint64_t prefix) const
+    {
+      uint64_t hash = (prefix * 0x9e3779b97f4a7c15ULL) ^ level ^ pageTableRootPage_;
+      return (hash >> 32) & (walkCache_.size() - 1);
+    }
+
     /// Helper to translate method.
     ExceptionCause pageTableWalkUpdateTlb(uint64_t va, PrivilegeMode pm, bool read,
                                           bool write, bool exec, uint64_t& pa);
@@ -433,6 +502,8 @@ namespace WdRiscv
     // Change the translation mode to m.  Page size is reset to 4096.
     void setMode(Mode m)
     {
+      if (m != mode_)
+        flushWalkCache();  // Levels have a different meaning in new mode.
       mode_ = m;
       pageSize_ = 4096;
       pageBits_ = 12;
@@ -477,7 +548,26 @@ namespace WdRiscv
     bool faultOnFirstAccess_ = true;  // Make this configurable.
 
     PmpManager& pmpMgr_;
-    Tlb tlb_;
+    Tlb itlb_;   // Instruction fetch translations.
+    Tlb dtlb_;   // Load/store translations.
+
+    /// Page-walk cache entry: Address of the page table of a level
+    /// for a root page and a virtual page number prefix.
+    struct WalkCacheEntry
+    {
+      uint64_t rootPage_ = 0;
+      uint64_t prefix_ = 0;
+      uint64_t table_ = 0;
+      unsigned level_ = 0;
+      bool valid_ = false;
+    };
+
+    std::vector<WalkCacheEntry> walkCache_;  // Direct mapped, power of 2 size.
+    std::vector<bool> walkPages_;            // Pages holding cached entries.
+    uint64_t walkPageMask_ = ~uint64_t(0);   // Folds page numbers onto walkPages_.
+    std::vector<uint64_t> walkPageList_;     // Set bits of walkPages_.
+    uint64_t walkCacheHits_ = 0;
+    uint64_t walkCacheMisses_ = 0;
   };
 
 }
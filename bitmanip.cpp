@@ -2080,6 +2080,9 @@ Hart<URV>::updateMemoryProtection()
     }
 
   pmpEnabled_ = impCount > 0;
+
+  // Cached host pages were checked against the old protection.
+  hostTlb_.flush();
 }
 
 
@@ -2090,6 +2093,8 @@ Hart<URV>::updateAddressTranslation()
   if (not isRvs())
     return;
 
+  hostTlb_.flush();
+
   URV value = 0;
   if (not peekCsr(CsrNumber::SATP, value))
     return;
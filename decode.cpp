@@ -31,6 +31,8 @@ Hart<URV>::decode(URV addr, uint32_t inst, DecodedInst& di)
   const InstEntry& entry = decode(inst, op0, op1, op2, op3);
 
   di.reset(addr, inst, &entry, op0, op1, op2, op3);
+  di.setHandler(execLabels_[size_t(entry.instId())]);
+  markCodePages(addr, di.instSize());
 
   // Set the mask bit for vector instructions.
   if (di.instEntry() and di.instEntry()->isVector())
@@ -2892,5 +2892,31 @@ Hart<URV>::disassembleInst(const DecodedInst& di, std::string& str)
 }
 
 
+template <typename URV>
+const std::string&
+Hart<URV>::disassembleCached(const DecodedInst& di)
+{
+  // Index cached in the decoded instruction. Check the code in case
+  // the pool was cleared since.
+  uint32_t ix = di.disasmIndex();
+  if (ix and ix <= disasmPool_.size() and disasmPool_[ix-1].first == di.inst())
+    return disasmPool_[ix-1].second;
+
+  auto iter = disasmMap_.find(di.inst());
+  if (iter != disasmMap_.end())
+    ix = iter->second;
+  else
+    {
+      disasmPool_.emplace_back(di.inst(), std::string());
+      disassembleInst(di, disasmPool_.back().second);
+      ix = disasmPool_.size();
+      disasmMap_[di.inst()] = ix;
+    }
+
+  di.setDisasmIndex(ix);
+  return disasmPool_[ix-1].second;
+}
+
+
 template class WdRiscv::Hart<uint32_t>;
 template class WdRiscv::Hart<uint64_t>;
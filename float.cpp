@@ -492,6 +492,8 @@ Hart<URV>::execFlw(const DecodedInst* di)
           peekFpReg(rd, prevRdVal);
           putInLoadQueue(ldSize, addr, rd, prevRdVal, false /*wide*/, true /*fp*/);
         }
+      if (caches_)
+        caches_->load(hartIx_, addr, ldSize);
       Uint32FloatUnion ufu(word);
       fpRegs_.writeSingle(rd, ufu.f);
       markFsDirty();
@@ -1655,6 +1657,9 @@ Hart<URV>::execFld(const DecodedInst* di)
           putInLoadQueue(ldSize, addr, rd, prevRdVal, false /*wide*/, true /*fp*/);
         }
 
+      if (caches_)
+        caches_->load(hartIx_, addr, ldSize);
+
       UDU udu;
       udu.u = val64;
       fpRegs_.write(di->op0(), udu.d);
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 
@@ -22,8 +23,19 @@ template <typename URV>
 bool
 Hart<URV>::saveSnapshot(const std::string& dir)
 {
-  FileSystem::path dirPath = dir;
   std::vector<std::pair<uint64_t,uint64_t>> usedBlocks;
+  if (not saveSnapshotState(dir, usedBlocks))
+    return false;
+  return saveSnapshotMemory(dir, usedBlocks);
+}
+
+
+template <typename URV>
+bool
+Hart<URV>::saveSnapshotState(const std::string& dir,
+                             std::vector<std::pair<uint64_t,uint64_t>>& usedBlocks)
+{
+  FileSystem::path dirPath = dir;
 
   FileSystem::path regPath = dirPath / "registers";
   if (not saveSnapshotRegs(regPath.string()))
@@ -33,10 +45,6 @@ Hart<URV>::saveSnapshot(const std::string& dir)
   if (not syscall_.saveUsedMemBlocks(usedBlocksPath.string(), usedBlocks))
     return false;
 
-  FileSystem::path memPath = dirPath / "memory";
-  if (not memory_.saveSnapshot(memPath.string(), usedBlocks))
-    return false;
-
   FileSystem::path fdPath = dirPath / "fd";
   if (not syscall_.saveFileDescriptors(fdPath.string()))
     return false;
@@ -45,10 +53,200 @@ Hart<URV>::saveSnapshot(const std::string& dir)
   if (not syscall_.saveMmap(mmapPath.string()))
     return false;
 
+  return true;
+}
+
+
+template <typename URV>
+bool
+Hart<URV>::saveSnapshotMemory(const std::string& dir,
+                              const std::vector<std::pair<uint64_t,uint64_t>>& usedBlocks)
+{
+  FileSystem::path dirPath = dir;
+
+  // Incremental snapshot: Save the pages modified since the previous
+  // snapshot and refer to that snapshot in the manifest.
+  FileSystem::path manifestPath = dirPath / "manifest";
+  FileSystem::path imagePath = dirPath / "memoryimage";
+  bool incremental = memory_.isTrackingDirtyPages() and not lastSnapshotDir_.empty();
+
+  // The loader prefers a memory image over the other forms: Remove
+  // one left by an older snapshot in this directory unless it is
+  // replaced below. Unlinking is safe even if the image is mapped.
+  if (incremental or not snapshotImage_)
+    if (FileSystem::exists(imagePath))
+      FileSystem::remove(imagePath);
+
+  if (incremental)
+    {
+      // A snapshot overwriting one of its own bases would make the
+      // chain cyclic.
+      std::vector<std::string> chain;
+      if (not snapshotChain(lastSnapshotDir_, chain))
+        return false;
+      std::error_code ec;
+      std::string canon = FileSystem::canonical(dirPath, ec).string();
+      if (std::find(chain.begin(), chain.end(), canon) != chain.end())
+        {
+          std::cerr << "Error: Incremental snapshot directory " << dirPath
+                    << " is in the chain of its own base " << lastSnapshotDir_ << '\n';
+          return false;
+        }
+
+      // Refer to a sibling base relatively so that the snapshots can
+      // be moved together.
+      FileSystem::path basePath = lastSnapshotDir_;
+      FileSystem::path base = FileSystem::absolute(basePath);
+      if (basePath.parent_path() == dirPath.parent_path())
+        base = FileSystem::path("..") / basePath.filename();
+
+      FileSystem::path pagesPath = dirPath / "dirtypages";
+      uint64_t count = 0;
+      if (not memory_.saveDirtyPages(pagesPath.string(), usedBlocks, count))
+        return false;
+
+      std::ofstream ofs(manifestPath.string(), std::ios::trunc);
+      if (not ofs)
+        {
+          std::cerr << "Hart::saveSnapshot failed - cannot open "
+                    << manifestPath << " for write\n";
+          return false;
+        }
+      ofs << "base " << base.string() << '\n';
+      ofs << "pages " << count << '\n';
+    }
+  else
+    {
+      if (FileSystem::exists(manifestPath))
+        FileSystem::remove(manifestPath);  // Stale from an older snapshot.
+
+      if (snapshotImage_)
+        {
+          if (not memory_.saveSnapshotImage(imagePath.string(), usedBlocks))
+            return false;
+        }
+      else
+        {
+          FileSystem::path memPath = dirPath / "memory";
+          if (not memory_.saveSnapshot(memPath.string(), usedBlocks))
+            return false;
+        }
+    }
+
   FileSystem::path cachePath = dirPath / "cache";
   if (not memory_.saveCacheSnapshot(cachePath))
     return false;
 
+  memory_.clearDirtyPages();
+  lastSnapshotDir_ = dirPath.string();
+  return true;
+}
+
+
+template <typename URV>
+bool
+Hart<URV>::snapshotChain(const std::string& dir, std::vector<std::string>& chain)
+{
+  chain.clear();
+
+  FileSystem::path dirPath = dir;
+  while (true)
+    {
+      std::error_code ec;
+      std::string canon = FileSystem::canonical(dirPath, ec).string();
+      if (ec)
+        {
+          std::cerr << "Error: Snapshot directory " << dirPath << " not found\n";
+          return false;
+        }
+      if (std::find(chain.begin(), chain.end(), canon) != chain.end())
+        {
+          std::cerr << "Error: Snapshot chain has a cycle at " << dirPath << '\n';
+          return false;
+        }
+      chain.push_back(canon);
+
+      FileSystem::path manifestPath = dirPath / "manifest";
+      if (not FileSystem::is_regular_file(manifestPath))
+        return true;  // Full snapshot: End of chain.
+
+      std::ifstream ifs(manifestPath.string());
+      std::string tag, baseStr;
+      if (not (ifs >> tag >> baseStr) or tag != "base")
+        {
+          std::cerr << "Error: Invalid snapshot manifest " << manifestPath << '\n';
+          return false;
+        }
+
+      FileSystem::path base = baseStr;
+      if (base.is_relative())
+        base = dirPath / base;
+      dirPath = base;
+    }
+}
+
+
+template <typename URV>
+bool
+Hart<URV>::loadSnapshotMemoryChain(const std::string& dir)
+{
+  std::vector<std::string> chain;
+  if (not snapshotChain(dir, chain))
+    return false;
+
+  // Load the full snapshot at the end of the chain. Read used blocks
+  // directly: The syscall state is that of the last snapshot of the
+  // chain (see loadSnapshot).
+  FileSystem::path fullPath = chain.back();
+  std::vector<std::pair<uint64_t,uint64_t>> usedBlocks;
+  FileSystem::path usedBlocksPath = fullPath / "usedblocks";
+  std::ifstream ifs(usedBlocksPath.string());
+  if (not ifs)
+    {
+      std::cerr << "Hart::loadSnapshot failed - cannot open "
+                << usedBlocksPath << " for read\n";
+      return false;
+    }
+  uint64_t addr = 0, length = 0;
+  while (ifs >> addr >> length)
+    usedBlocks.push_back(std::pair<uint64_t,uint64_t>(addr, length));
+
+  FileSystem::path imagePath = fullPath / "memoryimage";
+  FileSystem::path memPath = fullPath / "memory";
+  bool ok = false;
+  if (FileSystem::is_regular_file(imagePath))
+    ok = memory_.loadSnapshotImage(imagePath.string(), usedBlocks);
+  else
+    ok = memory_.loadSnapshot(memPath.string(), usedBlocks);
+  if (not ok)
+    return false;
+
+  // Apply the pages of the incremental snapshots from oldest to newest.
+  for (size_t ix = chain.size() - 1; ix > 0; --ix)
+    {
+      FileSystem::path pagesPath = FileSystem::path(chain.at(ix - 1)) / "dirtypages";
+      if (not memory_.loadDirtyPages(pagesPath.string()))
+        return false;
+    }
+
+  return true;
+}
+
+
+template <typename URV>
+bool
+Hart<URV>::loadSnapshotMemory(const std::string& dir)
+{
+  if (not loadSnapshotMemoryChain(dir))
+    return false;
+
+  FileSystem::path cachePath = FileSystem::path(dir) / "cache";
+  if (FileSystem::is_regular_file(cachePath))
+    if (not memory_.loadCacheSnapshot(cachePath.string()))
+      return false;
+
+  memory_.clearDirtyPages();
+  lastSnapshotDir_ = dir;
   return true;
 }
 
@@ -56,6 +254,16 @@ Hart<URV>::saveSnapshot(const std::string& dir)
 template <typename URV>
 bool
 Hart<URV>::loadSnapshot(const std::string& dir)
+{
+  if (not loadSnapshotState(dir))
+    return false;
+  return loadSnapshotMemory(dir);
+}
+
+
+template <typename URV>
+bool
+Hart<URV>::loadSnapshotState(const std::string& dir)
 {
   FileSystem::path dirPath = dir;
   std::vector<std::pair<uint64_t,uint64_t>> usedBlocks;
@@ -72,19 +280,10 @@ Hart<URV>::loadSnapshot(const std::string& dir)
   if (not syscall_.loadMmap(mmapPath.string()))
     return false;
 
-  FileSystem::path memPath = dirPath / "memory";
-  if (not memory_.loadSnapshot(memPath.string(), usedBlocks))
-    return false;
-
   FileSystem::path fdPath = dirPath / "fd";
   if (not syscall_.loadFileDescriptors(fdPath.string()))
     return false;
 
-  FileSystem::path cachePath = dirPath / "cache";
-  if (FileSystem::is_regular_file(cachePath))
-    if (not memory_.loadCacheSnapshot(cachePath.string()))
-      return false;
-
   return true;
 }
 
@@ -106,6 +305,16 @@ Hart<URV>::saveSnapshotRegs(const std::string & filename)
   ofs << "pb 0x" << std::hex << syscall_.targetProgramBreak() << '\n';
   ofs << "pc 0x" << std::hex << peekPc() << "\n";
 
+  // Write privilege mode, timer alarm (clint mtimecmp), and LR
+  // reservation.
+  ofs << "pm " << std::dec << unsigned(privMode_) << "\n";
+  if (alarmLimit_ != ~uint64_t(0))
+    ofs << "al 0x" << std::hex << alarmLimit_ << "\n";
+  const auto& res = memory_.reservations_.at(hartIx_);
+  if (res.valid_)
+    ofs << "lr 0x" << std::hex << res.addr_ << " " << std::dec << res.size_
+        << " 0x" << std::hex << res.value_ << "\n";
+
   // write integer registers
   for(unsigned i = 1; i < 32; i++)
     ofs << "x " << std::dec << i << " 0x" << std::hex << peekIntReg(i) << "\n";
@@ -215,6 +424,26 @@ Hart<URV>::loadSnapshotRegs(const std::string & filename)
             break;
           setTargetProgramBreak(val);
         }
+      else if (type == "pm")  // Privilege mode
+        {
+          if (not loadSnapshotValue(iss, val) or val > unsigned(PrivilegeMode::Machine))
+            break;
+          privMode_ = PrivilegeMode(val);
+        }
+      else if (type == "al")  // Timer alarm
+        {
+          if (not loadSnapshotValue(iss, val))
+            break;
+          alarmLimit_ = val;
+        }
+      else if (type == "lr")  // LR reservation
+        {
+          uint64_t addr = 0, size = 0;
+          if (not loadSnapshotValue(iss, addr) or not loadSnapshotValue(iss, size) or
+              not loadSnapshotValue(iss, val))
+            break;
+          memory_.makeLr(hartIx_, addr, size, val);
+        }
       else if (type == "c")   // CSR
         {
           if (not loadRegNumAndValue(iss, num, val))
@@ -0,0 +1,71 @@
+// Copyright 2020 Western Digital Corporation or its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Convert a binary instruction trace produced by "whisper --logbinary"
+// to the text format of "whisper --logfile".
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include "InstTrace.hpp"
+
+using namespace WdRiscv;
+
+
+int
+main(int argc, char* argv[])
+{
+  if (argc < 2 or argc > 3 or strcmp(argv[1], "-h") == 0 or
+      strcmp(argv[1], "--help") == 0)
+    {
+      std::cerr << "Usage: " << argv[0] << " binary-trace-file [text-output-file]\n"
+                << "Convert a whisper binary trace (--logbinary) to the text trace\n"
+                << "format (--logfile). Output goes to standard output if no\n"
+                << "output file is given.\n";
+      return argc == 2? 0 : 1;
+    }
+
+  BinaryTraceReader reader;
+  if (not reader.open(argv[1]))
+    return 1;
+
+  FILE* out = stdout;
+  if (argc == 3)
+    {
+      out = fopen(argv[2], "w");
+      if (not out)
+        {
+          std::cerr << "Error: Failed to open " << argv[2] << " for output\n";
+          return 1;
+        }
+    }
+
+  InstTraceRecord rec;
+  std::string line;
+  while (reader.next(rec))
+    {
+      line.clear();
+      formatInstTraceRecord(rec, reader.xlen(), line);
+      fputs(line.c_str(), out);
+    }
+
+  bool ok = not reader.hasError();
+  if (not ok)
+    std::cerr << "Error: Corrupt or truncated binary trace " << argv[1] << '\n';
+
+  if (out != stdout)
+    fclose(out);
+  return ok? 0 : 1;
+}
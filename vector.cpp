@@ -483,6 +483,132 @@ Hart<URV>::execVsetvl(const DecodedInst* di)
 }
 
 
+/// Return true if the elements [start, elems) of the register groups
+/// at a and b partially overlap (overlap without being identical).
+template <typename T>
+static bool
+partialOverlap(const T* a, const T* b, unsigned start, unsigned elems)
+{
+  if (a == b)
+    return false;
+  return a + start < b + elems and b + start < a + elems;
+}
+
+
+/// Apply the given function to every run of consecutive active
+/// elements in [start, elems) (all elements are active if masked is
+/// false). The function is called with the first index and the end
+/// index of each run. The mask function returns the 64 mask bits of
+/// the elements starting at a given multiple of 64.
+template <typename MASK, typename RUN>
+static void
+forEachActiveRun(unsigned start, unsigned elems, bool masked, MASK mask,
+                 RUN run)
+{
+  if (not masked)
+    {
+      run(start, elems);
+      return;
+    }
+
+  for (unsigned base = start & ~63u; base < elems; base += 64)
+    {
+      uint64_t word = mask(base);
+      if (base < start)
+        word &= ~uint64_t(0) << (start - base);
+      if (elems - base < 64)
+        word &= (uint64_t(1) << (elems - base)) - 1;
+
+      while (word)
+        {
+          unsigned first = __builtin_ctzll(word);
+          uint64_t ones = ~word >> first;
+          unsigned count = ones ? __builtin_ctzll(ones) : 64 - first;
+          run(base + first, base + first + count);
+          if (first + count >= 64)
+            break;
+          word &= ~uint64_t(0) << (first + count);
+        }
+    }
+}
+
+
+template <typename URV>
+template <typename ELEM_TYPE, typename OP>
+bool
+Hart<URV>::vecBulkVv(unsigned vd, unsigned vs1, unsigned vs2, unsigned group,
+                     unsigned start, unsigned elems, bool masked, OP op)
+{
+  if constexpr (not std::is_integral<ELEM_TYPE>::value)
+    return false;
+  else
+    {
+      if (start >= elems or (masked and vd == 0))
+        return false;
+
+      ELEM_TYPE* dest = vecRegs_.groupData<ELEM_TYPE>(vd, elems, group);
+      const ELEM_TYPE* src1 = vecRegs_.groupData<ELEM_TYPE>(vs1, elems, group);
+      const ELEM_TYPE* src2 = vecRegs_.groupData<ELEM_TYPE>(vs2, elems, group);
+      if (not dest or not src1 or not src2)
+        return false;
+      if (partialOverlap<ELEM_TYPE>(dest, src1, start, elems) or
+          partialOverlap<ELEM_TYPE>(dest, src2, start, elems))
+        return false;
+
+      // Plain loops over contiguous runs: The compiler vectorizes these
+      // with the host SIMD instructions.
+      unsigned last = elems;
+      auto mask = [this] (unsigned base) { return vecRegs_.maskWord(0, base); };
+      forEachActiveRun(start, elems, masked, mask,
+                       [&] (unsigned begin, unsigned end) {
+                         for (unsigned ix = begin; ix < end; ++ix)
+                           dest[ix] = ELEM_TYPE(op(src1[ix], src2[ix]));
+                         last = end - 1;
+                       });
+
+      if (last < elems)
+        vecRegs_.setLastWrittenReg(vd, last, sizeof(ELEM_TYPE)*8);
+      return true;
+    }
+}
+
+
+template <typename URV>
+template <typename ELEM_TYPE, typename OP>
+bool
+Hart<URV>::vecBulkVx(unsigned vd, unsigned vs1, ELEM_TYPE e2, unsigned group,
+                     unsigned start, unsigned elems, bool masked, OP op)
+{
+  if constexpr (not std::is_integral<ELEM_TYPE>::value)
+    return false;
+  else
+    {
+      if (start >= elems or (masked and vd == 0))
+        return false;
+
+      ELEM_TYPE* dest = vecRegs_.groupData<ELEM_TYPE>(vd, elems, group);
+      const ELEM_TYPE* src1 = vecRegs_.groupData<ELEM_TYPE>(vs1, elems, group);
+      if (not dest or not src1)
+        return false;
+      if (partialOverlap<ELEM_TYPE>(dest, src1, start, elems))
+        return false;
+
+      unsigned last = elems;
+      auto mask = [this] (unsigned base) { return vecRegs_.maskWord(0, base); };
+      forEachActiveRun(start, elems, masked, mask,
+                       [&] (unsigned begin, unsigned end) {
+                         for (unsigned ix = begin; ix < end; ++ix)
+                           dest[ix] = ELEM_TYPE(op(src1[ix], e2));
+                         last = end - 1;
+                       });
+
+      if (last < elems)
+        vecRegs_.setLastWrittenReg(vd, last, sizeof(ELEM_TYPE)*8);
+      return true;
+    }
+}
+
+
 template <typename URV>
 template <typename ELEM_TYPE>
 void
@@ -492,6 +618,10 @@ Hart<URV>::vadd_vv(unsigned vd, unsigned vs1, unsigned vs2, unsigned group,
   unsigned errors = 0;
   ELEM_TYPE e1 = 0, e2 = 0, dest = 0;
 
+  if (vecBulkVv<ELEM_TYPE>(vd, vs1, vs2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return a + b; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -548,6 +678,10 @@ Hart<URV>::vadd_vx(unsigned vd, unsigned vs1, ELEM_TYPE e2, unsigned group,
   unsigned errors = 0;
   ELEM_TYPE e1 = 0, dest = 0;
 
+  if (vecBulkVx<ELEM_TYPE>(vd, vs1, e2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return a + b; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -635,6 +769,10 @@ Hart<URV>::vsub_vv(unsigned vd, unsigned vs1, unsigned vs2, unsigned group,
   unsigned errors = 0;
   ELEM_TYPE e1 = 0, e2 = 0, dest = 0;
 
+  if (vecBulkVv<ELEM_TYPE>(vd, vs1, vs2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return a - b; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -691,6 +829,10 @@ Hart<URV>::vsub_vx(unsigned vd, unsigned vs1, unsigned rs2, unsigned group,
   unsigned errors = 0;
   ELEM_TYPE e1 = 0, e2 = SRV(intRegs_.read(rs2)), dest = 0;
 
+  if (vecBulkVx<ELEM_TYPE>(vd, vs1, e2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return a - b; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -747,6 +889,10 @@ Hart<URV>::vrsub_vx(unsigned vd, unsigned vs1, unsigned rs2, unsigned group,
   unsigned errors = 0;
   ELEM_TYPE e1 = 0, e2 = SRV(intRegs_.read(rs2)), dest = 0;
 
+  if (vecBulkVx<ELEM_TYPE>(vd, vs1, e2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return b - a; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -1597,6 +1743,10 @@ Hart<URV>::vminu_vv(unsigned vd, unsigned vs1, unsigned vs2, unsigned group,
   unsigned errors = 0;
   ELEM_TYPE e1 = 0, e2 = 0, dest = 0;
 
+  if (vecBulkVv<ELEM_TYPE>(vd, vs1, vs2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return a < b ? a : b; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -1658,6 +1808,10 @@ Hart<URV>::vminu_vx(unsigned vd, unsigned vs1, unsigned rs2, unsigned group,
   ELEM_TYPE e2 = intRegs_.read(rs2);
   ELEM_TYPE e1 = 0, dest = 0;
 
+  if (vecBulkVx<ELEM_TYPE>(vd, vs1, e2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return a < b ? a : b; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -1715,6 +1869,10 @@ Hart<URV>::vmin_vv(unsigned vd, unsigned vs1, unsigned vs2, unsigned group,
   unsigned errors = 0;
   ELEM_TYPE e1 = 0, e2 = 0, dest = 0;
 
+  if (vecBulkVv<ELEM_TYPE>(vd, vs1, vs2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return a < b ? a : b; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -1772,6 +1930,10 @@ Hart<URV>::vmin_vx(unsigned vd, unsigned vs1, unsigned rs2, unsigned group,
   unsigned errors = 0;
   ELEM_TYPE e1 = 0, e2 = SRV(intRegs_.read(rs2)), dest = 0;
 
+  if (vecBulkVx<ELEM_TYPE>(vd, vs1, e2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return a < b ? a : b; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -1829,6 +1991,10 @@ Hart<URV>::vmaxu_vv(unsigned vd, unsigned vs1, unsigned vs2, unsigned group,
   unsigned errors = 0;
   ELEM_TYPE e1 = 0, e2 = 0, dest = 0;
 
+  if (vecBulkVv<ELEM_TYPE>(vd, vs1, vs2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return a > b ? a : b; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -1890,6 +2056,10 @@ Hart<URV>::vmaxu_vx(unsigned vd, unsigned vs1, unsigned rs2, unsigned group,
   ELEM_TYPE e2 = intRegs_.read(rs2);
   ELEM_TYPE e1 = 0, dest = 0;
 
+  if (vecBulkVx<ELEM_TYPE>(vd, vs1, e2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return a > b ? a : b; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -1947,6 +2117,10 @@ Hart<URV>::vmax_vv(unsigned vd, unsigned vs1, unsigned vs2, unsigned group,
   unsigned errors = 0;
   ELEM_TYPE e1 = 0, e2 = 0, dest = 0;
 
+  if (vecBulkVv<ELEM_TYPE>(vd, vs1, vs2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return a > b ? a : b; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -2004,6 +2178,10 @@ Hart<URV>::vmax_vx(unsigned vd, unsigned vs1, unsigned rs2, unsigned group,
   unsigned errors = 0;
   ELEM_TYPE e1 = 0, e2 = SRV(intRegs_.read(rs2)), dest = 0;
 
+  if (vecBulkVx<ELEM_TYPE>(vd, vs1, e2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return a > b ? a : b; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -2061,6 +2239,10 @@ Hart<URV>::vand_vv(unsigned vd, unsigned vs1, unsigned vs2, unsigned group,
   unsigned errors = 0;
   ELEM_TYPE e1 = 0, e2 = 0, dest = 0;
 
+  if (vecBulkVv<ELEM_TYPE>(vd, vs1, vs2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return a & b; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -2120,6 +2302,10 @@ Hart<URV>::vand_vx(unsigned vd, unsigned vs1, unsigned rs2, unsigned group,
   // Spec says sign extend scalar register. We comply. Looks foolish.
   ELEM_TYPE e1 = 0, e2 = SRV(intRegs_.read(rs2)), dest = 0;
 
+  if (vecBulkVx<ELEM_TYPE>(vd, vs1, e2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return a & b; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -2237,6 +2423,10 @@ Hart<URV>::vor_vv(unsigned vd, unsigned vs1, unsigned vs2, unsigned group,
   unsigned errors = 0;
   ELEM_TYPE e1 = 0, e2 = 0, dest = 0;
 
+  if (vecBulkVv<ELEM_TYPE>(vd, vs1, vs2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return a | b; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -2296,6 +2486,10 @@ Hart<URV>::vor_vx(unsigned vd, unsigned vs1, unsigned rs2, unsigned group,
   // Spec says sign extend scalar register. We comply. Looks foolish.
   ELEM_TYPE e1 = 0, e2 = SRV(intRegs_.read(rs2)), dest = 0;
 
+  if (vecBulkVx<ELEM_TYPE>(vd, vs1, e2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return a | b; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -2413,6 +2607,10 @@ Hart<URV>::vxor_vv(unsigned vd, unsigned vs1, unsigned vs2, unsigned group,
   unsigned errors = 0;
   ELEM_TYPE e1 = 0, e2 = 0, dest = 0;
 
+  if (vecBulkVv<ELEM_TYPE>(vd, vs1, vs2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return a ^ b; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -2472,6 +2670,10 @@ Hart<URV>::vxor_vx(unsigned vd, unsigned vs1, unsigned rs2, unsigned group,
   // Spec says sign extend scalar register. We comply. Looks foolish.
   ELEM_TYPE e1 = 0, e2 = SRV(intRegs_.read(rs2)), dest = 0;
 
+  if (vecBulkVx<ELEM_TYPE>(vd, vs1, e2, group, start, elems, masked,
+                           [] (ELEM_TYPE a, ELEM_TYPE b) { return a ^ b; }))
+    return;
+
   for (unsigned ix = start; ix < elems; ++ix)
     {
       if (masked and not vecRegs_.isActive(0, ix))
@@ -9399,62 +9601,129 @@ Hart<URV>::execVnclip_wi(const DecodedInst* di)
 }
 
 
+/// Return the number of elements of the given size, among the count
+/// elements at addr, addr+stride, addr+2*stride, ..., that fall
+/// entirely in the page of addr. Return zero if the first element
+/// crosses the end of the page.
+static unsigned
+elemsInPage(uint64_t addr, uint64_t stride, unsigned size, unsigned count,
+            uint64_t pageSize)
+{
+  uint64_t offset = addr & (pageSize - 1);
+  if (offset + size > pageSize)
+    return 0;
+  if (stride == 0)
+    return count;
+
+  int64_t signedStride = stride;
+  uint64_t room = signedStride > 0 ? pageSize - size - offset : offset;
+  uint64_t step = signedStride > 0 ? stride : -stride;
+  uint64_t n = room / step + 1;
+  return n < count ? n : count;
+}
+
+
 template <typename URV>
 template <typename ELEM_TYPE>
-void
-Hart<URV>::vectorLoad(const DecodedInst* di, ElementWidth eew, bool faultFirst)
-{
-  // Compute emul: lmul*eew/sew
-  unsigned groupX8 = vecRegs_.groupMultiplierX8();
-  groupX8 = groupX8 * vecRegs_.elementWidthInBits(eew) / vecRegs_.elementWidthInBits();
-  GroupMultiplier lmul = GroupMultiplier::One;
-  bool badConfig = false;
-  if (not vecRegs_.groupNumberX8ToSymbol(groupX8, lmul))
-    badConfig = true;
+unsigned
+Hart<URV>::vectorLoadPage(unsigned vd, unsigned rs1, unsigned groupX8,
+                          unsigned ix, unsigned elemCount, uint64_t stride)
+{
+  // Wide elements are checked as double words like in the per-element
+  // path.
+  unsigned size = sizeof(ELEM_TYPE);
+  unsigned align = size > 8 ? 8 : size;
+  URV base = intRegs_.read(rs1);
+  uint64_t addr = base + ix*stride;
+  if ((addr & (align - 1)) or (stride & (align - 1)))
+    return 0;
+
+  unsigned count = elemsInPage(addr, stride, size, elemCount - ix,
+                               hostTlb_.pageSize());
+  auto data = reinterpret_cast<uint8_t*>(vecRegs_.groupData<ELEM_TYPE>(vd, elemCount, groupX8));
+  if (count == 0 or not data)
+    return 0;
+  data += ix*size;
+
+  // Translation and permissions are uniform within the page.
+  auto secCause = SecondaryCause::NONE;
+  uint64_t pa = addr;
+  if (determineLoadException(rs1, base, pa, align, secCause) != ExceptionCause::NONE)
+    return 0;
+  const uint8_t* host = directHostAddr(pa, false);
+  if (not host)
+    return 0;
+
+  if (stride == size)
+    memcpy(data, host, count*size);
   else
-    badConfig = not vecRegs_.legalConfig(eew, lmul);
+    for (unsigned i = 0; i < count; ++i)
+      memcpy(data + i*size, host + int64_t(i*stride), size);
 
-  if (not isVecLegal() or badConfig)
-    {
-      illegalInst(di);
-      return;
-    }
+  vecRegs_.setLastWrittenReg(vd, ix + count - 1, size*8);
+  return count;
+}
 
-  bool masked = di->isMasked();
-  unsigned vd = di->op0(), rs1 = di->op1(), errors = 0;
-  uint64_t addr = intRegs_.read(rs1);
 
+template <typename URV>
+template <typename ELEM_TYPE>
+void
+Hart<URV>::vectorLoadElems(unsigned vd, unsigned rs1, unsigned groupX8,
+                           uint64_t stride, bool masked, bool faultFirst)
+{
+  URV base = intRegs_.read(rs1);
   unsigned start = vecRegs_.startIndex();
   unsigned elemCount = vecRegs_.elemCount();
+  unsigned errors = 0;
+
+  // Masked and fault-only-first loads go element by element.
+  bool bulk = not masked and not faultFirst and useHostTlb();
 
-  // FIX TODO: check permissions, translate, ....
   for (unsigned ix = start; ix < elemCount; ++ix)
     {
+      if (bulk)
+        {
+          unsigned count = vectorLoadPage<ELEM_TYPE>(vd, rs1, groupX8, ix,
+                                                     elemCount, stride);
+          if (count)
+            {
+              ix += count - 1;
+              continue;
+            }
+        }
+
       if (masked and not vecRegs_.isActive(0, ix))
         continue;
 
+      uint64_t addr = base + ix*stride;
       auto cause = ExceptionCause::NONE;
       auto secCause = SecondaryCause::NONE;
 
       ELEM_TYPE elem = 0;
       if constexpr (sizeof(elem) > 8)
         {
+          uint64_t dwords[sizeof(elem) / 8];
           for (unsigned n = 0; n < sizeof(elem); n += 8)
             {
-              uint64_t dword = 0;
-              cause = determineLoadException(rs1, addr, addr, 8, secCause);
+              uint64_t pa = addr + n;
+              cause = determineLoadException(rs1, base, pa, 8, secCause);
               if (cause != ExceptionCause::NONE)
-                break;
-              memory_.read(addr + n, dword);
-              elem <<= 64;
-              elem |= dword;
+                {
+                  addr += n;
+                  break;
+                }
+              dwords[n/8] = 0;
+              memory_.read(pa, dwords[n/8]);
             }
+          if (cause == ExceptionCause::NONE)
+            memcpy(static_cast<void*>(&elem), dwords, sizeof(elem));
         }
       else
         {
-          if (determineLoadException(rs1, addr, addr, sizeof(elem), secCause) !=
-              ExceptionCause::NONE)
-            memory_.read(addr, elem);
+          uint64_t pa = addr;
+          cause = determineLoadException(rs1, base, pa, sizeof(elem), secCause);
+          if (cause == ExceptionCause::NONE)
+            memory_.read(pa, elem);
         }
 
       if (cause != ExceptionCause::NONE)
@@ -9471,14 +9740,205 @@ Hart<URV>::vectorLoad(const DecodedInst* di, ElementWidth eew, bool faultFirst)
           errors++;
           break;
         }
+    }
 
-      addr += sizeof(ELEM_TYPE);
+  assert(errors == 0);
+}
+
+
+template <typename URV>
+template <typename ELEM_TYPE>
+unsigned
+Hart<URV>::vectorStorePage(unsigned vs3, unsigned rs1, unsigned groupX8,
+                           unsigned ix, unsigned elemCount, uint64_t stride)
+{
+  unsigned size = sizeof(ELEM_TYPE);
+  unsigned align = size > 8 ? 8 : size;
+  URV base = intRegs_.read(rs1);
+  uint64_t addr = base + ix*stride;
+  if ((addr & (align - 1)) or (stride & (align - 1)))
+    return 0;
+
+  unsigned count = elemsInPage(addr, stride, size, elemCount - ix,
+                               hostTlb_.pageSize());
+  const ELEM_TYPE* elems = vecRegs_.groupData<ELEM_TYPE>(vs3, elemCount, groupX8);
+  if (count == 0 or not elems)
+    return 0;
+  auto data = reinterpret_cast<const uint8_t*>(elems + ix);
+
+  // Translation and permissions are uniform within the page. The
+  // value passed for the check matters only for memory-mapped
+  // registers which are excluded by directHostAddr.
+  auto secCause = SecondaryCause::NONE;
+  uint64_t pa = addr;
+  bool forced = false;
+  ExceptionCause cause = ExceptionCause::NONE;
+  if constexpr (sizeof(ELEM_TYPE) > 8)
+    {
+      uint64_t dword = 0;
+      cause = determineStoreException(rs1, base, pa, dword, secCause, forced);
+    }
+  else
+    {
+      ELEM_TYPE elem = elems[ix];
+      cause = determineStoreException(rs1, base, pa, elem, secCause, forced);
+    }
+  if (cause != ExceptionCause::NONE)
+    return 0;
+  uint8_t* host = directHostAddr(pa, true);
+  if (not host)
+    return 0;
+
+  // Record the last written (double) word as the last write like the
+  // per-element path does.
+  typedef typename std::conditional<(sizeof(ELEM_TYPE) > 8), uint64_t, ELEM_TYPE>::type LastType;
+  int64_t lastOffset = int64_t((count - 1)*stride) + size - sizeof(LastType);
+  LastType prev = 0, value = 0;
+  memcpy(&prev, host + lastOffset, sizeof(prev));
+
+  if (stride == size)
+    memory_.copyDirect(pa, host, data, count*size);
+  else
+    for (unsigned i = 0; i < count; ++i)
+      memory_.copyDirect(pa, host + int64_t(i*stride), data + i*size, size);
+
+  memcpy(&value, host + lastOffset, sizeof(value));
+  memory_.recordWrite(hartIx_, pa + lastOffset, prev, value);
+
+  // Bytes spanned by the stored elements.
+  uint64_t span = (count - 1)*stride;
+  int64_t signedStride = stride;
+  if (signedStride < 0)
+    span = -span;
+  uint64_t low = signedStride < 0 ? addr - span : addr;
+  uint64_t lowPa = signedStride < 0 ? pa - span : pa;
+  span += size;
+
+  memory_.invalidateOtherHartLr(hartIx_, lowPa, span);
+  invalidateDecodeCache(low, span);
+  virtMem_.noteStore(pa);
+  return count;
+}
+
+
+template <typename URV>
+template <typename ELEM_TYPE>
+void
+Hart<URV>::vectorStoreElems(unsigned vs3, unsigned rs1, unsigned groupX8,
+                            uint64_t stride, bool masked)
+{
+  URV base = intRegs_.read(rs1);
+  unsigned start = vecRegs_.startIndex();
+  unsigned elemCount = vecRegs_.elemCount();
+  unsigned errors = 0;
+
+  // Masked stores go element by element.
+  bool bulk = not masked and useHostTlb();
+
+  for (unsigned ix = start; ix < elemCount; ++ix)
+    {
+      if (bulk)
+        {
+          unsigned count = vectorStorePage<ELEM_TYPE>(vs3, rs1, groupX8, ix,
+                                                      elemCount, stride);
+          if (count)
+            {
+              ix += count - 1;
+              continue;
+            }
+        }
+
+      if (masked and not vecRegs_.isActive(0, ix))
+        continue;
+
+      ELEM_TYPE elem = 0;
+      if (not vecRegs_.read(vs3, ix, groupX8, elem))
+        {
+          errors++;
+          break;
+        }
+
+      uint64_t addr = base + ix*stride;
+      auto cause = ExceptionCause::NONE;
+      auto secCause = SecondaryCause::NONE;
+
+      if constexpr (sizeof(elem) > 8)
+        {
+          uint64_t dwords[sizeof(elem) / 8];
+          memcpy(dwords, static_cast<const void*>(&elem), sizeof(elem));
+          for (unsigned n = 0; n < sizeof(elem); n += 8)
+            {
+              uint64_t pa = addr + n;
+              bool forced = false;
+              cause = determineStoreException(rs1, base, pa, dwords[n/8],
+                                              secCause, forced);
+              if (cause != ExceptionCause::NONE)
+                {
+                  addr += n;
+                  break;
+                }
+              if (memory_.write(hartIx_, pa, dwords[n/8]))
+                {
+                  memory_.invalidateOtherHartLr(hartIx_, pa, 8);
+                  invalidateDecodeCache(addr + n, 8);
+                  virtMem_.noteStore(pa);
+                }
+            }
+        }
+      else
+        {
+          uint64_t pa = addr;
+          bool forced = false;
+          cause = determineStoreException(rs1, base, pa, elem, secCause, forced);
+          if (cause == ExceptionCause::NONE and memory_.write(hartIx_, pa, elem))
+            {
+              memory_.invalidateOtherHartLr(hartIx_, pa, sizeof(elem));
+              invalidateDecodeCache(addr, sizeof(elem));
+              virtMem_.noteStore(pa);
+            }
+        }
+
+      if (cause != ExceptionCause::NONE)
+        {
+          vecRegs_.setStartIndex(ix);
+          csRegs_.write(CsrNumber::VSTART, PrivilegeMode::Machine, ix);
+          initiateStoreException(cause, addr, secCause);
+          break;
+        }
     }
 
   assert(errors == 0);
 }
 
 
+template <typename URV>
+template <typename ELEM_TYPE>
+void
+Hart<URV>::vectorLoad(const DecodedInst* di, ElementWidth eew, bool faultFirst)
+{
+  // Compute emul: lmul*eew/sew
+  unsigned groupX8 = vecRegs_.groupMultiplierX8();
+  groupX8 = groupX8 * vecRegs_.elementWidthInBits(eew) / vecRegs_.elementWidthInBits();
+  GroupMultiplier lmul = GroupMultiplier::One;
+  bool badConfig = false;
+  if (not vecRegs_.groupNumberX8ToSymbol(groupX8, lmul))
+    badConfig = true;
+  else
+    badConfig = not vecRegs_.legalConfig(eew, lmul);
+
+  if (not isVecLegal() or badConfig)
+    {
+      illegalInst(di);
+      return;
+    }
+
+  bool masked = di->isMasked();
+  unsigned vd = di->op0(), rs1 = di->op1();
+  vectorLoadElems<ELEM_TYPE>(vd, rs1, groupX8, sizeof(ELEM_TYPE), masked,
+                             faultFirst);
+}
+
+
 template <typename URV>
 void
 Hart<URV>::execVle8_v(const DecodedInst* di)
@@ -9565,61 +10025,8 @@ Hart<URV>::vectorStore(const DecodedInst* di, ElementWidth eew)
     }
 
   bool masked = di->isMasked();
-  uint32_t vd = di->op0(), rs1 = di->op1(), errors = 0;
-  uint64_t addr = intRegs_.read(rs1);
-
-  unsigned start = vecRegs_.startIndex();
-  unsigned elemCount = vecRegs_.elemCount();
-
-  // TODO check permissions, translate, ....
-  for (unsigned ix = start; ix < elemCount; ++ix)
-    {
-      if (masked and not vecRegs_.isActive(0, ix))
-        continue;
-      ELEM_TYPE elem = 0;
-      if (not vecRegs_.read(vd, ix, groupX8, elem))
-        {
-          errors++;
-          break;
-        }
-
-      auto cause = ExceptionCause::NONE;
-      auto secCause = SecondaryCause::NONE;
-
-      if constexpr (sizeof(elem) > 8)
-        {
-          for (unsigned n = 0; n < sizeof(elem); n += 8)
-            {
-              uint64_t dword = uint64_t(elem);
-              bool forced = false;
-              cause = determineStoreException(rs1, URV(addr), addr, dword, secCause, forced);
-              if (cause != ExceptionCause::NONE)
-                break;
-
-              memory_.write(hartIx_, addr + n, dword);
-              elem >>= 64;
-            }
-        }
-      else
-        {
-          bool forced = false;
-          if (determineStoreException(rs1, URV(addr), addr, elem, secCause, forced) !=
-              ExceptionCause::NONE)
-            memory_.write(hartIx_, addr, elem);
-        }
-
-      if (cause != ExceptionCause::NONE)
-        {
-          vecRegs_.setStartIndex(ix);
-          csRegs_.write(CsrNumber::VSTART, PrivilegeMode::Machine, ix);
-          initiateStoreException(cause, addr, secCause);
-          break;
-        }
-
-      addr += sizeof(ELEM_TYPE);
-    }
-
-  assert(errors == 0);
+  uint32_t vs3 = di->op0(), rs1 = di->op1();
+  vectorStoreElems<ELEM_TYPE>(vs3, rs1, groupX8, sizeof(ELEM_TYPE), masked);
 }
 
 
@@ -9855,12 +10262,13 @@ Hart<URV>::vectorStoreWholeReg(const DecodedInst* di, ElementWidth eew)
           for (unsigned n = 0; n < sizeof(elem) and not exception; n += 8)
             {
               uint64_t dword = uint64_t(elem);
-              memory_.write(hartIx_, addr + n, dword);
+              if (memory_.write(hartIx_, addr + n, dword))
+                virtMem_.noteStore(addr + n);
               elem >>= 64;
             }
         }
-      else
-        memory_.write(hartIx_, addr, elem);
+      else if (memory_.write(hartIx_, addr, elem))
+        virtMem_.noteStore(addr);
 
       if (exception)
         {
@@ -10026,61 +10434,9 @@ Hart<URV>::vectorLoadStrided(const DecodedInst* di, ElementWidth eew)
     }
 
   bool masked = di->isMasked();
-  unsigned vd = di->op0(), rs1 = di->op1(), rs2 = di->op2(), errors = 0;
-  uint64_t addr = intRegs_.read(rs1);
+  unsigned vd = di->op0(), rs1 = di->op1(), rs2 = di->op2();
   uint64_t stride = intRegs_.read(rs2);
-
-  unsigned start = vecRegs_.startIndex();
-  unsigned elemCount = vecRegs_.elemCount();
-
-  // TODO check permissions, translate, ....
-  for (unsigned ix = start; ix < elemCount; ++ix)
-    {
-      if (masked and not vecRegs_.isActive(0, ix))
-        continue;
-
-      auto cause = ExceptionCause::NONE;
-      auto secCause = SecondaryCause::NONE;
-
-      ELEM_TYPE elem = 0;
-      if constexpr (sizeof(elem) > 8)
-        {
-          for (unsigned n = 0; n < sizeof(elem); n += 8)
-            {
-              uint64_t dword = 0;
-              cause = determineLoadException(rs1, addr, addr, 8, secCause);
-              if (cause != ExceptionCause::NONE)
-                break;
-              memory_.read(addr + n, dword);
-              elem <<= 64;
-              elem |= dword;
-            }
-        }
-      else
-        {
-          if (determineLoadException(rs1, addr, addr, sizeof(elem), secCause) !=
-              ExceptionCause::NONE)
-            memory_.read(addr, elem);
-        }
-
-      if (cause != ExceptionCause::NONE)
-        {
-          vecRegs_.setStartIndex(ix);
-          csRegs_.write(CsrNumber::VSTART, PrivilegeMode::Machine, ix);
-          initiateLoadException(cause, addr, secCause);
-          break;
-        }
-
-      if (not vecRegs_.write(vd, ix, groupX8, elem))
-        {
-          errors++;
-          break;
-        }
-
-      addr += stride;
-    }
-
-  assert(errors == 0);
+  vectorLoadElems<ELEM_TYPE>(vd, rs1, groupX8, stride, masked, false);
 }
 
 
@@ -10170,49 +10526,9 @@ Hart<URV>::vectorStoreStrided(const DecodedInst* di, ElementWidth eew)
     }
 
   bool masked = di->isMasked();
-  unsigned vd = di->op0(), rs1 = di->op1(), rs2 = di->op2(), errors = 0;
-  uint64_t addr = intRegs_.read(rs1);
+  unsigned vs3 = di->op0(), rs1 = di->op1(), rs2 = di->op2();
   uint64_t stride = intRegs_.read(rs2);
-
-  unsigned start = vecRegs_.startIndex();
-  unsigned elemCount = vecRegs_.elemCount();
-
-  // TODO check permissions, translate, ....
-  for (unsigned ix = start; ix < elemCount; ++ix)
-    {
-      if (masked and not vecRegs_.isActive(0, ix))
-        continue;
-      bool exception = false;
-      ELEM_TYPE elem = 0;
-      if (not vecRegs_.read(vd, ix, groupX8, elem))
-        {
-          errors++;
-          break;
-        }
-
-      if constexpr (sizeof(elem) > 8)
-        {
-          for (unsigned n = 0; n < sizeof(elem) and not exception; n += 8)
-            {
-              uint64_t dword = uint64_t(elem);
-              memory_.write(hartIx_, addr + n, dword);
-              elem >>= 64;
-            }
-        }
-      else
-        memory_.write(hartIx_, addr, elem);
-
-      if (exception)
-        {
-          vecRegs_.setStartIndex(ix);
-          csRegs_.write(CsrNumber::VSTART, PrivilegeMode::Machine, ix);
-          break;
-        }
-
-      addr += stride;
-    }
-
-  assert(errors == 0);
+  vectorStoreElems<ELEM_TYPE>(vs3, rs1, groupX8, stride, masked);
 }
 
 
@@ -10298,7 +10614,7 @@ Hart<URV>::vectorLoadIndexed(const DecodedInst* di, ElementWidth offsetEew)
   uint32_t offsetGroupX8 = (offsetElemWidth*groupX8)/elemWidth;
 
   GroupMultiplier offsetGroup{GroupMultiplier::One};
-  bool badConfig = vecRegs_.groupNumberX8ToSymbol(offsetGroupX8, offsetGroup);
+  bool badConfig = not vecRegs_.groupNumberX8ToSymbol(offsetGroupX8, offsetGroup);
   if (not badConfig)
     badConfig = not vecRegs_.legalConfig(offsetEew, offsetGroup);
   if (badConfig)
@@ -10335,22 +10651,25 @@ Hart<URV>::vectorLoadIndexed(const DecodedInst* di, ElementWidth offsetEew)
 
       if constexpr (sizeof(elem) > 8)
         {
+          uint64_t dwords[sizeof(elem) / 8];
           for (unsigned n = 0; n < sizeof(elem); n += 8)
             {
-              uint64_t dword = 0;
-              cause = determineLoadException(rs1, eaddr, addr, 8, secCause);
+              uint64_t pa = eaddr + n;
+              cause = determineLoadException(rs1, eaddr + n, pa, 8, secCause);
               if (cause != ExceptionCause::NONE)
                 break;
-              memory_.read(eaddr + n, dword);
-              elem <<= 64;
-              elem |= dword;
+              dwords[n/8] = 0;
+              memory_.read(pa, dwords[n/8]);
             }
+          if (cause == ExceptionCause::NONE)
+            memcpy(static_cast<void*>(&elem), dwords, sizeof(elem));
         }
       else
         {
-          if (determineLoadException(rs1, eaddr, eaddr, sizeof(elem), secCause) !=
-              ExceptionCause::NONE)
-            memory_.read(eaddr, elem);
+          uint64_t pa = eaddr;
+          cause = determineLoadException(rs1, eaddr, pa, sizeof(elem), secCause);
+          if (cause == ExceptionCause::NONE)
+            memory_.read(pa, elem);
         }
 
       if (cause != ExceptionCause::NONE)
@@ -10422,7 +10741,7 @@ Hart<URV>::vectorStoreIndexed(const DecodedInst* di, ElementWidth offsetEew)
   uint32_t offsetGroupX8 = (offsetElemWidth*groupX8)/elemWidth;
 
   GroupMultiplier offsetGroup{GroupMultiplier::One};
-  bool badConfig = vecRegs_.groupNumberX8ToSymbol(offsetGroupX8, offsetGroup);
+  bool badConfig = not vecRegs_.groupNumberX8ToSymbol(offsetGroupX8, offsetGroup);
   if (not badConfig)
     badConfig = not vecRegs_.legalConfig(offsetEew, offsetGroup);
   if (badConfig)
@@ -10466,22 +10785,25 @@ Hart<URV>::vectorStoreIndexed(const DecodedInst* di, ElementWidth offsetEew)
           for (unsigned n = 0; n < sizeof(elem); n += 8)
             {
               uint64_t dword = elem;
+              uint64_t pa = eaddr + n;
               bool forced = false;
-              cause = determineStoreException(rs1, URV(eaddr), eaddr, dword, secCause,
+              cause = determineStoreException(rs1, URV(eaddr + n), pa, dword, secCause,
                                               forced);
               if (cause != ExceptionCause::NONE)
                 break;
 
-              memory_.write(hartIx_, eaddr + n, dword);
+              if (memory_.write(hartIx_, pa, dword))
+                virtMem_.noteStore(pa);
               elem >>= 64;
             }
         }
       else
         {
+          uint64_t pa = eaddr;
           bool forced = false;
-          if (determineStoreException(rs1, URV(eaddr), eaddr, elem, secCause, forced) !=
-              ExceptionCause::NONE)
-            memory_.write(hartIx_, eaddr, elem);
+          cause = determineStoreException(rs1, URV(eaddr), pa, elem, secCause, forced);
+          if (cause == ExceptionCause::NONE and memory_.write(hartIx_, pa, elem))
+            virtMem_.noteStore(pa);
         }
 
       if (cause != ExceptionCause::NONE)
@@ -17,6 +17,8 @@
 #include <sstream>
 #include <thread>
 #include <atomic>
+#include <algorithm>
+#include <sys/time.h>
 #if defined(__cpp_lib_filesystem)
   #include <filesystem>
   namespace FileSystem = std::filesystem;
@@ -49,6 +51,8 @@ typedef int socklen_t;
 #include "System.hpp"
 #include "Server.hpp"
 #include "Interactive.hpp"
+#include "TraceBuffer.hpp"
+#include "InstTrace.hpp"
 
 
 using namespace WdRiscv;
@@ -170,6 +174,9 @@ struct Args
   std::string consoleOutFile;  // Console io output file.
   std::string serverFile;      // File in which to write server host and port.
   std::string instFreqFile;    // Instruction frequency file.
+  std::string pcProfileFile;   // PC/function profile file.
+  std::string bbvFile;         // Basic block vector (SimPoint) file.
+  std::string simpointsFile;   // Selected SimPoint intervals.
   std::string configFile;      // Configuration (JSON) file.
   std::string isa;
   std::string snapshotDir = "snapshot"; // Dir prefix for saving snapshots
@@ -196,9 +203,11 @@ struct Args
   std::optional<uint64_t> instCountLim;
   std::optional<uint64_t> memorySize;
   std::optional<uint64_t> snapshotPeriod;
+  std::optional<uint64_t> bbvInterval;  // Instructions per basic block vector.
   std::optional<uint64_t> alarmInterval;
   std::optional<uint64_t> swInterrupt;  // Sotware interrupt mem mapped address
   std::optional<uint64_t> clint;  // Clint mem mapped address
+  std::optional<uint64_t> quantum;  // Instructions per hart per scheduling quantum
 
   unsigned regWidth = 32;
   unsigned harts = 1;
@@ -228,6 +237,13 @@ struct Args
   bool iccmRw = false;
   bool quitOnAnyHart = false;    // True if run quits when any hart finishes.
   bool noConInput = false;       // If true console io address is not used for input (ld).
+  bool jit = false;              // Translate hot integer code to host code if true.
+  bool traceBuffer = false;      // Buffer trace per hart, write in background if true.
+  bool logBinary = false;        // Write trace in compressed binary format if true.
+  bool profileBlocks = false;    // Profile per sequential run instead of per PC.
+  bool incrementalSnapshots = false; // Save only modified pages in snapshots.
+  bool snapshotImage = false;    // Save snapshot memory uncompressed.
+  bool hugePages = false;        // Back memory/decode caches with huge pages if true.
 
   // Expand each target program string into program name and args.
   void expandTargets();
@@ -318,6 +334,18 @@ collectCommandLineValues(const boost::program_options::variables_map& varMap,
         std::cerr << "Warning: Zero snapshot period ignored.\n";
     }
 
+  if (varMap.count("bbvinterval"))
+    {
+      auto numStr = varMap["bbvinterval"].as<std::string>();
+      if (not parseCmdLineNumber("bbvinterval", numStr, args.bbvInterval))
+        ok = false;
+      else if (*args.bbvInterval == 0)
+        {
+          std::cerr << "Error: Zero basic block vector interval.\n";
+          ok = false;
+        }
+    }
+
   if (varMap.count("tohostsym"))
     args.toHostSym = varMap["tohostsym"].as<std::string>();
 
@@ -342,6 +370,21 @@ collectCommandLineValues(const boost::program_options::variables_map& varMap,
         std::cerr << "Warning: Zero alarm period ignored.\n";
     }
 
+  if (varMap.count("quantum"))
+    {
+      auto numStr = varMap["quantum"].as<std::string>();
+      if (not parseCmdLineNumber("quantum", numStr, args.quantum))
+        ok = false;
+      else if (*args.quantum == 0)
+        std::cerr << "Warning: Zero quantum ignored.\n";
+    }
+
+  if (args.traceBuffer and args.logBinary)
+    {
+      std::cerr << "Error: Options --tracebuffer and --logbinary cannot be used together\n";
+      ok = false;
+    }
+
   if (varMap.count("clint"))
     {
       auto numStr = varMap["clint"].as<std::string>();
@@ -442,7 +485,9 @@ parseCmdLineArgs(int argc, char* argv[], Args& args)
 	("maxinst,m", po::value<std::string>(),
 	 "Limit executed instruction count to arg.")
 	("memorysize", po::value<std::string>(),
-	 "Memory size (must be a multiple of 4096).")
+	 "Memory size (must be a multiple of 4096). Sizes above 64 GB (up to "
+         "2^63) are backed sparsely: host memory is used only for the pages "
+         "touched.")
 	("interactive,i", po::bool_switch(&args.interactive),
 	 "Enable interactive mode.")
 	("traceload", po::bool_switch(&args.traceLdSt),
@@ -459,6 +504,14 @@ parseCmdLineArgs(int argc, char* argv[], Args& args)
 			" gdb will work with stdio (default -1).")
 	("profileinst", po::value(&args.instFreqFile),
 	 "Report instruction frequency to file.")
+        ("profilepc", po::value(&args.pcProfileFile),
+         "Report retired instruction counts per function (using the symbols "
+         "of the ELF files) and per address to the given file. Also write "
+         "the call stack profile in folded-stack format (for flame graph "
+         "tools) to the same file name with a .folded suffix.")
+        ("profileblocks", po::bool_switch(&args.profileBlocks),
+         "With --profilepc, count per run of sequentially executed "
+         "instructions instead of per instruction address (lower overhead).")
 	("setreg", po::value(&args.regInits)->multitoken(),
 	 "Initialize registers. Apply to all harts unless specific prefix "
 	 "present (hart is 1 in 1:x3=0xabc). Example: --setreg x1=4 x2=0xff "
@@ -469,6 +522,28 @@ parseCmdLineArgs(int argc, char* argv[], Args& args)
 	 "Directory prefix for saving snapshots.")
 	("snapshotperiod", po::value<std::string>(),
 	 "Snapshot period: Save snapshot using snapshotdir every so many instructions.")
+        ("bbvfile", po::value(&args.bbvFile),
+         "Collect basic block vectors (SimPoint .bb format) writing one line "
+         "per interval (see --bbvinterval) to the given file. In a multi-hart "
+         "run, hart n writes to the file with a .n suffix.")
+        ("bbvinterval", po::value<std::string>(),
+         "Number of instructions per basic block vector and per SimPoint "
+         "interval (default 100000000).")
+        ("simpoints", po::value(&args.simpointsFile),
+         "SimPoint file (lines of interval index and cluster id). Save a "
+         "snapshot using snapshotdir at the start of each listed interval "
+         "(see --bbvinterval) in a single run stopping after the last one. "
+         "The snapshot of interval k goes to directory <snapshotdir>k.")
+        ("snapshotincremental", po::bool_switch(&args.incrementalSnapshots),
+         "Track modified memory pages and save in each snapshot after the "
+         "first (or after the one loaded with --loadfrom) only the pages "
+         "modified since the previous snapshot plus a manifest referring to "
+         "it. Loading such a snapshot requires the previous ones.")
+        ("snapshotimage", po::bool_switch(&args.snapshotImage),
+         "Save the memory of snapshots as an uncompressed page-aligned image "
+         "instead of a compressed file. Such an image is mapped "
+         "(copy-on-write) rather than decompressed when restored with "
+         "--loadfrom making restore near-instant.")
 	("loadfrom", po::value(&args.loadFrom),
 	 "Snapshot directory from which to restore a previously saved (snapshot) state.")
 	("stdout", po::value(&args.stdoutFile),
@@ -526,9 +601,31 @@ parseCmdLineArgs(int argc, char* argv[], Args& args)
         ("quitany", po::bool_switch(&args.quitOnAnyHart),
          "Terminate multi-threaded run when any hart finishes (default is to wait "
          "for all harts.)")
+        ("quantum", po::value<std::string>(),
+         "Run the harts of a multi-hart system in a deterministic round-robin "
+         "order each executing arg instructions per turn (quantum) instead "
+         "of running each hart freely in its own thread. Runs with the same "
+         "inputs produce the same interleaving of the harts.")
         ("noconinput", po::bool_switch(&args.noConInput),
          "Do not use console IO address for input. Loads from the cosole io address "
          "simply return last value stored there.")
+        ("hugepages", po::bool_switch(&args.hugePages),
+         "Back simulated memory and decoded instruction caches with huge "
+         "host pages if available.")
+        ("tracebuffer", po::bool_switch(&args.traceBuffer),
+         "Buffer the instruction trace of each hart in memory and write it to "
+         "the log file from a background thread, merging the records of the "
+         "harts in order of instruction count then hart index. Avoids "
+         "serializing the harts of a multi-hart run on the log file. Cannot be "
+         "used with --logbinary.")
+        ("logbinary", po::bool_switch(&args.logBinary),
+         "Write the instruction trace (see --logfile) in a compact compressed "
+         "binary format instead of text. Use the tracedump program to convert "
+         "it to text.")
+        ("jit", po::bool_switch(&args.jit),
+         "Translate hot straight-line integer code to host (x86-64) code. "
+         "Applies only to runs using the fast execution loop: no tracing, "
+         "triggers, counters, clint, supervisor mode or stop address.")
 	("verbose,v", po::bool_switch(&args.verbose),
 	 "Be verbose.")
 	("version", po::bool_switch(&args.version),
@@ -885,7 +982,9 @@ loadSnapshot(Hart<URV>& hart, const std::string& snapDir)
     }
 
   FileSystem::path memPath = path / "memory";
-  if (not FileSystem::is_regular_file(regPath))
+  if (not FileSystem::is_regular_file(memPath) and
+      not FileSystem::is_regular_file(path / "memoryimage") and
+      not FileSystem::is_regular_file(path / "manifest"))
     {
       cerr << "Error: Snapshot file does not exists: " << memPath << '\n';
       return false;
@@ -1051,7 +1150,18 @@ applyCmdLineArgs(const Args& args, Hart<URV>& hart, System<URV>& system)
   if (not args.instFreqFile.empty())
     hart.enableInstructionFrequency(true);
 
-  if (not args.loadFrom.empty())
+  if (not args.pcProfileFile.empty())
+    hart.enablePcProfile(true, args.profileBlocks);
+
+  if (args.incrementalSnapshots)
+    hart.enableIncrementalSnapshots(true);
+
+  if (args.snapshotImage)
+    hart.enableSnapshotImage(true);
+
+  // System (multi-hart) snapshots are loaded once all harts are
+  // configured (see sessionRun).
+  if (not args.loadFrom.empty() and not System<URV>::isSystemSnapshot(args.loadFrom))
     if (not loadSnapshot(hart, args.loadFrom))
       errors++;
 
@@ -1125,6 +1235,11 @@ applyCmdLineArgs(const Args& args, Hart<URV>& hart, System<URV>& system)
   if (args.fastExt)
     hart.enableFastInterrupts(args.fastExt);
 
+  if (args.jit)
+    if (not hart.enableJit(true))
+      std::cerr << "Warning: Code translation (--jit) not supported on this "
+                << "host -- ignored\n";
+
   // Apply register initialization.
   if (not applyCmdLineRegInit(args, hart))
     errors++;
@@ -1281,6 +1396,49 @@ reportInstructionFrequency(Hart<URV>& hart, const std::string& outPath)
 }
 
 
+/// Write the PC profile of each hart of the given system to the
+/// given file and the folded call stacks to the same file with a
+/// .folded suffix. Return true on success.
+template <typename URV>
+static
+bool
+reportPcProfile(System<URV>& system, const std::string& outPath)
+{
+  std::string foldedPath = outPath + ".folded";
+  FILE* outFile = fopen(outPath.c_str(), "w");
+  FILE* foldedFile = fopen(foldedPath.c_str(), "w");
+  if (not outFile or not foldedFile)
+    {
+      std::cerr << "Failed to open PC profile file '"
+                << (outFile? foldedPath : outPath) << "' for output.\n";
+      if (outFile)
+        fclose(outFile);
+      if (foldedFile)
+        fclose(foldedFile);
+      return false;
+    }
+
+  unsigned hartCount = system.hartCount();
+  for (unsigned i = 0; i < hartCount; ++i)
+    {
+      auto& hart = *system.ithHart(i);
+      std::string prefix;
+      if (hartCount > 1)
+        {
+          if (i > 0)
+            fprintf(outFile, "\n");
+          fprintf(outFile, "Hart %u\n", i);
+          prefix = "hart" + std::to_string(i);
+        }
+      hart.reportPcProfile(outFile, foldedFile, prefix);
+    }
+
+  fclose(outFile);
+  fclose(foldedFile);
+  return true;
+}
+
+
 /// Open the trace-file, command-log and console-output files
 /// specified on the command line. Return true if successful or false
 /// if any specified file fails to open.
@@ -1333,6 +1491,60 @@ openUserFiles(const Args& args, FILE*& traceFile, FILE*& commandLog,
 
 
 /// Counterpart to openUserFiles: Close any open user file.
+/// Instructions per basic block vector if --bbvinterval is not used.
+static constexpr uint64_t defaultBbvInterval = 100000000;
+
+
+/// Stop basic block vector collection, writing the final partial
+/// interval of each hart, and close the files opened by
+/// openBbvFiles.
+template <typename URV>
+static
+void
+closeBbvFiles(System<URV>& system, std::vector<FILE*>& files)
+{
+  for (unsigned i = 0; i < files.size(); ++i)
+    {
+      system.ithHart(i)->enableBasicBlockVectors(nullptr, 0);
+      fclose(files.at(i));
+    }
+  files.clear();
+}
+
+
+/// Open the basic block vector file of each hart (if --bbvfile is
+/// used) and enable basic block vector collection. Return true on
+/// success and false on failure.
+template <typename URV>
+static
+bool
+openBbvFiles(System<URV>& system, const Args& args, std::vector<FILE*>& files)
+{
+  if (args.bbvFile.empty())
+    return true;
+
+  uint64_t interval = args.bbvInterval.value_or(defaultBbvInterval);
+  unsigned hartCount = system.hartCount();
+  for (unsigned i = 0; i < hartCount; ++i)
+    {
+      std::string path = args.bbvFile;
+      if (hartCount > 1)
+        path += "." + std::to_string(i);
+      FILE* file = fopen(path.c_str(), "w");
+      if (not file)
+        {
+          std::cerr << "Failed to open basic block vector file '" << path
+                    << "' for output\n";
+          closeBbvFiles(system, files);
+          return false;
+        }
+      files.push_back(file);
+      system.ithHart(i)->enableBasicBlockVectors(file, interval);
+    }
+  return true;
+}
+
+
 static
 void
 closeUserFiles(FILE*& traceFile, FILE*& commandLog, FILE*& consoleOut)
@@ -1389,7 +1601,12 @@ batchRun(System<URV>& system, FILE* traceFile, bool waitAll)
                       // In multi-hart system, wait till hart is started by hart0.
                       while (not hart->isStarted())
                         if (hart0Done)
-                          return;  // We are not going to be started.
+                          {
+                            // We are not going to be started.
+                            if (hart->traceBuffer())
+                              hart->traceBuffer()->finish();
+                            return;
+                          }
 		      bool r = hart->run(traceFile);
 		      result = result and r;
                       finished++;
@@ -1425,6 +1642,139 @@ batchRun(System<URV>& system, FILE* traceFile, bool waitAll)
 }
 
 
+/// Run the harts of the given multi-hart system in quanta of the
+/// given number of instructions. In each quantum, every started hart
+/// that has not finished executes up to quantum instructions. The
+/// harts of a quantum run one after the other in index order in the
+/// calling thread making the run deterministic: The interleaving of
+/// the harts (and hence the order of their memory accesses) depends
+/// only on the quantum. Stop when all harts finish (or when any hart
+/// finishes if waitAll is false). Return true on success and false on
+/// failure.
+template <typename URV>
+static bool
+quantumRun(System<URV>& system, FILE* traceFile, bool waitAll,
+           uint64_t quantum)
+{
+  unsigned hartCount = system.hartCount();
+
+  std::vector<uint8_t> done(hartCount);  // Per-hart finished flag.
+  std::atomic<bool> result = true;
+
+  std::vector<uint64_t> counter0(hartCount);
+  for (unsigned i = 0; i < hartCount; ++i)
+    counter0.at(i) = system.ithHart(i)->getInstructionCount();
+
+  // Run the quantum of the given hart unless it is finished or not
+  // yet started.
+  auto runHart = [&system, &done, &result, traceFile, quantum] (unsigned ix) {
+                   if (done.at(ix))
+                     return;
+                   Hart<URV>& hart = *system.ithHart(ix);
+                   if (not hart.isStarted())
+                     return;
+                   bool finished = false;
+                   bool ok = hart.runQuantum(quantum, traceFile, finished);
+                   if (finished)
+                     {
+                       result = result and ok;
+                       done.at(ix) = true;
+                     }
+                 };
+
+  // Return true if the run should stop at the end of a quantum.
+  auto isRunDone = [&system, &done, waitAll] () -> bool {
+                     unsigned finished = 0;
+                     for (unsigned ix = 0; ix < done.size(); ++ix)
+                       {
+                         // A hart not started by hart0 will never be.
+                         auto& hart = *system.ithHart(ix);
+                         if (done.at(0) and not done.at(ix) and not hart.isStarted())
+                           {
+                             done.at(ix) = true;
+                             if (hart.traceBuffer())
+                               hart.traceBuffer()->finish();
+                           }
+                         finished += done.at(ix);
+                       }
+                     return waitAll? finished == done.size() : finished > 0;
+                   };
+
+  // Keyboard interrupt stops all harts. Restore on exit.
+  extern void forceUserStop(int);
+#ifdef __MINGW64__
+  __p_sig_fn_t prevKbdAction = signal(SIGINT, forceUserStop);
+#else
+  struct sigaction newKbdAction, prevKbdAction;
+  memset(&newKbdAction, 0, sizeof(newKbdAction));
+  newKbdAction.sa_handler = forceUserStop;
+  sigaction(SIGINT, &newKbdAction, &prevKbdAction);
+#endif
+
+  struct timeval t0;
+  gettimeofday(&t0, nullptr);
+
+  while (not isRunDone())
+    for (unsigned ix = 0; ix < hartCount; ++ix)
+      runHart(ix);
+
+  struct timeval t1;
+  gettimeofday(&t1, nullptr);
+  double elapsed = (double(t1.tv_sec - t0.tv_sec) +
+                    double(t1.tv_usec - t0.tv_usec)*1e-6);
+
+#ifdef __MINGW64__
+  signal(SIGINT, prevKbdAction);
+#else
+  sigaction(SIGINT, &prevKbdAction, nullptr);
+#endif
+
+  uint64_t instCount = 0;
+  for (unsigned i = 0; i < hartCount; ++i)
+    instCount += system.ithHart(i)->getInstructionCount() - counter0.at(i);
+
+  std::cout.flush();
+  std::cerr << "Retired " << instCount << " instruction"
+            << (instCount > 1? "s" : "") << " in "
+            << (boost::format("%.2fs") % elapsed)
+            << " (" << hartCount << " harts, quantum " << quantum << ")";
+  if (elapsed > 0)
+    std::cerr << "  " << size_t(double(instCount)/elapsed) << " inst/s";
+  std::cerr << '\n';
+
+  return result;
+}
+
+
+/// If loadFrom is the directory <snapDir><k> of an earlier periodic
+/// snapshot run, return k + 1 so that the snapshots of this run do
+/// not overwrite the loaded one or its bases. Return 0 otherwise.
+static
+unsigned
+resumeSnapshotIndex(const std::string& snapDir, const std::string& loadFrom)
+{
+  if (loadFrom.empty())
+    return 0;
+
+  std::error_code ec;
+  FileSystem::path loaded = FileSystem::canonical(loadFrom, ec);
+  if (ec)
+    return 0;
+
+  std::string name = loaded.filename().string();
+  size_t pos = name.find_last_not_of("0123456789");
+  pos = (pos == std::string::npos) ? 0 : pos + 1;
+  if (pos == name.size() or name.size() - pos > 9)
+    return 0;
+
+  unsigned index = std::stoul(name.substr(pos));
+  FileSystem::path path(snapDir + std::to_string(index));
+  if (FileSystem::canonical(path, ec) != loaded or ec)
+    return 0;
+  return index + 1;
+}
+
+
 /// Run producing a snapshot after each snapPeriod instructions. Each
 /// snapshot goes into its own directory names <dir><n> where <dir> is
 /// the string in snapDir and <n> is a sequential integer starting at
@@ -1484,6 +1834,201 @@ snapshotRun(System<URV>& system, FILE* traceFile,
 }
 
 
+/// Instructions per hart per turn when taking multi-hart snapshots if
+/// --quantum is not used.
+static constexpr uint64_t defaultSnapshotQuantum = 1000;
+
+
+/// Multi-hart version of snapshotRun: Run the harts in round-robin
+/// order, each executing quantum instructions per turn, producing a
+/// system snapshot each time every hart has executed another
+/// snapPeriod instructions. The schedule is deterministic so that
+/// the snapshots are taken at reproducible points. Harts not yet
+/// started are skipped. Each snapshot goes into its own directory
+/// named <dir><n> (see snapshotRun). Run until all harts finish.
+/// Return true on success and false on failure.
+template <typename URV>
+static
+bool
+systemSnapshotRun(System<URV>& system, FILE* traceFile,
+                  const std::string& snapDir, uint64_t snapPeriod,
+                  uint64_t quantum)
+{
+  unsigned hartCount = system.hartCount();
+  std::vector<uint8_t> done(hartCount);
+  std::vector<uint64_t> targets(hartCount);
+  bool result = true;
+
+  Hart<URV>& hart0 = *system.ithHart(0);
+
+  while (true)
+    {
+      for (unsigned ix = 0; ix < hartCount; ++ix)
+        targets.at(ix) = system.ithHart(ix)->getInstructionCount() + snapPeriod;
+
+      // Run all harts to the end of the period.
+      bool pending = true;
+      while (pending)
+        {
+          pending = false;
+          for (unsigned ix = 0; ix < hartCount; ++ix)
+            {
+              Hart<URV>& hart = *system.ithHart(ix);
+              if (done.at(ix))
+                continue;
+              if (not hart.isStarted())
+                {
+                  // A hart not started by hart0 will never be.
+                  done.at(ix) = done.at(0);
+                  continue;
+                }
+              uint64_t count = hart.getInstructionCount();
+              if (count >= targets.at(ix))
+                continue;
+              bool finished = false;
+              uint64_t n = std::min(quantum, targets.at(ix) - count);
+              bool ok = hart.runQuantum(n, traceFile, finished);
+              if (finished)
+                {
+                  result = result and ok;
+                  done.at(ix) = true;
+                }
+              pending = true;
+            }
+        }
+
+      if (std::all_of(done.begin(), done.end(), [] (uint8_t d) { return d; }))
+        break;
+
+      unsigned index = hart0.snapshotIndex();
+      FileSystem::path path(snapDir + std::to_string(index));
+      if (not FileSystem::is_directory(path))
+        if (not FileSystem::create_directories(path))
+          {
+            std::cerr << "Error: Failed to create snapshot directory " << path << '\n';
+            return false;
+          }
+      hart0.setSnapshotIndex(index + 1);
+      if (not system.saveSnapshot(path.string()))
+        {
+          std::cerr << "Error: Failed to save a snapshot\n";
+          return false;
+        }
+    }
+
+  return result;
+}
+
+
+/// Read the interval indices of a SimPoint file: each non-empty line
+/// has an interval index followed by a cluster id. Return true on
+/// success and false on failure.
+static
+bool
+loadSimpoints(const std::string& path, std::vector<uint64_t>& intervals)
+{
+  std::ifstream ifs(path);
+  if (not ifs)
+    {
+      std::cerr << "Error: Failed to open simpoints file " << path << '\n';
+      return false;
+    }
+
+  std::string line;
+  unsigned lineNum = 0;
+  while (std::getline(ifs, line))
+    {
+      lineNum++;
+      std::istringstream iss(line);
+      uint64_t interval = 0, cluster = 0;
+      if (not (iss >> interval))
+        {
+          std::string word;
+          iss.clear();
+          if (iss >> word)
+            {
+              std::cerr << "Error: File " << path << ", line " << lineNum
+                        << ": Invalid simpoint interval: " << word << '\n';
+              return false;
+            }
+          continue;  // Empty line.
+        }
+      if (not (iss >> cluster))
+        {
+          std::cerr << "Error: File " << path << ", line " << lineNum
+                    << ": Missing simpoint cluster id\n";
+          return false;
+        }
+      intervals.push_back(interval);
+    }
+
+  std::sort(intervals.begin(), intervals.end());
+  intervals.erase(std::unique(intervals.begin(), intervals.end()), intervals.end());
+  return true;
+}
+
+
+/// Run saving a snapshot at the start of each of the given intervals
+/// (sorted in increasing order) of the given size (in instructions).
+/// The snapshot of interval k goes in directory <dir>k where <dir> is
+/// the string in snapDir. Stop after the last snapshot. Return true
+/// on success and false on failure.
+template <typename URV>
+static
+bool
+simpointRun(System<URV>& system, FILE* traceFile, const std::string& snapDir,
+            uint64_t interval, const std::vector<uint64_t>& intervals)
+{
+  assert(system.hartCount() == 1);
+  Hart<URV>& hart = *(system.ithHart(0));
+
+  uint64_t globalLimit = hart.getInstructionCountLimit();
+
+  for (auto index : intervals)
+    {
+      uint64_t target = index * interval;
+      if (index and target / index != interval)
+        target = ~uint64_t(0);  // Overflow.
+
+      if (target > globalLimit)
+        {
+          std::cerr << "Warning: Simpoint interval " << index << " beyond "
+                    << "instruction limit\n";
+          break;
+        }
+
+      if (target > hart.getInstructionCount())
+        {
+          hart.setInstructionCountLimit(target);
+          hart.run(traceFile);
+        }
+
+      if (hart.hasTargetProgramFinished() or hart.getInstructionCount() != target)
+        {
+          std::cerr << "Warning: Program ended before simpoint interval "
+                    << index << '\n';
+          break;
+        }
+
+      FileSystem::path path(snapDir + std::to_string(index));
+      if (not FileSystem::is_directory(path))
+        if (not FileSystem::create_directories(path))
+          {
+            std::cerr << "Error: Failed to create snapshot directory " << path << '\n';
+            return false;
+          }
+      if (not hart.saveSnapshot(path))
+        {
+          std::cerr << "Error: Failed to save a snapshot\n";
+          return false;
+        }
+    }
+
+  hart.setInstructionCountLimit(globalLimit);
+  return true;
+}
+
+
 /// Depending on command line args, start a server, run in interactive
 /// mode, or initiate a batch run.
 template <typename URV>
@@ -1496,6 +2041,14 @@ sessionRun(System<URV>& system, const Args& args, FILE* traceFile, FILE* cmdLog)
       if (not args.interactive)
 	return false;
 
+  if (not args.loadFrom.empty() and System<URV>::isSystemSnapshot(args.loadFrom))
+    if (not system.loadSnapshot(args.loadFrom))
+      {
+        std::cerr << "Error: Failed to load snapshot from dir " << args.loadFrom << '\n';
+        if (not args.interactive)
+          return false;
+      }
+
   // In server/interactive modes: enable triggers and performance counters.
   bool serverMode = not args.serverFile.empty();
   if (serverMode or args.interactive)
@@ -1539,17 +2092,84 @@ sessionRun(System<URV>& system, const Args& args, FILE* traceFile, FILE* cmdLog)
       return interactive.interact(traceFile, cmdLog);
     }
 
+  if (not args.simpointsFile.empty())
+    {
+      std::vector<uint64_t> intervals;
+      if (not loadSimpoints(args.simpointsFile, intervals))
+        return false;
+      uint64_t interval = args.bbvInterval.value_or(defaultBbvInterval);
+      if (system.hartCount() == 1)
+        return simpointRun(system, traceFile, args.snapshotDir, interval, intervals);
+      std::cerr << "Warning: Simpoint snapshots not supported for multi-hart runs\n";
+    }
+
   if (args.snapshotPeriod and *args.snapshotPeriod)
     {
       uint64_t period = *args.snapshotPeriod;
       std::string dir = args.snapshotDir;
+      Hart<URV>& hart0 = *system.ithHart(0);
+      hart0.setSnapshotIndex(resumeSnapshotIndex(dir, args.loadFrom));
       if (system.hartCount() == 1)
         return snapshotRun(system, traceFile, dir, period);
-      std::cerr << "Warning: Snapshots not supported for multi-thread runs\n";
+      uint64_t quantum = args.quantum.value_or(0);
+      if (quantum == 0)
+        quantum = defaultSnapshotQuantum;
+      return systemSnapshotRun(system, traceFile, dir, period, quantum);
     }
 
+  // Buffer trace records of each hart and write them in a background
+  // thread. Writer is stopped (flushing all records) on return.
+  std::unique_ptr<TraceWriter> traceWriter;
+  std::unique_ptr<BinaryTraceWriter> binaryWriter;
+  if (args.logBinary and traceFile)
+    {
+      binaryWriter = std::make_unique<BinaryTraceWriter>(sizeof(URV)*8);
+      fflush(traceFile);
+      if (not binaryWriter->open(fileno(traceFile)))
+        {
+          std::cerr << "Failed to start binary trace\n";
+          return false;
+        }
+      for (unsigned i = 0; i < system.hartCount(); ++i)
+        system.ithHart(i)->setBinaryTrace(binaryWriter.get());
+    }
+  else if (args.traceBuffer and traceFile)
+    {
+      traceWriter = std::make_unique<TraceWriter>(traceFile, system.hartCount());
+      for (unsigned i = 0; i < system.hartCount(); ++i)
+        system.ithHart(i)->setTraceBuffer(traceWriter->buffer(i));
+      traceWriter->start();
+    }
+
+  bool ok = true;
   bool waitAll = not args.quitOnAnyHart;
-  return batchRun(system, traceFile, waitAll);
+  bool quantum = args.quantum and *args.quantum and system.hartCount() > 1;
+  if (quantum and (args.gdb or not args.gdbTcpPort.empty()))
+    {
+      std::cerr << "Warning: Quantum scheduling not supported in gdb mode\n";
+      quantum = false;
+    }
+
+  if (quantum)
+    ok = quantumRun(system, traceFile, waitAll, *args.quantum);
+  else
+    ok = batchRun(system, traceFile, waitAll);
+
+  if (traceWriter)
+    {
+      traceWriter->stop();
+      for (unsigned i = 0; i < system.hartCount(); ++i)
+        system.ithHart(i)->setTraceBuffer(nullptr);
+    }
+
+  if (binaryWriter)
+    {
+      binaryWriter->close();
+      for (unsigned i = 0; i < system.hartCount(); ++i)
+        system.ithHart(i)->setBinaryTrace(nullptr);
+    }
+
+  return ok;
 }
 
 
@@ -1699,11 +2319,23 @@ session(const Args& args, const HartConfig& config)
 
   checkAndRepairMemoryParams(memorySize, pageSize, regionSize);
 
+  bool hugePages = args.hugePages;
+  if (not hugePages)
+    config.getHugePages(hugePages);
+
   // Create cores & harts.
-  System<URV> system(coreCount, hartsPerCore, memorySize, pageSize);
+  System<URV> system(coreCount, hartsPerCore, memorySize, pageSize, hugePages);
   assert(system.hartCount() == coreCount*hartsPerCore);
   assert(system.hartCount() > 0);
 
+  if (hugePages)
+    {
+      std::cerr << "Simulated memory backed by "
+                << hugePageKindName(system.memoryHugePageKind()) << '\n';
+      std::cerr << "Decoded instruction caches backed by "
+                << hugePageKindName(system.decodeCacheHugePageKind()) << '\n';
+    }
+
   // Configure harts. Define callbacks for non-standard CSRs.
   if (not config.configHarts(system, args.isa, args.verbose))
     if (not args.interactive)
@@ -1713,6 +2345,10 @@ session(const Args& args, const HartConfig& config)
   if (not config.configMemory(system, args.iccmRw, args.unmappedElfOk, args.verbose))
     return false;
 
+  // Configure the cache hierarchy of the performance model.
+  if (not config.configCaches(system))
+    return false;
+
   if (args.hexFiles.empty() and args.expandedTargets.empty()
       and not args.interactive)
     {
@@ -1733,12 +2369,39 @@ session(const Args& args, const HartConfig& config)
       hart.reset();
     }
 
+  std::vector<FILE*> bbvFiles;
+  if (not openBbvFiles(system, args, bbvFiles))
+    {
+      closeUserFiles(traceFile, commandLog, consoleOut);
+      return false;
+    }
+
   bool result = sessionRun(system, args, traceFile, commandLog);
 
+  closeBbvFiles(system, bbvFiles);
+
+  if (args.verbose)
+    {
+      std::cerr << "Resident simulated memory: "
+                << system.memoryResidentSize() / 1024 << " KB\n";
+      for (unsigned i = 0; i < system.hartCount(); ++i)
+        {
+          std::string prefix;
+          if (system.hartCount() > 1)
+            prefix = "Hart" + std::to_string(i) + " ";
+          system.ithHart(i)->printTlbStats(std::cerr, prefix);
+        }
+    }
+
   auto& hart0 = *system.ithHart(0);
   if (not args.instFreqFile.empty())
     result = reportInstructionFrequency(hart0, args.instFreqFile) and result;
 
+  if (not args.pcProfileFile.empty())
+    result = reportPcProfile(system, args.pcProfileFile) and result;
+
+  system.printCacheStats(std::cerr);
+
   closeUserFiles(traceFile, commandLog, consoleOut);
 
   return result;